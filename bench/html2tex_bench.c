@@ -0,0 +1,535 @@
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include "html2tex.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#include <pthread.h>
+#endif
+
+/* Growable text buffer used to generate the synthetic corpora. */
+typedef struct {
+    char* data;
+    size_t size;
+    size_t capacity;
+} TextBuffer;
+
+/* One input document together with what the stages measure it by. */
+typedef struct {
+    const char* name;
+    char* html;
+    size_t size;
+
+    HTMLNode* tree;
+    size_t nodes;
+
+    /* style attributes of the tree, for the CSS stage */
+    const char** styles;
+    size_t style_count;
+    size_t style_bytes;
+} Corpus;
+
+typedef void (*StageFn)(Corpus* corpus);
+
+/* keeps the compiler from dropping results nobody reads */
+static volatile size_t bench_guard;
+
+static double now_seconds(void) {
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
+
+static void buffer_append(TextBuffer* buffer, const char* format, ...) {
+    va_list args;
+
+    for (;;) {
+        size_t available = buffer->capacity - buffer->size;
+
+        va_start(args, format);
+        int written = vsnprintf(buffer->data + buffer->size, available, format, args);
+        va_end(args);
+
+        if (written < 0) return;
+
+        if ((size_t)written < available) {
+            buffer->size += (size_t)written;
+            return;
+        }
+
+        size_t capacity = buffer->capacity ? buffer->capacity * 2 : 65536;
+
+        while (capacity - buffer->size <= (size_t)written)
+            capacity *= 2;
+
+        char* data = (char*)realloc(buffer->data, capacity);
+
+        if (!data) {
+            fprintf(stderr, "html2tex_bench: out of memory\n");
+            exit(1);
+        }
+
+        buffer->data = data;
+        buffer->capacity = capacity;
+    }
+}
+
+static void generate_deep_nesting(TextBuffer* out, int scale) {
+    for (int block = 0; block < 100 * scale; block++) {
+        for (int level = 0; level < 200; level++)
+            buffer_append(out, "<div class=\"level%d\"><span>", level);
+
+        buffer_append(out, "deepest text %d", block);
+
+        for (int level = 0; level < 200; level++)
+            buffer_append(out, "</span></div>");
+    }
+}
+
+static void generate_wide_table(TextBuffer* out, int scale) {
+    buffer_append(out, "<table border=\"1\"><caption>Wide table</caption>");
+    buffer_append(out, "<tr>");
+
+    for (int column = 0; column < 40; column++)
+        buffer_append(out, "<th>Column %d</th>", column);
+
+    buffer_append(out, "</tr>");
+
+    for (int row = 0; row < 400 * scale; row++) {
+        buffer_append(out, "<tr>");
+
+        for (int column = 0; column < 40; column++)
+            buffer_append(out, "<td>r%dc%d</td>", row, column);
+
+        buffer_append(out, "</tr>");
+    }
+
+    buffer_append(out, "</table>");
+}
+
+static void generate_styled_spans(TextBuffer* out, int scale) {
+    static const char* const colors[] = { "red", "#336699", "rgb(10, 20, 30)", "green" };
+
+    for (int paragraph = 0; paragraph < 1000 * scale; paragraph++) {
+        buffer_append(out, "<p style=\"text-align: center; margin-bottom: 4px\">");
+
+        for (int span = 0; span < 20; span++) {
+            buffer_append(out, "<span style=\"color: %s; font-weight: bold; font-style: italic; "
+                "background-color: yellow; font-family: monospace\">word%d</span> ",
+                colors[span % 4], span);
+        }
+
+        buffer_append(out, "</p>");
+    }
+}
+
+static void generate_large_text(TextBuffer* out, int scale) {
+    for (int paragraph = 0; paragraph < 2000 * scale; paragraph++) {
+        buffer_append(out, "<p>");
+
+        for (int sentence = 0; sentence < 12; sentence++) {
+            buffer_append(out, "Sentence %d costs $%d, about 50%% of item_%d & more {braces} ~tilde^. ",
+                sentence, paragraph, sentence);
+        }
+
+        buffer_append(out, "</p>\n");
+    }
+}
+
+static void generate_many_images(TextBuffer* out, int scale) {
+    for (int image = 0; image < 5000 * scale; image++) {
+        buffer_append(out, "<p><img src=\"https://example.com/images/picture_%d.png\" "
+            "alt=\"Picture %d\" width=\"120\" height=\"80\"></p>", image, image);
+    }
+}
+
+/* Counts the nodes below root and collects their style attributes. */
+static void index_tree(Corpus* corpus, HTMLNode* node) {
+    for (; node; node = node->next) {
+        corpus->nodes++;
+
+        for (HTMLAttribute* attr = node->attributes; attr; attr = attr->next) {
+            if (strcmp(attr->key, "style") != 0 || !attr->value) continue;
+
+            if (corpus->styles) corpus->styles[corpus->style_count] = attr->value;
+            corpus->style_count++;
+            corpus->style_bytes += strlen(attr->value);
+        }
+
+        index_tree(corpus, node->children);
+    }
+}
+
+static int load_corpus(Corpus* corpus) {
+    corpus->tree = html2tex_parse(corpus->html);
+    if (!corpus->tree) return 0;
+
+    /* first pass counts, the second one stores the style strings */
+    index_tree(corpus, corpus->tree->children);
+
+    if (corpus->style_count > 0) {
+        corpus->styles = (const char**)malloc(corpus->style_count * sizeof(const char*));
+        if (!corpus->styles) return 0;
+
+        corpus->nodes = 0;
+        corpus->style_count = 0;
+        corpus->style_bytes = 0;
+        index_tree(corpus, corpus->tree->children);
+    }
+
+    return 1;
+}
+
+static void stage_parse(Corpus* corpus) {
+    HTMLNode* root = html2tex_parse(corpus->html);
+    bench_guard += root != NULL;
+    html2tex_free_node(root);
+}
+
+static void stage_minify(Corpus* corpus) {
+    HTMLNode* minified = html2tex_minify_html(corpus->tree);
+    bench_guard += minified != NULL;
+    html2tex_free_node(minified);
+}
+
+static void stage_prettify(Corpus* corpus) {
+    char* pretty = get_pretty_html(corpus->tree);
+    bench_guard += pretty ? strlen(pretty) : 0;
+    free(pretty);
+}
+
+static void stage_css(Corpus* corpus) {
+    for (size_t i = 0; i < corpus->style_count; i++) {
+        CSSProperties* props = parse_css_style(corpus->styles[i]);
+        bench_guard += props != NULL;
+        free_css_properties(props);
+    }
+}
+
+static void stage_convert(Corpus* corpus) {
+    LaTeXConverter* converter = html2tex_create();
+    char* latex = html2tex_convert(converter, corpus->html);
+
+    bench_guard += latex ? strlen(latex) : 0;
+    free(latex);
+    html2tex_destroy(converter);
+}
+
+/* Repeats a stage for at least min_time seconds and prints its averages. */
+static void run_stage(const char* stage, StageFn fn, Corpus* corpus, size_t bytes,
+    size_t units, const char* unit, double min_time) {
+    /* warm caches and the allocator first */
+    fn(corpus);
+
+    size_t iterations = 0;
+    const double start = now_seconds();
+    double elapsed;
+
+    do {
+        fn(corpus);
+        iterations++;
+        elapsed = now_seconds() - start;
+    } while (elapsed < min_time || iterations < 3);
+
+    const double per_iteration = elapsed / (double)iterations;
+    const double mb_per_second = per_iteration > 0 ? (double)bytes / per_iteration / 1e6 : 0;
+    const double ns_per_unit = units > 0 ? per_iteration * 1e9 / (double)units : 0;
+
+    printf("%-14s %-9s %10.2f MB/s %12.1f ns/%-6s %8zu runs\n",
+        corpus->name, stage, mb_per_second, ns_per_unit, unit, iterations);
+}
+
+/* Shared input of the concurrent run; each worker only writes its own counters. */
+typedef struct {
+    Corpus* corpora;
+    size_t corpus_count;
+
+    /* output of a fresh converter, computed before the workers start */
+    char** expected;
+    int rounds;
+
+    size_t documents;
+    size_t mismatches;
+} Worker;
+
+/* Runs every stage over every corpus with objects of its own, checking the LaTeX. */
+static void concurrent_worker(Worker* worker) {
+    for (int round = 0; round < worker->rounds; round++) {
+        for (size_t i = 0; i < worker->corpus_count; i++) {
+            Corpus* corpus = &worker->corpora[i];
+
+            /* the shared tree and strings are only read */
+            HTMLNode* root = html2tex_parse(corpus->html);
+            HTMLNode* minified = html2tex_minify_html(corpus->tree);
+            char* pretty = get_pretty_html(corpus->tree);
+            int failed = !root || !minified || !pretty;
+
+            for (size_t j = 0; j < corpus->style_count; j++) {
+                CSSProperties* props = parse_css_style(corpus->styles[j]);
+                failed |= !props;
+                free_css_properties(props);
+            }
+
+            html2tex_free_node(root);
+            html2tex_free_node(minified);
+            free(pretty);
+
+            LaTeXConverter* converter = html2tex_create();
+            char* latex = html2tex_convert(converter, corpus->html);
+
+            if (failed || !latex || strcmp(latex, worker->expected[i]) != 0)
+                worker->mismatches++;
+
+            worker->documents++;
+            free(latex);
+            html2tex_destroy(converter);
+        }
+    }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI concurrent_thread(LPVOID worker) {
+    concurrent_worker((Worker*)worker);
+    return 0;
+}
+#else
+static void* concurrent_thread(void* worker) {
+    concurrent_worker((Worker*)worker);
+    return NULL;
+}
+#endif
+
+/* Converts all corpora on independent threads and checks them against one thread. */
+static int run_concurrent(Corpus* corpora, size_t corpus_count, int threads, int rounds) {
+    char** expected = (char**)calloc(corpus_count, sizeof(char*));
+    Worker* workers = (Worker*)calloc((size_t)threads, sizeof(Worker));
+    size_t bytes = 0;
+    int failed = 0;
+
+    if (!expected || !workers) {
+        free(expected);
+        free(workers);
+        return 1;
+    }
+
+    for (size_t i = 0; i < corpus_count; i++) {
+        LaTeXConverter* converter = html2tex_create();
+        expected[i] = html2tex_convert(converter, corpora[i].html);
+        html2tex_destroy(converter);
+
+        bytes += corpora[i].size;
+        if (!expected[i]) failed = 1;
+    }
+
+#ifdef _WIN32
+    HANDLE* handles = (HANDLE*)malloc(sizeof(HANDLE) * (size_t)threads);
+#else
+    pthread_t* handles = (pthread_t*)malloc(sizeof(pthread_t) * (size_t)threads);
+#endif
+    int started = 0;
+    const double start = now_seconds();
+
+    for (int t = 0; handles && !failed && t < threads; t++) {
+        workers[t].corpora = corpora;
+        workers[t].corpus_count = corpus_count;
+        workers[t].expected = expected;
+        workers[t].rounds = rounds;
+#ifdef _WIN32
+        handles[started] = CreateThread(NULL, 0, concurrent_thread, &workers[t], 0, NULL);
+        if (!handles[started]) break;
+#else
+        if (pthread_create(&handles[started], NULL, concurrent_thread, &workers[t]) != 0) break;
+#endif
+        started++;
+    }
+
+    for (int t = 0; t < started; t++) {
+#ifdef _WIN32
+        WaitForSingleObject(handles[t], INFINITE);
+        CloseHandle(handles[t]);
+#else
+        pthread_join(handles[t], NULL);
+#endif
+    }
+
+    const double elapsed = now_seconds() - start;
+    size_t documents = 0, mismatches = 0;
+
+    for (int t = 0; t < started; t++) {
+        documents += workers[t].documents;
+        mismatches += workers[t].mismatches;
+    }
+
+    if (started < threads) failed = 1;
+
+    printf("# concurrent: %d threads x %d rounds, %zu documents, %zu mismatches\n",
+        started, rounds, documents, mismatches);
+
+    if (elapsed > 0 && documents > 0) {
+        printf("%-14s %-9s %10.2f MB/s %12.1f us/%-6s\n", "all", "threads",
+            (double)bytes * (double)documents / (double)corpus_count / elapsed / 1e6,
+            elapsed * 1e6 / (double)documents, "doc");
+    }
+
+    for (size_t i = 0; i < corpus_count; i++)
+        free(expected[i]);
+
+    free(expected);
+    free(workers);
+    free(handles);
+    return failed || mismatches > 0;
+}
+
+static char* read_file(const char* path, size_t* size) {
+    FILE* file = fopen(path, "rb");
+    if (!file) return NULL;
+
+    TextBuffer buffer = { NULL, 0, 0 };
+    char chunk[65536];
+    size_t count;
+
+    while ((count = fread(chunk, 1, sizeof(chunk), file)) > 0)
+        buffer_append(&buffer, "%.*s", (int)count, chunk);
+
+    fclose(file);
+
+    if (!buffer.data) buffer_append(&buffer, "%s", "");
+    *size = buffer.size;
+    return buffer.data;
+}
+
+static void usage(void) {
+    fprintf(stderr,
+        "usage: html2tex_bench [-s scale] [-t seconds] [-j threads] [-r rounds] [file.html ...]\n"
+        "  -s  multiplies the size of the synthetic corpora (default 1)\n"
+        "  -t  minimum time spent on each measurement (default 0.5)\n"
+        "  -j  also runs every stage on this many threads at once and checks\n"
+        "      their LaTeX against a single thread (build with a thread sanitizer to vet it)\n"
+        "  -r  rounds over all corpora per thread with -j (default 2)\n"
+        "  files are measured in addition to the synthetic corpora\n");
+}
+
+int main(int argc, char** argv) {
+    int scale = 1;
+    double min_time = 0.5;
+    int threads = 0;
+    int rounds = 2;
+    int first_file = argc;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            scale = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+            min_time = atof(argv[++i]);
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+            rounds = atoi(argv[++i]);
+        else if (argv[i][0] == '-') {
+            usage();
+            return 1;
+        }
+        else {
+            first_file = i;
+            break;
+        }
+    }
+
+    if (scale < 1) scale = 1;
+    if (min_time < 0) min_time = 0;
+    if (rounds < 1) rounds = 1;
+
+    static const struct {
+        const char* name;
+        void (*generate)(TextBuffer* out, int scale);
+    } synthetic[] = {
+        { "deep_nesting", generate_deep_nesting },
+        { "wide_table", generate_wide_table },
+        { "styled_spans", generate_styled_spans },
+        { "large_text", generate_large_text },
+        { "many_images", generate_many_images }
+    };
+
+    const size_t synthetic_count = sizeof(synthetic) / sizeof(synthetic[0]);
+    const size_t corpus_count = synthetic_count + (size_t)(argc - first_file);
+    Corpus* corpora = (Corpus*)calloc(corpus_count, sizeof(Corpus));
+
+    if (!corpora) return 1;
+
+    for (size_t i = 0; i < synthetic_count; i++) {
+        TextBuffer buffer = { NULL, 0, 0 };
+        synthetic[i].generate(&buffer, scale);
+
+        corpora[i].name = synthetic[i].name;
+        corpora[i].html = buffer.data;
+        corpora[i].size = buffer.size;
+    }
+
+    for (int i = first_file; i < argc; i++) {
+        Corpus* corpus = &corpora[synthetic_count + (size_t)(i - first_file)];
+        const char* slash = strrchr(argv[i], '/');
+
+        corpus->name = slash ? slash + 1 : argv[i];
+        corpus->html = read_file(argv[i], &corpus->size);
+
+        if (!corpus->html) {
+            fprintf(stderr, "html2tex_bench: cannot read %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    printf("# scanning kernels: %s\n", html2tex_scan_isa());
+    printf("%-14s %-9s %15s %18s %13s\n", "corpus", "stage", "throughput", "latency", "");
+
+    for (size_t i = 0; i < corpus_count; i++) {
+        Corpus* corpus = &corpora[i];
+
+        if (!load_corpus(corpus)) {
+            fprintf(stderr, "html2tex_bench: cannot parse %s\n", corpus->name);
+            return 1;
+        }
+
+        printf("# %s: %.2f MB, %zu nodes, %zu style attributes\n", corpus->name,
+            (double)corpus->size / 1e6, corpus->nodes, corpus->style_count);
+
+        run_stage("parse", stage_parse, corpus, corpus->size, corpus->nodes, "node", min_time);
+        run_stage("minify", stage_minify, corpus, corpus->size, corpus->nodes, "node", min_time);
+        run_stage("prettify", stage_prettify, corpus, corpus->size, corpus->nodes, "node", min_time);
+
+        if (corpus->style_count > 0) {
+            run_stage("css", stage_css, corpus, corpus->style_bytes,
+                corpus->style_count, "style", min_time);
+        }
+
+        run_stage("convert", stage_convert, corpus, corpus->size, corpus->nodes, "node", min_time);
+    }
+
+    int status = 0;
+
+    if (threads > 0)
+        status = run_concurrent(corpora, corpus_count, threads, rounds);
+
+    for (size_t i = 0; i < corpus_count; i++) {
+        html2tex_free_node(corpora[i].tree);
+        free(corpora[i].styles);
+        free(corpora[i].html);
+    }
+
+    free(corpora);
+    return status;
+}
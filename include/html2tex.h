@@ -13,7 +13,56 @@ extern "C" {
 	typedef struct ConverterState ConverterState;
     typedef struct LaTeXConverter LaTeXConverter;
 	typedef struct CSSProperties CSSProperties;
+	typedef struct CSSStyleCache CSSStyleCache;
 	typedef struct NodeQueue NodeQueue;
+	typedef struct HTMLArena HTMLArena;
+	typedef struct HTMLStreamParser HTMLStreamParser;
+	typedef struct ImageDownloader ImageDownloader;
+	typedef struct ImageCache ImageCache;
+
+    /* known HTML element names, resolved once per node into tag_id */
+    typedef enum {
+        HTML2TEX_TAG_UNRESOLVED = 0,  /* tag_id not computed yet */
+        HTML2TEX_TAG_UNKNOWN,         /* text node or unrecognized element name */
+        HTML2TEX_TAG_A, HTML2TEX_TAG_ABBR, HTML2TEX_TAG_ADDRESS, HTML2TEX_TAG_AREA,
+        HTML2TEX_TAG_ARTICLE, HTML2TEX_TAG_ASIDE, HTML2TEX_TAG_AUDIO, HTML2TEX_TAG_B,
+        HTML2TEX_TAG_BASE, HTML2TEX_TAG_BDI, HTML2TEX_TAG_BDO, HTML2TEX_TAG_BLOCKQUOTE,
+        HTML2TEX_TAG_BODY, HTML2TEX_TAG_BR, HTML2TEX_TAG_BUTTON, HTML2TEX_TAG_CANVAS,
+        HTML2TEX_TAG_CAPTION, HTML2TEX_TAG_CENTER, HTML2TEX_TAG_CITE, HTML2TEX_TAG_CODE,
+        HTML2TEX_TAG_COL, HTML2TEX_TAG_COLGROUP, HTML2TEX_TAG_DATA, HTML2TEX_TAG_DD,
+        HTML2TEX_TAG_DEL, HTML2TEX_TAG_DFN, HTML2TEX_TAG_DIV, HTML2TEX_TAG_DL, HTML2TEX_TAG_DT,
+        HTML2TEX_TAG_EM, HTML2TEX_TAG_EMBED, HTML2TEX_TAG_FIGCAPTION, HTML2TEX_TAG_FIGURE,
+        HTML2TEX_TAG_FONT, HTML2TEX_TAG_FOOTER, HTML2TEX_TAG_FORM, HTML2TEX_TAG_FRAME,
+        HTML2TEX_TAG_FRAMESET, HTML2TEX_TAG_H1, HTML2TEX_TAG_H2, HTML2TEX_TAG_H3,
+        HTML2TEX_TAG_H4, HTML2TEX_TAG_H5, HTML2TEX_TAG_H6, HTML2TEX_TAG_HEAD,
+        HTML2TEX_TAG_HEADER, HTML2TEX_TAG_HR, HTML2TEX_TAG_HTML, HTML2TEX_TAG_I,
+        HTML2TEX_TAG_IFRAME, HTML2TEX_TAG_IMG, HTML2TEX_TAG_INPUT, HTML2TEX_TAG_INS,
+        HTML2TEX_TAG_KBD, HTML2TEX_TAG_LABEL, HTML2TEX_TAG_LI, HTML2TEX_TAG_LINK,
+        HTML2TEX_TAG_MAIN, HTML2TEX_TAG_MAP, HTML2TEX_TAG_MARK, HTML2TEX_TAG_META,
+        HTML2TEX_TAG_METER, HTML2TEX_TAG_NAV, HTML2TEX_TAG_NOFRAMES, HTML2TEX_TAG_NOSCRIPT,
+        HTML2TEX_TAG_OBJECT, HTML2TEX_TAG_OL, HTML2TEX_TAG_OPTGROUP, HTML2TEX_TAG_OPTION,
+        HTML2TEX_TAG_OUTPUT, HTML2TEX_TAG_P, HTML2TEX_TAG_PARAM, HTML2TEX_TAG_PICTURE,
+        HTML2TEX_TAG_PRE, HTML2TEX_TAG_PROGRESS, HTML2TEX_TAG_Q, HTML2TEX_TAG_RP,
+        HTML2TEX_TAG_RT, HTML2TEX_TAG_RUBY, HTML2TEX_TAG_S, HTML2TEX_TAG_SAMP,
+        HTML2TEX_TAG_SCRIPT, HTML2TEX_TAG_SEARCH, HTML2TEX_TAG_SECTION, HTML2TEX_TAG_SELECT,
+        HTML2TEX_TAG_SMALL, HTML2TEX_TAG_SOURCE, HTML2TEX_TAG_SPAN, HTML2TEX_TAG_STRIKE,
+        HTML2TEX_TAG_STRONG, HTML2TEX_TAG_STYLE, HTML2TEX_TAG_SUB, HTML2TEX_TAG_SUP,
+        HTML2TEX_TAG_SVG, HTML2TEX_TAG_TABLE, HTML2TEX_TAG_TBODY, HTML2TEX_TAG_TD,
+        HTML2TEX_TAG_TEMPLATE, HTML2TEX_TAG_TEXTAREA, HTML2TEX_TAG_TFOOT, HTML2TEX_TAG_TH,
+        HTML2TEX_TAG_THEAD, HTML2TEX_TAG_TIME, HTML2TEX_TAG_TITLE, HTML2TEX_TAG_TR,
+        HTML2TEX_TAG_TRACK, HTML2TEX_TAG_TT, HTML2TEX_TAG_U, HTML2TEX_TAG_UL, HTML2TEX_TAG_VAR,
+        HTML2TEX_TAG_VIDEO, HTML2TEX_TAG_WBR,
+        HTML2TEX_TAG_COUNT
+    } HTML2TeXTag;
+
+    /* tag classes returned by html2tex_tag_flags */
+    #define HTML2TEX_TAG_IS_BLOCK        0x1u  /* block-level element */
+    #define HTML2TEX_TAG_IS_INLINE       0x2u  /* inline element */
+    #define HTML2TEX_TAG_IS_EXCLUDED     0x4u  /* skipped with its subtree during conversion */
+    #define HTML2TEX_TAG_IS_VOID         0x8u  /* element that never has children */
+    #define HTML2TEX_TAG_IS_PRESERVE_WS  0x10u /* whitespace inside is significant */
+    #define HTML2TEX_TAG_IS_ESSENTIAL    0x20u /* kept by minification even when empty */
+    #define HTML2TEX_TAG_IS_PHRASING     0x40u /* kept on one line when prettified */
 
     /* HTML node structure */
     struct HTMLNode {
@@ -23,7 +72,26 @@ extern "C" {
         HTMLNode* children;
         HTMLNode* next;
         HTMLNode* parent;
+        unsigned int flags;
+        int tag_id;  /* HTML2TeXTag; reset to HTML2TEX_TAG_UNRESOLVED after editing tag */
     };
+
+    /* cached per-node metadata stored in the HTMLNode flags field */
+    #define HTML2TEX_NODE_HAS_TABLE     0x1u  /* a descendant is a table element */
+    #define HTML2TEX_NODE_NESTED_TABLE  0x2u  /* table element containing another table */
+    #define HTML2TEX_NODE_ANNOTATED     0x4u  /* root whose subtree flags are up to date */
+    #define HTML2TEX_NODE_ARENA         0x8u  /* node memory is owned by a document arena */
+    #define HTML2TEX_NODE_ARENA_ROOT    0x10u /* root that releases its whole arena when freed */
+
+    /* html2tex_parse_ex options */
+    #define HTML2TEX_PARSE_ARENA        0x1   /* allocate the whole DOM from one arena */
+    #define HTML2TEX_PARSE_MINIFY       0x2   /* collapse whitespace and drop empty elements while parsing */
+
+    /* html2tex_serialize options */
+    #define HTML2TEX_SERIALIZE_COMPACT  0x1   /* no indentation or line breaks, text written as it is */
+
+    /* element nesting kept by the parsers and accepted by the converter unless told otherwise */
+    #define HTML2TEX_MAX_DEPTH 512
 	
 	struct NodeQueue {
 		HTMLNode* data;
@@ -75,42 +143,98 @@ extern "C" {
         int has_font_family;
     };
 	
+    /* CSSProperties.present bits, one per recognized declaration */
+    #define HTML2TEX_CSS_FONT_WEIGHT       0x1u
+    #define HTML2TEX_CSS_FONT_STYLE        0x2u
+    #define HTML2TEX_CSS_FONT_FAMILY       0x4u
+    #define HTML2TEX_CSS_FONT_SIZE         0x8u
+    #define HTML2TEX_CSS_COLOR             0x10u
+    #define HTML2TEX_CSS_BACKGROUND_COLOR  0x20u
+    #define HTML2TEX_CSS_TEXT_ALIGN        0x40u
+    #define HTML2TEX_CSS_TEXT_DECORATION   0x80u
+    #define HTML2TEX_CSS_MARGIN_TOP        0x100u
+    #define HTML2TEX_CSS_MARGIN_BOTTOM     0x200u
+    #define HTML2TEX_CSS_MARGIN_LEFT       0x400u
+    #define HTML2TEX_CSS_MARGIN_RIGHT      0x800u
+    #define HTML2TEX_CSS_PADDING_TOP       0x1000u
+    #define HTML2TEX_CSS_PADDING_BOTTOM    0x2000u
+    #define HTML2TEX_CSS_PADDING_LEFT      0x4000u
+    #define HTML2TEX_CSS_PADDING_RIGHT     0x8000u
+    #define HTML2TEX_CSS_WIDTH             0x10000u
+    #define HTML2TEX_CSS_HEIGHT            0x20000u
+    #define HTML2TEX_CSS_BORDER            0x40000u
+    #define HTML2TEX_CSS_BORDER_COLOR      0x80000u
+    #define HTML2TEX_CSS_DISPLAY           0x100000u
+    #define HTML2TEX_CSS_FLOAT             0x200000u
+    #define HTML2TEX_CSS_VERTICAL_ALIGN    0x400000u
+
+    /* keyword values; *_OTHER is a value the converter has no use for */
+    typedef enum { HTML2TEX_WEIGHT_OTHER, HTML2TEX_WEIGHT_BOLD, HTML2TEX_WEIGHT_MEDIUM } HTML2TeXFontWeight;
+    typedef enum { HTML2TEX_STYLE_OTHER, HTML2TEX_STYLE_ITALIC, HTML2TEX_STYLE_OBLIQUE, HTML2TEX_STYLE_NORMAL } HTML2TeXFontStyle;
+    typedef enum { HTML2TEX_FAMILY_OTHER, HTML2TEX_FAMILY_MONOSPACE, HTML2TEX_FAMILY_SANS, HTML2TEX_FAMILY_SERIF } HTML2TeXFontFamily;
+    typedef enum { HTML2TEX_ALIGN_OTHER, HTML2TEX_ALIGN_LEFT, HTML2TEX_ALIGN_CENTER, HTML2TEX_ALIGN_RIGHT, HTML2TEX_ALIGN_JUSTIFY } HTML2TeXTextAlign;
+    typedef enum { HTML2TEX_BORDER_OTHER, HTML2TEX_BORDER_SOLID } HTML2TeXBorderStyle;
+    typedef enum { HTML2TEX_DISPLAY_OTHER, HTML2TEX_DISPLAY_NONE, HTML2TEX_DISPLAY_BLOCK, HTML2TEX_DISPLAY_INLINE, HTML2TEX_DISPLAY_INLINE_BLOCK } HTML2TeXDisplay;
+    typedef enum { HTML2TEX_FLOAT_OTHER, HTML2TEX_FLOAT_NONE, HTML2TEX_FLOAT_LEFT, HTML2TEX_FLOAT_RIGHT } HTML2TeXFloat;
+    typedef enum { HTML2TEX_VALIGN_OTHER, HTML2TEX_VALIGN_BASELINE, HTML2TEX_VALIGN_TOP, HTML2TEX_VALIGN_MIDDLE, HTML2TEX_VALIGN_BOTTOM } HTML2TeXVerticalAlign;
+
+    /* text-decoration lines, combined as bits */
+    #define HTML2TEX_DECORATION_UNDERLINE     0x1u
+    #define HTML2TEX_DECORATION_LINE_THROUGH  0x2u
+    #define HTML2TEX_DECORATION_OVERLINE      0x4u
+
+	/* Inline style parsed once; a field is meaningful only when its bit is in present. */
 	struct CSSProperties {
-		char* font_weight;
-		char* font_style;
+		unsigned int present;
 		
-		char* font_family;
-		char* font_size;
+		/* lengths, already converted to points */
+		int font_size;
+		int width;
+		int height;
 		
-		char* color;
-		char* background_color;
+		int margin_top;
+		int margin_bottom;
 		
-		char* text_align;
-		char* text_decoration;
+		int margin_left;
+		int margin_right;
 		
-		char* margin_top;
-		char* margin_bottom;
+		int padding_top;
+		int padding_bottom;
 		
-		char* margin_left;
-		char* margin_right;
+		int padding_left;
+		int padding_right;
 		
-		char* padding_top;
-		char* padding_bottom;
+		/* colors packed as 0xRRGGBB */
+		unsigned int color;
+		unsigned int background_color;
+		unsigned int border_color;
 		
-		char* padding_left;
-		char* padding_right;
+		/* keyword values from the enums above */
+		unsigned char font_weight;
+		unsigned char font_style;
+		unsigned char font_family;
+		unsigned char text_align;
 		
-		char* width;
-		char* height;
+		unsigned char text_decoration;
+		unsigned char border_style;
+		unsigned char display;
 		
-		char* border;
-		char* border_color;
-		char* display;
-		
-		char* float_pos;
-		char* vertical_align;
+		unsigned char float_pos;
+		unsigned char vertical_align;
 	};
 
+    /* Receives size bytes of LaTeX output and returns how many of them were written. */
+    typedef size_t (*html2tex_sink_fn)(void* context, const char* data, size_t size);
+
+    /* output buffered by a streaming conversion before each sink call */
+    #define HTML2TEX_SINK_BUFFER_SIZE 65536
+
+    /* style attributes a converter memoizes unless told otherwise */
+    #define HTML2TEX_STYLE_CACHE_SIZE 256
+
+    /* images a converter downloads at once unless told otherwise */
+    #define HTML2TEX_DOWNLOAD_CONCURRENCY 8
+
     /* main converter structure */
     struct LaTeXConverter {
         char* output;
@@ -118,6 +242,23 @@ extern "C" {
 		
         size_t output_capacity;
         ConverterState state;
+
+        /* set while streaming; output then holds only unflushed data */
+        html2tex_sink_fn sink;
+        void* sink_context;
+
+        /* keep the output buffer and its capacity between conversions */
+        int retain_output;
+
+        /* parsed and rendered style attributes, created on first use */
+        CSSStyleCache* style_cache;
+        size_t style_cache_size;
+
+        size_t style_cache_hits;
+        size_t style_cache_misses;
+
+        /* deepest element nesting converted, 0 for no limit */
+        size_t max_depth;
 		
         int error_code;
         char error_message[256];
@@ -125,8 +266,25 @@ extern "C" {
 		char* image_output_dir;
         int download_images;
 		int image_counter;
+
+        /* downloads images concurrently over reused connections, created on first use */
+        ImageDownloader* downloader;
+        int download_concurrency;
+
+        /* fetch images on a background thread while the conversion goes on */
+        int async_images;
+
+        /* images kept on disk across conversions, NULL unless configured */
+        ImageCache* image_cache;
     };
 
+    /* outcome of one document in a batch conversion */
+    typedef struct {
+        char* output;  /* LaTeX document to release with free(), NULL on failure */
+        int error_code;
+        char error_message[256];
+    } HTML2TeXResult;
+
     /* Creates a new LaTeXConverter* and allocates memory. */
     LaTeXConverter* html2tex_create(void);
 	
@@ -138,7 +296,34 @@ extern "C" {
     
 	/* Parses input HTML and converts it to LaTeX. */
     char* html2tex_convert(LaTeXConverter* converter, const char* html);
-	
+
+	/* Converts an already parsed DOM tree to LaTeX without re-parsing it. */
+	char* html2tex_convert_dom(LaTeXConverter* converter, HTMLNode* root);
+
+	/* Like html2tex_convert, but returns the converter's own buffer, valid until its next conversion. */
+	const char* html2tex_convert_view(LaTeXConverter* converter, const char* html, size_t* length);
+
+	/* Like html2tex_convert_dom, but returns the converter's own buffer, valid until its next conversion. */
+	const char* html2tex_convert_dom_view(LaTeXConverter* converter, HTMLNode* root, size_t* length);
+
+	/* Parses input HTML and streams the LaTeX through sink; returns 0 or the error code. */
+	int html2tex_stream(LaTeXConverter* converter, const char* html, html2tex_sink_fn sink, void* context);
+
+	/* Streams the LaTeX for an already parsed DOM tree through sink; returns 0 or the error code. */
+	int html2tex_stream_dom(LaTeXConverter* converter, HTMLNode* root, html2tex_sink_fn sink, void* context);
+
+	/* Sink writing to the FILE* passed as context. */
+	size_t html2tex_file_sink(void* context, const char* data, size_t size);
+
+	/* Sink writing to the file descriptor passed as context, cast through intptr_t. */
+	size_t html2tex_fd_sink(void* context, const char* data, size_t size);
+
+	/* Converts count documents on a pool of threads (0 picks one per CPU), each worker using the
+	   image settings of the optional converter; results keep input order. Images of document i go
+	   to document_<i> below the image directory. Returns 0 once all ran. */
+	int html2tex_convert_batch(const LaTeXConverter* settings, const char* const* html, size_t count,
+		HTML2TeXResult* results, int threads);
+
 	/* Returns the error code from the HTML-to-LaTeX conversion. */
     int html2tex_get_error(const LaTeXConverter* converter);
 	
@@ -148,42 +333,186 @@ extern "C" {
 	/* Append a string to the LaTeX output buffer with optimized copying. */
     void append_string(LaTeXConverter* converter, const char* str);
 	
+	/* Appends len bytes of str, which need not be null-terminated. */
+	void append_string_len(LaTeXConverter* converter, const char* str, size_t len);
+
+	/* Hands the buffered output of a streaming converter to its sink. */
+	void html2tex_flush_output(LaTeXConverter* converter);
+	
 	/* Recursively converts a DOM child node to LaTeX. */
     void convert_children(LaTeXConverter* converter, HTMLNode* node);
 
     /* Parse the virtual DOM tree without optimizations. */
     HTMLNode* html2tex_parse(const char* html);
-	
+
+	/* Parses length bytes of HTML using the HTML2TEX_PARSE_* options. */
+	HTMLNode* html2tex_parse_ex(const char* html, size_t length, int options);
+
+	/* Like html2tex_parse_ex, with content nested deeper than max_depth elements moved up to that depth; 0 keeps any depth. */
+	HTMLNode* html2tex_parse_bounded(const char* html, size_t length, int options, size_t max_depth);
+
+	/* Parses a writable buffer in place; the DOM points into it, so it must outlive the tree. */
+	HTMLNode* html2tex_parse_insitu(char* html, size_t length);
+
+	/* Parses the file at path with the HTML2TEX_PARSE_* options, tokenizing a memory mapping of it when possible and reading it in chunks otherwise; NULL if it cannot be read. */
+	HTMLNode* html2tex_parse_file(const char* path, int options);
+
+	/* Creates a push parser that builds the DOM from input fed in chunks. */
+	HTMLStreamParser* html2tex_parser_create(int options);
+
+	/* Parses the next chunk; tokens split across chunks are kept until complete. Returns 0 on success. */
+	int html2tex_parser_feed(HTMLStreamParser* parser, const char* data, size_t length);
+
+	/* Ends the input and returns the DOM tree; the parser is released in any case. */
+	HTMLNode* html2tex_parser_finish(HTMLStreamParser* parser);
+
+	/* Bounds the element nesting of the tree like html2tex_parse_bounded; HTML2TEX_MAX_DEPTH by default. */
+	void html2tex_parser_set_max_depth(HTMLStreamParser* parser, size_t max_depth);
+
+	/* Releases a parser that will not be finished, together with its partial tree. */
+	void html2tex_parser_destroy(HTMLStreamParser* parser);
+
 	/* Parse HTML and return a minified DOM tree. */
 	HTMLNode* html2tex_parse_minified(const char* html);
 	
 	/* Creates a new instance from the input DOM tree. */
 	HTMLNode* dom_tree_copy(HTMLNode* node);
 	
+	/* Recomputes the cached flags and tag identifiers of a DOM tree built or edited by hand. */
+	void html2tex_annotate_dom(HTMLNode* root);
+
+	/* Returns the node after node in a depth-first walk of root, entering its children only if descend is set; NULL at the end. Follows parent links, never allocates. */
+	HTMLNode* html2tex_dom_next(const HTMLNode* root, HTMLNode* node, int descend);
+
+	/* Returns the HTML2TeXTag of a lowercase element name, or HTML2TEX_TAG_UNKNOWN. */
+	int html2tex_tag_lookup(const char* name, size_t length);
+
+	/* Returns the element name of a known tag identifier. */
+	const char* html2tex_tag_name(int tag_id);
+
+	/* Returns the HTML2TEX_TAG_IS_* classes of a tag identifier. */
+	unsigned int html2tex_tag_flags(int tag_id);
+
+	/* Returns the tag identifier of a node, resolving and caching it on first use. */
+	int html2tex_node_tag(HTMLNode* node);
+
+	/* Returns the index of the first byte escape_latex may rewrite, or length if there is none. */
+	size_t html2tex_scan_latex(const char* text, size_t length);
+
+	/* Returns the index of the first ASCII whitespace byte, or length if there is none. */
+	size_t html2tex_scan_space(const char* text, size_t length);
+
+	/* Decodes the leading whole groups of base64 characters, stopping at padding, whitespace or an invalid byte; returns the characters consumed, 3 bytes written to out per 4. */
+	size_t html2tex_decode_base64(const char* text, size_t length, unsigned char* out);
+
+	/* Names the scanning kernels picked for this CPU: "avx2", "sse2" or "scalar". */
+	const char* html2tex_scan_isa(void);
+
 	/* Frees the memory for the HTMLNode* instance. */
     void html2tex_free_node(HTMLNode* node);
+
+	/* Creates an empty arena-backed document and returns its root node. */
+	HTMLNode* html2tex_arena_document(size_t size_hint);
+
+	/* Returns the arena owned by an arena document root, or NULL. */
+	HTMLArena* html2tex_node_arena(HTMLNode* root);
+
+	/* Allocates aligned memory that lives until the arena is released. */
+	void* html2tex_arena_alloc(HTMLArena* arena, size_t size);
+
+	/* Copies length bytes of str into the arena as a null-terminated string. */
+	char* html2tex_arena_strndup(HTMLArena* arena, const char* str, size_t length);
+
+	/* Frees an arena document together with every node allocated from it. */
+	void html2tex_arena_release(HTMLNode* root);
 	
 	/* Sets the download output directory. */
     void html2tex_set_image_directory(LaTeXConverter* converter, const char* dir);
 	
 	/* Toggles image downloading according to the enable flag. */
     void html2tex_set_download_images(LaTeXConverter* converter, int enable);
+
+	/* Bounds how many images are downloaded at once; connections to each host are kept open between them. */
+	void html2tex_set_download_concurrency(LaTeXConverter* converter, int limit);
+
+	/* Keeps every image under directory keyed by its src, up to max_bytes (0 for no bound); NULL turns it off. */
+	int html2tex_set_image_cache(LaTeXConverter* converter, const char* directory, unsigned long long max_bytes);
+
+	/* Fetches and decodes images in the background while converting, waiting for them once at the end; images that fail are still referenced. */
+	void html2tex_set_async_images(LaTeXConverter* converter, int enable);
+
+	/* Keeps the output buffer allocated between conversions, so repeated calls stop reallocating. */
+	void html2tex_set_retain_output(LaTeXConverter* converter, int enable);
+	
+	/* Bounds how many style attributes the converter memoizes; 0 disables the cache. */
+	void html2tex_set_style_cache_size(LaTeXConverter* converter, size_t entries);
+	
+	/* Reports how many style attributes were served from the cache and how many were parsed. */
+	void html2tex_get_style_cache_stats(const LaTeXConverter* converter, size_t* hits, size_t* misses);
+
+	/* Bounds the element nesting parsed and converted; deeper DOM trees fail with error 14, 0 removes the limit. */
+	void html2tex_set_max_depth(LaTeXConverter* converter, size_t max_depth);
 	
 	/* Downloads an image from the specified URL. */
 	char* download_image_src(const char* src, const char* output_dir, int image_counter);
 	
+	/* Creates a download engine running up to concurrency transfers, over connections it keeps per host. */
+	ImageDownloader* image_downloader_create(int concurrency);
+	
+	/* Downloads the remote images of the DOM tree into output_dir at once, ahead of their conversion. */
+	void image_downloader_prefetch(ImageDownloader* downloader, ImageCache* cache, HTMLNode* root, const char* output_dir);
+	
+	/* Same as download_image_src, served from the cache or the prefetched images first; downloader and cache may be NULL. */
+	char* image_downloader_fetch(ImageDownloader* downloader, ImageCache* cache, const char* src, const char* output_dir, int image_counter);
+	
+	/* Moves fetching and decoding to a background thread; fetch then names the image and returns at once. */
+	int image_downloader_start(ImageDownloader* downloader);
+	
+	/* Waits until every image handed to a started downloader is saved or has failed; each src must stay valid until then. */
+	void image_downloader_wait(ImageDownloader* downloader);
+	
+	/* Forgets the prefetched images and removes those no element claimed; connections stay open. */
+	void image_downloader_reset(ImageDownloader* downloader);
+	
+	/* Closes the connections of the downloader and frees it. */
+	void image_downloader_destroy(ImageDownloader* downloader);
+	
+	/* Opens the image cache in directory, shared with every converter of the process using the same one. */
+	ImageCache* image_cache_open(const char* directory, unsigned long long max_bytes);
+	
+	/* Adds an owner to the cache, each released with image_cache_release. */
+	ImageCache* image_cache_retain(ImageCache* cache);
+	
+	/* Drops an owner of the cache; the last one writes its index and frees it. */
+	void image_cache_release(ImageCache* cache);
+	
+	/* Copies the cached image of src to path; returns 1 on success, 0 when it is not cached. */
+	int image_cache_fetch(ImageCache* cache, const char* src, const char* path);
+	
+	/* Returns whether the image of src is cached. */
+	int image_cache_contains(ImageCache* cache, const char* src);
+	
+	/* Adds the image at path as the one of src, evicting the least recently used beyond the bound. */
+	void image_cache_store(ImageCache* cache, const char* src, const char* path);
+	
+	/* Writes the index of the cache if it changed. */
+	void image_cache_flush(ImageCache* cache);
+	
 	/* Returns whether src contains a base64-encoded image. */
 	int is_base64_image(const char* src);
 	
-	/* Initializes download processing. */
+	/* Initializes download processing once per process; safe to call from any thread. */
 	int image_utils_init(void);
 	
-	/* Frees image-download resources. */
+	/* Ends a download session; the shared resources are released at exit. */
 	void image_utils_cleanup(void);
 	
 	/* Parses inline CSS from style. */
 	CSSProperties* parse_css_style(const char* style_str);
 	
+	/* Parses inline CSS into props in one pass, without allocating. */
+	void parse_css_style_into(const char* style_str, CSSProperties* props);
+	
 	/* Releases memory used by CSSProperties for managing styles. */
 	void free_css_properties(CSSProperties* props);
 
@@ -192,9 +521,21 @@ extern "C" {
 	
 	/* Finalizes inline CSS and frees resources. */
 	void end_css_properties(LaTeXConverter* converter, CSSProperties* props, const char* tag_name);
+	
+	/* Applies a style attribute through the converter's cache and stores its properties in props. */
+	CSSProperties* apply_css_style(LaTeXConverter* converter, const char* style_str, int tag_id, CSSProperties* props);
+	
+	/* Releases a style cache and everything memoized in it. */
+	void free_css_style_cache(CSSStyleCache* cache);
 
 	/* Return the DOM tree after minification. */
 	HTMLNode* html2tex_minify_html(HTMLNode* root);
+
+	/* Minifies the DOM tree in place, shrinking its text where it lies instead of reallocating anything. */
+	void html2tex_minify_insitu(HTMLNode* root);
+
+	/* Collapses whitespace runs of length bytes of text to single spaces, trimming both ends; returns the new length. */
+	size_t html2tex_collapse_space(char* text, size_t length);
 	
 	/* Writes formatted HTML to the output file. */
 	int write_pretty_html(HTMLNode* root, const char* filename);
@@ -202,6 +543,12 @@ extern "C" {
 	/* Returns the HTML as a formatted string. */
 	char* get_pretty_html(HTMLNode* root);
 
+	/* Writes the DOM tree as an HTML document through sink, using the HTML2TEX_SERIALIZE_* options; returns 0, or -1 if the sink fails. */
+	int html2tex_serialize(HTMLNode* root, int options, html2tex_sink_fn sink, void* context);
+
+	/* Returns the DOM tree as a new HTML string, storing its length in length when that is not NULL. */
+	char* html2tex_serialize_string(HTMLNode* root, int options, size_t* length);
+
 	/* Converts a CSS length to LaTeX points. */
 	int css_length_to_pt(const char* length_str);
 	
@@ -3,14 +3,16 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 #include "html2tex.h"
 #include <iostream>
 
 class HtmlParser {
 private:
-    std::unique_ptr<HTMLNode, decltype(&html2tex_free_node)> node;
+    /* shared between copies, cloned by the first one to modify it */
+    std::shared_ptr<HTMLNode> node;
     int minify;
-    void setParent(std::unique_ptr<HTMLNode, decltype(&html2tex_free_node)> new_node) noexcept;
+    void setParent(HTMLNode* new_node) noexcept;
 
 public:
     /* Create an empty, valid parser instance. */
@@ -22,21 +24,29 @@ public:
     /* Initializes parser from HTML with optimization flag. */
     HtmlParser(const std::string&, int) noexcept;
 
-    /* Initializes the parser with the input DOM tree. */
+    /* Initializes the parser with a copy of the input DOM tree. */
     explicit HtmlParser(HTMLNode*);
 
-    /* Instantiates the parser with the DOM tree and the minify option. */
+    /* Instantiates the parser with a copy of the DOM tree and the minify option. */
     HtmlParser(HTMLNode*, int) noexcept;
 
-    /* Clones an existing HtmlParser to create a new parser. */
+    /* Takes ownership of the DOM tree without copying it. */
+    explicit HtmlParser(std::unique_ptr<HTMLNode, decltype(&html2tex_free_node)>, int = 0) noexcept;
+
+    /* Shares the DOM tree of an existing HtmlParser; neither copies it until modified. */
     HtmlParser(const HtmlParser&) noexcept;
 
     /* Efficiently moves an existing HtmlParser instance. */
     HtmlParser(HtmlParser&&) noexcept;
 
-    /* Return a pointer to the DOM trees root node. */
+    /* Return a pointer to the DOM trees root node, shared with copies of this parser; it is for
+       reading only, since writing through it changes every copy. Use getMutableHtmlNode to edit. */
     HTMLNode* getHtmlNode() const noexcept;
 
+    /* Return the root node for modification, first cloning a tree other parsers share; the
+       pointer is for edits until this parser is next copied. */
+    HTMLNode* getMutableHtmlNode() noexcept;
+
     /* Check whether the parser contains content. */
     bool hasContent() const noexcept;
 
@@ -52,14 +62,33 @@ public:
     /* Creates a parser from the given HTML file path. */
     static HtmlParser fromHtml(const std::string&) noexcept;
 
+    /* Creates a parser from the given HTML file path, minified while it is parsed if requested. */
+    static HtmlParser fromHtml(const std::string&, int) noexcept;
+
+    /* Creates a parser owning the DOM tree, which is released with it and must not be freed elsewhere. */
+    static HtmlParser adopt(HTMLNode*, int = 0) noexcept;
+
     /* Write the DOM tree in HTML format to the file at the specified path. */
     void writeTo(const std::string&) const;
 
-    /* Returns prettified HTML from this instance. */
-    std::string toString() const noexcept;
+    /* Write the DOM tree in HTML format straight into any output stream, compact without indentation. */
+    void writeTo(std::ostream&, bool compact = false) const;
+
+    /* Returns prettified HTML from this instance, or compact HTML on request. */
+    std::string toString(bool compact = false) const noexcept;
     ~HtmlParser() = default;
 };
 
+/* Outcome of one document converted by HtmlTeXConverter::convertBatch. */
+struct HtmlTeXResult {
+    std::string output;
+    int errorCode;
+    std::string errorMessage;
+
+    /* Check whether the document was converted. */
+    bool ok() const noexcept { return errorCode == 0; }
+};
+
 class HtmlTeXConverter {
 private:
     std::unique_ptr<LaTeXConverter, decltype(&html2tex_destroy)> converter;
@@ -85,12 +114,43 @@ public:
     /* Convert the HtmlParser instance to LaTeX and write the result to a file. */
     bool convertToFile(const HtmlParser&, std::ofstream&) const;
 
+    /* Convert the HtmlParser instance to LaTeX, streaming the result into any output stream. */
+    bool convertToFile(const HtmlParser&, std::ostream&) const;
+
+    /* Convert many HTML documents in parallel (0 threads means one per CPU); results keep the input order. */
+    std::vector<HtmlTeXResult> convertBatch(const std::vector<std::string>&, unsigned int threads = 0) const;
+
     /*
        Set the directory where images extracted from the DOM tree are saved.
        @return true on success, false otherwise.
     */
     bool setDirectory(const std::string&) const noexcept;
 
+    /* Keep the conversion buffer between calls, for converters reused on many documents. */
+    void setRetainOutput(bool) const noexcept;
+
+    /* Bound the cache of parsed style attributes, 0 turns it off. */
+    void setStyleCacheSize(std::size_t) const noexcept;
+
+    /* Style attributes served from the cache, and those parsed from scratch. */
+    std::size_t getStyleCacheHits() const noexcept;
+    std::size_t getStyleCacheMisses() const noexcept;
+
+    /* Bound the element nesting of converted documents, 0 removes the limit. */
+    void setMaxDepth(std::size_t) const noexcept;
+
+    /* Bound how many images are downloaded at once, over connections kept per host. */
+    void setDownloadConcurrency(int) const noexcept;
+
+    /* Fetch images in the background while converting, waiting for all of them before returning. */
+    void setAsyncImages(bool) const noexcept;
+
+    /*
+       Keep images in a directory shared across conversions, bounded to maxBytes (0 for no bound).
+       An empty directory turns the cache off; @return true on success, false otherwise.
+    */
+    bool setImageCache(const std::string&, unsigned long long = 0) const noexcept;
+
     /* Check for errors during conversion. */
     bool hasError() const;
 
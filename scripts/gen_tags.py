@@ -0,0 +1,160 @@
+#!/usr/bin/env python3
+"""Generates source/html2tex_tags.c from the tag enum in include/html2tex.h.
+
+Run it after adding a tag to the enum or changing a tag class below:
+
+    python3 scripts/gen_tags.py
+"""
+import os
+import re
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+HEADER = os.path.join(ROOT, "include", "html2tex.h")
+OUTPUT = os.path.join(ROOT, "source", "html2tex_tags.c")
+SLOTS = 1024
+
+CLASSES = {
+    "HTML2TEX_TAG_IS_BLOCK": """
+        div p h1 h2 h3 h4 h5 h6 ul ol li table tr td th blockquote section
+        article header footer nav aside main figure figcaption""",
+    "HTML2TEX_TAG_IS_INLINE": """
+        a abbr b bdi bdo cite code data dfn em font i kbd mark q rp rt ruby
+        samp small span strong sub sup time u var wbr br img map object button
+        input label meter output progress select textarea""",
+    "HTML2TEX_TAG_IS_EXCLUDED": """
+        script style link meta head noscript template iframe form input label
+        canvas svg video source audio object button map area frame frameset
+        noframes nav picture progress select option param search samp track
+        var wbr mark meter optgroup q blockquote bdo""",
+    "HTML2TEX_TAG_IS_VOID": """
+        area base br col embed hr img input link meta param source track wbr""",
+    "HTML2TEX_TAG_IS_PRESERVE_WS": """
+        pre code textarea script style""",
+    "HTML2TEX_TAG_IS_ESSENTIAL": """
+        br hr img input meta link""",
+    "HTML2TEX_TAG_IS_PHRASING": """
+        a abbr b bdi bdo br cite code data dfn em font i kbd mark q rp rt ruby
+        s samp small span strong sub sup time u var wbr""",
+}
+
+
+def read_tags():
+    with open(HEADER) as f:
+        text = f.read()
+
+    block = re.search(r"HTML2TEX_TAG_UNKNOWN,(.*?)HTML2TEX_TAG_COUNT", text, re.S).group(1)
+    return [name.lower() for name in re.findall(r"HTML2TEX_TAG_(\w+)", block)]
+
+
+def fnv1a(seed, name):
+    h = (2166136261 ^ seed) & 0xFFFFFFFF
+
+    for c in name.encode():
+        h = ((h ^ c) * 16777619) & 0xFFFFFFFF
+
+    return h
+
+
+def find_seed(tags):
+    for seed in range(1 << 20):
+        slots = {fnv1a(seed, tag) % SLOTS for tag in tags}
+        if len(slots) == len(tags):
+            return seed
+
+    raise SystemExit("no collision-free seed found, increase SLOTS")
+
+
+def main():
+    tags = read_tags()
+    first_id = 2
+    seed = find_seed(tags)
+
+    for cls, names in CLASSES.items():
+        missing = set(names.split()) - set(tags)
+        if missing:
+            raise SystemExit("%s names unknown tags: %s" % (cls, " ".join(sorted(missing))))
+
+    slots = [0] * SLOTS
+    for i, tag in enumerate(tags):
+        slots[fnv1a(seed, tag) % SLOTS] = first_id + i
+
+    out = []
+    out.append("/* Generated by scripts/gen_tags.py from the tag enum in html2tex.h; do not edit. */")
+    out.append('#include "html2tex.h"')
+    out.append("#include <string.h>")
+    out.append("")
+    out.append("#define TAG_HASH_SEED %du" % seed)
+    out.append("#define TAG_HASH_SLOTS %d" % SLOTS)
+    out.append("#define TAG_MAX_LENGTH %d" % max(len(t) for t in tags))
+    out.append("")
+    out.append("static const char* const tag_names[HTML2TEX_TAG_COUNT] = {")
+    out.append("    NULL, NULL,")
+    for i in range(0, len(tags), 8):
+        out.append("    " + " ".join('"%s",' % t for t in tags[i:i + 8]))
+    out.append("};")
+    out.append("")
+    out.append("static const unsigned int tag_flags[HTML2TEX_TAG_COUNT] = {")
+    out.append("    0, 0,")
+    for tag in tags:
+        flags = [cls for cls, names in CLASSES.items() if tag in names.split()]
+        out.append("    %s, /* %s */" % (" | ".join(flags) if flags else "0", tag))
+    out.append("};")
+    out.append("")
+    out.append("/* perfect hash: every known name maps to its own slot */")
+    out.append("static const unsigned char tag_slots[TAG_HASH_SLOTS] = {")
+    for i in range(0, SLOTS, 16):
+        out.append("    " + ", ".join("%d" % s for s in slots[i:i + 16]) + ",")
+    out.append("};")
+    out.append("""
+int html2tex_tag_lookup(const char* name, size_t length) {
+    if (!name || length == 0 || length > TAG_MAX_LENGTH)
+        return HTML2TEX_TAG_UNKNOWN;
+
+    /* FNV-1a with a seed chosen so the known names never collide */
+    unsigned int hash = 2166136261u ^ TAG_HASH_SEED;
+
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)name[i];
+        hash *= 16777619u;
+    }
+
+    const int id = tag_slots[hash % TAG_HASH_SLOTS];
+
+    /* one comparison rejects names that merely share a slot, stopping at the shorter one */
+    if (id && strncmp(tag_names[id], name, length) == 0 && tag_names[id][length] == '\\0')
+        return id;
+
+    return HTML2TEX_TAG_UNKNOWN;
+}
+
+const char* html2tex_tag_name(int tag_id) {
+    if (tag_id <= HTML2TEX_TAG_UNKNOWN || tag_id >= HTML2TEX_TAG_COUNT)
+        return NULL;
+
+    return tag_names[tag_id];
+}
+
+unsigned int html2tex_tag_flags(int tag_id) {
+    if (tag_id <= HTML2TEX_TAG_UNKNOWN || tag_id >= HTML2TEX_TAG_COUNT)
+        return 0;
+
+    return tag_flags[tag_id];
+}
+
+int html2tex_node_tag(HTMLNode* node) {
+    if (!node) return HTML2TEX_TAG_UNKNOWN;
+
+    /* resolve once, then every later query is a field read */
+    if (node->tag_id == HTML2TEX_TAG_UNRESOLVED)
+        node->tag_id = node->tag ? html2tex_tag_lookup(node->tag, strlen(node->tag))
+            : HTML2TEX_TAG_UNKNOWN;
+
+    return node->tag_id;
+}""")
+
+    with open(OUTPUT, "w") as f:
+        f.write("\n".join(out) + "\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -10,6 +10,18 @@ LaTeXConverter* html2tex_create(void) {
     converter->output_size = 0;
 
     converter->output_capacity = 0;
+    converter->sink = NULL;
+
+    converter->sink_context = NULL;
+    converter->retain_output = 0;
+
+    converter->style_cache = NULL;
+    converter->style_cache_size = HTML2TEX_STYLE_CACHE_SIZE;
+
+    converter->style_cache_hits = 0;
+    converter->style_cache_misses = 0;
+
+    converter->max_depth = HTML2TEX_MAX_DEPTH;
     converter->state.indent_level = 0;
 
     converter->state.list_level = 0;
@@ -51,6 +63,11 @@ LaTeXConverter* html2tex_create(void) {
     converter->download_images = 0;
     converter->image_counter = 0;
 
+    converter->downloader = NULL;
+    converter->download_concurrency = HTML2TEX_DOWNLOAD_CONCURRENCY;
+    converter->image_cache = NULL;
+    converter->async_images = 0;
+
     converter->error_message[0] = '\0';
     return converter;
 }
@@ -60,10 +77,35 @@ LaTeXConverter* html2tex_copy(LaTeXConverter* converter) {
     LaTeXConverter* clone = malloc(sizeof(LaTeXConverter));
 
     if (!clone) return NULL;
-    clone->output = converter->output ? strdup(converter->output) : NULL;
-    clone->output_size = converter->output_size;
+    clone->output = NULL;
+    clone->output_size = 0;
+
+    clone->output_capacity = 0;
+
+    /* the copy gets the same capacity, writers rely on it */
+    if (converter->output && converter->output_capacity > 0) {
+        clone->output = malloc(converter->output_capacity);
+
+        if (clone->output) {
+            memcpy(clone->output, converter->output, converter->output_size + 1);
+            clone->output_size = converter->output_size;
+            clone->output_capacity = converter->output_capacity;
+        }
+    }
+
+    clone->sink = NULL;
+    clone->sink_context = NULL;
+
+    clone->retain_output = converter->retain_output;
 
-    clone->output_capacity = converter->output_capacity;
+    /* the copy starts with an empty cache of the same size */
+    clone->style_cache = NULL;
+    clone->style_cache_size = converter->style_cache_size;
+
+    clone->style_cache_hits = 0;
+    clone->style_cache_misses = 0;
+
+    clone->max_depth = converter->max_depth;
     clone->state.indent_level = converter->state.indent_level;
 
     clone->state.list_level = converter->state.list_level;
@@ -83,7 +125,7 @@ LaTeXConverter* html2tex_copy(LaTeXConverter* converter) {
 
     clone->state.current_column = converter->state.current_column;
     clone->state.table_caption = converter->state.table_caption ? 
-        strdup(converter->state.table_caption) : NULL;
+        html2tex_strdup(converter->state.table_caption) : NULL;
 
     /* copy of CSS state tracking */
     clone->state.css_braces = converter->state.css_braces;
@@ -102,10 +144,18 @@ LaTeXConverter* html2tex_copy(LaTeXConverter* converter) {
     clone->error_code = converter->error_code;
 
     /* copy image configuration */
-    clone->image_output_dir = converter->image_output_dir ? strdup(converter->image_output_dir) : NULL;
+    clone->image_output_dir = converter->image_output_dir ? html2tex_strdup(converter->image_output_dir) : NULL;
     clone->download_images = converter->download_images;
     clone->image_counter = converter->image_counter;
 
+    /* connections are not shared, the copy opens its own */
+    clone->downloader = NULL;
+    clone->download_concurrency = converter->download_concurrency;
+    clone->async_images = converter->async_images;
+
+    /* the image cache is shared, each copy holds a reference */
+    clone->image_cache = image_cache_retain(converter->image_cache);
+
     /* copy error message safely */
     if (converter->error_message[0] != '\0') {
         strncpy(clone->error_message, converter->error_message, sizeof(clone->error_message) - 1);
@@ -125,7 +175,7 @@ void html2tex_set_image_directory(LaTeXConverter* converter, const char* dir) {
     }
 
     if (dir && dir[0] != '\0')
-        converter->image_output_dir = strdup(dir);
+        converter->image_output_dir = html2tex_strdup(dir);
 }
 
 void html2tex_set_download_images(LaTeXConverter* converter, int enable) {
@@ -133,21 +183,115 @@ void html2tex_set_download_images(LaTeXConverter* converter, int enable) {
         converter->download_images = enable ? 1 : 0;
 }
 
+void html2tex_set_download_concurrency(LaTeXConverter* converter, int limit) {
+    if (!converter) return;
+
+    /* the next download recreates the engine with the new bound */
+    image_downloader_destroy(converter->downloader);
+    converter->downloader = NULL;
+    converter->download_concurrency = limit > 0 ? limit : 1;
+}
+
+void html2tex_set_async_images(LaTeXConverter* converter, int enable) {
+    if (!converter) return;
+
+    /* the next download recreates the engine in the new mode */
+    image_downloader_destroy(converter->downloader);
+    converter->downloader = NULL;
+    converter->async_images = enable ? 1 : 0;
+}
+
+int html2tex_set_image_cache(LaTeXConverter* converter, const char* directory, unsigned long long max_bytes) {
+    if (!converter) return -1;
+    ImageCache* cache = NULL;
+
+    if (directory && directory[0] != '\0') {
+        cache = image_cache_open(directory, max_bytes);
+
+        /* the previous cache stays when the directory cannot be used */
+        if (!cache) return -1;
+    }
+
+    image_cache_release(converter->image_cache);
+    converter->image_cache = cache;
+    return 0;
+}
+
+void html2tex_set_retain_output(LaTeXConverter* converter, int enable) {
+    if (converter)
+        converter->retain_output = enable ? 1 : 0;
+}
+
+void html2tex_set_style_cache_size(LaTeXConverter* converter, size_t entries) {
+    if (!converter) return;
+
+    /* the next styled element recreates the cache with the new bound */
+    free_css_style_cache(converter->style_cache);
+    converter->style_cache = NULL;
+    converter->style_cache_size = entries;
+}
+
+void html2tex_get_style_cache_stats(const LaTeXConverter* converter, size_t* hits, size_t* misses) {
+    if (hits) *hits = converter ? converter->style_cache_hits : 0;
+    if (misses) *misses = converter ? converter->style_cache_misses : 0;
+}
+
+void html2tex_set_max_depth(LaTeXConverter* converter, size_t max_depth) {
+    if (converter)
+        converter->max_depth = max_depth;
+}
+
+/* Returns a malloc'd copy of the output view, "" for an empty document. */
+static char* copy_output(const char* output, size_t length) {
+    char* result = malloc(length + 1);
+
+    if (result) {
+        if (length > 0) memcpy(result, output, length);
+        result[length] = '\0';
+    }
+
+    return result;
+}
+
 char* html2tex_convert(LaTeXConverter* converter, const char* html) {
+    size_t length;
+    const char* output = html2tex_convert_view(converter, html, &length);
+    return output ? copy_output(output, length) : NULL;
+}
+
+const char* html2tex_convert_view(LaTeXConverter* converter, const char* html, size_t* length) {
     if (!converter || !html)
         return NULL;
 
+    /* the tree only lives for this call, so keep it in one arena */
+    HTMLNode* root = html2tex_parse_bounded(html, strlen(html), HTML2TEX_PARSE_ARENA, converter->max_depth);
+
+    if (!root) {
+        converter->error_code = 1;
+        strcpy(converter->error_message, "Failed to parse HTML");
+        return NULL;
+    }
+
+    const char* output = html2tex_convert_dom_view(converter, root, length);
+    html2tex_free_node(root);
+    return output;
+}
+
+/* Writes the complete LaTeX document for root into the converter output. */
+static void render_document(LaTeXConverter* converter, HTMLNode* root) {
     /* initialize image utilities if downloading is enabled */
     if (converter->download_images) image_utils_init();
 
-    /* reset converter state */
-    if (converter->output) {
+    /* reset converter state, a retained buffer is only emptied */
+    if (converter->output && converter->retain_output)
+        converter->output[0] = '\0';
+    else {
         free(converter->output);
         converter->output = NULL;
+        converter->output_capacity = 0;
     }
 
     converter->output_size = 0;
-    converter->output_capacity = 0;
 
     converter->error_code = 0;
     converter->error_message[0] = '\0';
@@ -174,39 +318,86 @@ char* html2tex_convert(LaTeXConverter* converter, const char* html) {
     append_string(converter, "\\usepackage{placeins}\n");
     append_string(converter, "\\begin{document}\n\n");
 
-    /* parse HTML and convert */
-    HTMLNode* root = html2tex_parse(html);
+    /* trees built by hand carry no precomputed flags yet */
+    if (!(root->flags & HTML2TEX_NODE_ANNOTATED))
+        html2tex_annotate_dom(root);
 
-    if (root) {
-        convert_children(converter, root);
-        html2tex_free_node(root);
-    }
-    else {
-        converter->error_code = 1;
-        strcpy(converter->error_message, "Failed to parse HTML");
-        return NULL;
+    /* remote images download side by side before the walk needs them */
+    if (converter->download_images && converter->image_output_dir) {
+        if (!converter->downloader) {
+            converter->downloader = image_downloader_create(converter->download_concurrency);
+
+            /* without a thread images are fetched in place */
+            if (converter->async_images) image_downloader_start(converter->downloader);
+        }
+
+        image_downloader_prefetch(converter->downloader, converter->image_cache, root, converter->image_output_dir);
     }
 
+    /* walk the existing tree once, no serialization involved */
+    convert_children(converter, root);
+
+    /* wait for the images still in the background, then drop those no element claimed */
+    image_downloader_reset(converter->downloader);
+    image_cache_flush(converter->image_cache);
+
     /* add document ending */
     append_string(converter, "\n\\end{document}\n");
 
     /* cleanup image utilities if they were initialized */
     if (converter->download_images) image_utils_cleanup();
+}
 
-    /* return a copy of the output */
-    char* result = malloc(converter->output_size + 1);
+char* html2tex_convert_dom(LaTeXConverter* converter, HTMLNode* root) {
+    size_t length;
+    const char* output = html2tex_convert_dom_view(converter, root, &length);
+    return output ? copy_output(output, length) : NULL;
+}
 
-    if (result) {
-        if (converter->output && converter->output_size > 0) {
-            memcpy(result, converter->output, converter->output_size);
-            result[converter->output_size] = '\0';
-        }
-        else result[0] = '\0';
+const char* html2tex_convert_dom_view(LaTeXConverter* converter, HTMLNode* root, size_t* length) {
+    if (!converter || !root)
+        return NULL;
+
+    render_document(converter, root);
+
+    /* hand out the buffer itself instead of a copy */
+    if (length) *length = converter->output_size;
+    return converter->output ? converter->output : "";
+}
+
+int html2tex_stream(LaTeXConverter* converter, const char* html, html2tex_sink_fn sink, void* context) {
+    if (!converter || !html || !sink)
+        return -1;
+
+    HTMLNode* root = html2tex_parse_bounded(html, strlen(html), HTML2TEX_PARSE_ARENA, converter->max_depth);
+
+    if (!root) {
+        converter->error_code = 1;
+        strcpy(converter->error_message, "Failed to parse HTML");
+        return converter->error_code;
     }
 
+    int result = html2tex_stream_dom(converter, root, sink, context);
+    html2tex_free_node(root);
     return result;
 }
 
+int html2tex_stream_dom(LaTeXConverter* converter, HTMLNode* root, html2tex_sink_fn sink, void* context) {
+    if (!converter || !root || !sink)
+        return -1;
+
+    /* the output buffer now only stages one flush worth of LaTeX */
+    converter->sink = sink;
+    converter->sink_context = context;
+
+    render_document(converter, root);
+    html2tex_flush_output(converter);
+
+    converter->sink = NULL;
+    converter->sink_context = NULL;
+    return converter->error_code;
+}
+
 int html2tex_get_error(const LaTeXConverter* converter) {
     return converter ? converter->error_code : -1;
 }
@@ -229,5 +420,8 @@ void html2tex_destroy(LaTeXConverter* converter) {
     if (converter->output)
         free(converter->output);
 
+    free_css_style_cache(converter->style_cache);
+    image_downloader_destroy(converter->downloader);
+    image_cache_release(converter->image_cache);
     free(converter);
 }
\ No newline at end of file
@@ -0,0 +1,133 @@
+#include "html2tex.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define ARENA_MIN_BLOCK 16384
+#define ARENA_MAX_BLOCK 1048576
+#define ARENA_ALIGNMENT 16
+
+typedef struct ArenaBlock ArenaBlock;
+
+struct ArenaBlock {
+    ArenaBlock* next;
+    size_t capacity;
+    size_t used;
+};
+
+struct HTMLArena {
+    ArenaBlock* blocks;
+    size_t next_block_size;
+};
+
+/* A document keeps the arena and its root node in one allocation. */
+typedef struct {
+    HTMLArena arena;
+    HTMLNode root;
+} ArenaDocument;
+
+/* Header size rounded so that block payloads stay aligned. */
+#define BLOCK_HEADER_SIZE \
+    ((sizeof(ArenaBlock) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1))
+
+/* Allocates a new block able to hold at least size bytes. */
+static ArenaBlock* arena_grow(HTMLArena* arena, size_t size) {
+    size_t capacity = arena->next_block_size;
+
+    /* oversized requests get a dedicated block */
+    if (capacity < size) capacity = size;
+    if (capacity > SIZE_MAX - BLOCK_HEADER_SIZE) return NULL;
+
+    ArenaBlock* block = (ArenaBlock*)malloc(BLOCK_HEADER_SIZE + capacity);
+    if (!block) return NULL;
+
+    block->capacity = capacity;
+    block->used = 0;
+    block->next = arena->blocks;
+    arena->blocks = block;
+
+    /* grow geometrically, so a document needs only a few blocks */
+    if (arena->next_block_size < ARENA_MAX_BLOCK)
+        arena->next_block_size *= 2;
+
+    return block;
+}
+
+/* Reserves size bytes at the given power-of-two alignment. */
+static void* arena_reserve(HTMLArena* arena, size_t size, size_t alignment) {
+    if (!arena) return NULL;
+    ArenaBlock* block = arena->blocks;
+
+    if (block) {
+        size_t offset = (block->used + alignment - 1) & ~(alignment - 1);
+
+        if (offset <= block->capacity && size <= block->capacity - offset) {
+            block->used = offset + size;
+            return (char*)block + BLOCK_HEADER_SIZE + offset;
+        }
+    }
+
+    block = arena_grow(arena, size);
+    if (!block) return NULL;
+
+    block->used = size;
+    return (char*)block + BLOCK_HEADER_SIZE;
+}
+
+HTMLNode* html2tex_arena_document(size_t size_hint) {
+    ArenaDocument* document = (ArenaDocument*)calloc(1, sizeof(ArenaDocument));
+    if (!document) return NULL;
+
+    /* size the first block from the input, within sane bounds */
+    size_t block_size = size_hint;
+
+    if (block_size < ARENA_MIN_BLOCK) block_size = ARENA_MIN_BLOCK;
+    if (block_size > ARENA_MAX_BLOCK) block_size = ARENA_MAX_BLOCK;
+
+    document->arena.blocks = NULL;
+    document->arena.next_block_size = block_size;
+
+    document->root.flags = HTML2TEX_NODE_ARENA | HTML2TEX_NODE_ARENA_ROOT;
+    return &document->root;
+}
+
+HTMLArena* html2tex_node_arena(HTMLNode* root) {
+    if (!root || !(root->flags & HTML2TEX_NODE_ARENA_ROOT))
+        return NULL;
+
+    ArenaDocument* document = (ArenaDocument*)((char*)root - offsetof(ArenaDocument, root));
+    return &document->arena;
+}
+
+void* html2tex_arena_alloc(HTMLArena* arena, size_t size) {
+    return arena_reserve(arena, size ? size : 1, ARENA_ALIGNMENT);
+}
+
+char* html2tex_arena_strndup(HTMLArena* arena, const char* str, size_t length) {
+    if (!str) return NULL;
+
+    /* strings need no alignment, so they pack tightly */
+    char* copy = (char*)arena_reserve(arena, length + 1, 1);
+    if (!copy) return NULL;
+
+    if (length > 0) memcpy(copy, str, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+void html2tex_arena_release(HTMLNode* root) {
+    HTMLArena* arena = html2tex_node_arena(root);
+    if (!arena) return;
+
+    /* every node, string and attribute goes away with its block */
+    ArenaBlock* block = arena->blocks;
+
+    while (block) {
+        ArenaBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+
+    free((char*)root - offsetof(ArenaDocument, root));
+}
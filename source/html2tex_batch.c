@@ -0,0 +1,208 @@
+#include "html2tex.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+/* Work shared by the threads of one html2tex_convert_batch call. */
+typedef struct {
+    const LaTeXConverter* settings;
+    const char* const* html;
+    HTML2TeXResult* results;
+    size_t count;
+
+    /* index of the next document nobody has claimed yet */
+    size_t next;
+#ifdef _WIN32
+    CRITICAL_SECTION lock;
+#else
+    pthread_mutex_t lock;
+#endif
+} BatchJob;
+
+static size_t batch_claim(BatchJob* job) {
+#ifdef _WIN32
+    EnterCriticalSection(&job->lock);
+    size_t index = job->next < job->count ? job->next++ : job->count;
+    LeaveCriticalSection(&job->lock);
+#else
+    pthread_mutex_lock(&job->lock);
+    size_t index = job->next < job->count ? job->next++ : job->count;
+    pthread_mutex_unlock(&job->lock);
+#endif
+    return index;
+}
+
+/* Gives each document an image directory of its own below the shared one, so image_N names
+   restart per document without two workers ever allocating the same file. */
+static int set_document_image_directory(LaTeXConverter* converter, const char* base, size_t index) {
+    size_t size = strlen(base) + 32;
+    char* directory = (char*)malloc(size);
+    if (!directory) return 0;
+
+    snprintf(directory, size, "%s/document_%lu", base, (unsigned long)index);
+    html2tex_set_image_directory(converter, directory);
+    free(directory);
+    return converter->image_output_dir != NULL;
+}
+
+static void set_result_error(HTML2TeXResult* result, int code, const char* message) {
+    result->output = NULL;
+    result->error_code = code;
+
+    strncpy(result->error_message, message, sizeof(result->error_message) - 1);
+    result->error_message[sizeof(result->error_message) - 1] = '\0';
+}
+
+/* Converts claimed documents until none are left, on a converter of its own. */
+static void batch_worker(BatchJob* job) {
+    LaTeXConverter* converter = html2tex_create();
+
+    /* the remaining documents go to the other workers */
+    if (!converter) return;
+    const LaTeXConverter* settings = job->settings;
+
+    /* one buffer serves all the documents of this worker */
+    html2tex_set_retain_output(converter, 1);
+
+    if (settings) {
+        html2tex_set_download_images(converter, settings->download_images);
+        html2tex_set_download_concurrency(converter, settings->download_concurrency);
+        html2tex_set_async_images(converter, settings->async_images);
+        html2tex_set_style_cache_size(converter, settings->style_cache_size);
+        html2tex_set_max_depth(converter, settings->max_depth);
+
+        /* workers share the cache, each image is fetched once for all */
+        converter->image_cache = image_cache_retain(settings->image_cache);
+    }
+
+    /* every document starts from the same state, whichever worker runs it */
+    const ConverterState initial = converter->state;
+    const int image_counter = settings ? settings->image_counter : 0;
+    size_t index;
+
+    while ((index = batch_claim(job)) < job->count) {
+        HTML2TeXResult* result = &job->results[index];
+
+        if (!job->html[index]) {
+            set_result_error(result, -1, "Invalid HTML input");
+            continue;
+        }
+
+        if (converter->state.table_caption)
+            free(converter->state.table_caption);
+
+        converter->state = initial;
+        converter->image_counter = image_counter;
+
+        if (settings && settings->image_output_dir &&
+            !set_document_image_directory(converter, settings->image_output_dir, index)) {
+            set_result_error(result, 1, "Memory allocation failed.");
+            continue;
+        }
+
+        char* output = html2tex_convert(converter, job->html[index]);
+
+        if (!output && converter->error_code == 0)
+            set_result_error(result, 1, "Memory allocation failed.");
+        else {
+            result->output = output;
+            result->error_code = converter->error_code;
+            memcpy(result->error_message, converter->error_message, sizeof(result->error_message));
+        }
+    }
+
+    html2tex_destroy(converter);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI batch_thread(LPVOID job) {
+    batch_worker((BatchJob*)job);
+    return 0;
+}
+#else
+static void* batch_thread(void* job) {
+    batch_worker((BatchJob*)job);
+    return NULL;
+}
+#endif
+
+static int online_cpus(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? (int)cpus : 1;
+#endif
+}
+
+int html2tex_convert_batch(const LaTeXConverter* settings, const char* const* html, size_t count,
+    HTML2TeXResult* results, int threads) {
+    if (!results || (!html && count > 0))
+        return -1;
+
+    /* documents a worker never reached keep this error */
+    for (size_t i = 0; i < count; i++)
+        set_result_error(&results[i], -1, "Document was not converted");
+
+    if (count == 0) return 0;
+    if (threads <= 0) threads = online_cpus();
+    if ((size_t)threads > count) threads = (int)count;
+
+    BatchJob job;
+    job.settings = settings;
+    job.html = html;
+    job.results = results;
+    job.count = count;
+    job.next = 0;
+
+#ifdef _WIN32
+    InitializeCriticalSection(&job.lock);
+    HANDLE* handles = (HANDLE*)malloc(sizeof(HANDLE) * (size_t)threads);
+#else
+    if (pthread_mutex_init(&job.lock, NULL) != 0) return -1;
+    pthread_t* handles = (pthread_t*)malloc(sizeof(pthread_t) * (size_t)threads);
+#endif
+
+    int started = 0;
+
+    if (handles) {
+        for (int i = 0; i < threads; i++) {
+#ifdef _WIN32
+            handles[started] = CreateThread(NULL, 0, batch_thread, &job, 0, NULL);
+            if (!handles[started]) break;
+#else
+            if (pthread_create(&handles[started], NULL, batch_thread, &job) != 0) break;
+#endif
+            started++;
+        }
+    }
+
+    /* without any thread the caller does the work itself */
+    if (started == 0) batch_worker(&job);
+
+    for (int i = 0; i < started; i++) {
+#ifdef _WIN32
+        WaitForSingleObject(handles[i], INFINITE);
+        CloseHandle(handles[i]);
+#else
+        pthread_join(handles[i], NULL);
+#endif
+    }
+
+    free(handles);
+#ifdef _WIN32
+    DeleteCriticalSection(&job.lock);
+#else
+    pthread_mutex_destroy(&job.lock);
+#endif
+    return 0;
+}
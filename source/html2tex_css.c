@@ -7,480 +7,874 @@
 
 #define HT_MAX_CSS_PROPERTIES 50
 
-/* Helper function to remove !important and trim whitespace. */
-static char* clean_css_value(const char* value) {
-    if (!value) return NULL;
-
-    /* create a mutable copy */
-    char* cleaned = strdup(value);
-    if (!cleaned) return NULL;
+#define CSS_PROPERTY(name, bit) { name, sizeof(name) - 1, bit }
+
+/* Declarations parse_css_style recognizes, with the bit each one sets. */
+static const struct {
+    const char* name;
+    size_t length;
+    unsigned int bit;
+} css_properties[] = {
+    CSS_PROPERTY("font-weight", HTML2TEX_CSS_FONT_WEIGHT),
+    CSS_PROPERTY("font-style", HTML2TEX_CSS_FONT_STYLE),
+    CSS_PROPERTY("font-family", HTML2TEX_CSS_FONT_FAMILY),
+    CSS_PROPERTY("font-size", HTML2TEX_CSS_FONT_SIZE),
+    CSS_PROPERTY("color", HTML2TEX_CSS_COLOR),
+    CSS_PROPERTY("background-color", HTML2TEX_CSS_BACKGROUND_COLOR),
+    CSS_PROPERTY("text-align", HTML2TEX_CSS_TEXT_ALIGN),
+    CSS_PROPERTY("text-decoration", HTML2TEX_CSS_TEXT_DECORATION),
+    CSS_PROPERTY("margin-top", HTML2TEX_CSS_MARGIN_TOP),
+    CSS_PROPERTY("margin-bottom", HTML2TEX_CSS_MARGIN_BOTTOM),
+    CSS_PROPERTY("margin-left", HTML2TEX_CSS_MARGIN_LEFT),
+    CSS_PROPERTY("margin-right", HTML2TEX_CSS_MARGIN_RIGHT),
+    CSS_PROPERTY("padding-top", HTML2TEX_CSS_PADDING_TOP),
+    CSS_PROPERTY("padding-bottom", HTML2TEX_CSS_PADDING_BOTTOM),
+    CSS_PROPERTY("padding-left", HTML2TEX_CSS_PADDING_LEFT),
+    CSS_PROPERTY("padding-right", HTML2TEX_CSS_PADDING_RIGHT),
+    CSS_PROPERTY("width", HTML2TEX_CSS_WIDTH),
+    CSS_PROPERTY("height", HTML2TEX_CSS_HEIGHT),
+    CSS_PROPERTY("border", HTML2TEX_CSS_BORDER),
+    CSS_PROPERTY("border-color", HTML2TEX_CSS_BORDER_COLOR),
+    CSS_PROPERTY("display", HTML2TEX_CSS_DISPLAY),
+    CSS_PROPERTY("float", HTML2TEX_CSS_FLOAT),
+    CSS_PROPERTY("vertical-align", HTML2TEX_CSS_VERTICAL_ALIGN)
+};
+
+/* Returns the first occurrence of word within the length bytes at text. */
+static const char* span_find(const char* text, size_t length, const char* word) {
+    const size_t word_length = strlen(word);
+    if (word_length > length) return NULL;
+
+    for (size_t i = 0; i + word_length <= length; i++) {
+        if (text[i] == word[0] && memcmp(text + i, word, word_length) == 0)
+            return text + i;
+    }
 
-    /* remove !important */
-    char* important_pos = strstr(cleaned, "!important");
-    if (important_pos) *important_pos = '\0';
+    return NULL;
+}
 
-    /* trim trailing whitespace */
-    char* end = cleaned + strlen(cleaned) - 1;
+static int span_equals(const char* text, size_t length, const char* word) {
+    return strlen(word) == length && memcmp(text, word, length) == 0;
+}
 
-    while (end > cleaned && isspace(*end))
-        *end-- = '\0';
+/* Removes !important and the surrounding whitespace from a value. */
+static void trim_css_value(const char** value, size_t* length) {
+    const char* start = *value;
+    const char* end = start + *length;
 
-    /* trim leading whitespace */
-    char* start = cleaned;
+    const char* important = span_find(start, *length, "!important");
+    if (important) end = important;
 
-    while (*start && isspace(*start))
+    while (start < end && isspace((unsigned char)*start))
         start++;
 
-    if (start != cleaned)
-        memmove(cleaned, start, strlen(start) + 1);
+    while (end > start && isspace((unsigned char)end[-1]))
+        end--;
 
-    return cleaned;
+    *value = start;
+    *length = (size_t)(end - start);
 }
 
-/* Check if CSS value contains !important. */
-static int has_important(const char* value) {
-    if (!value) return 0;
-    return (strstr(value, "!important") != NULL);
+/* Reads a leading integer like atoi, without going past the value. */
+static int span_to_int(const char* text, size_t length) {
+    size_t i = 0;
+    int negative = 0;
+    long value = 0;
+
+    if (i < length && (text[i] == '+' || text[i] == '-'))
+        negative = text[i++] == '-';
+
+    while (i < length && isdigit((unsigned char)text[i]) && value < 1000000)
+        value = value * 10 + (text[i++] - '0');
+
+    return (int)(negative ? -value : value);
 }
 
-CSSProperties* parse_css_style(const char* style_str) {
-    if (!style_str) return NULL;
-    CSSProperties* props = calloc(1, sizeof(CSSProperties));
+static int length_span_to_pt(const char* text, size_t length) {
+    char number[64];
+    if (length == 0) return 0;
 
-    if (!props) return NULL;
-    char* copy = strdup(style_str);
+    /* strtod needs a terminated copy, lengths are short */
+    if (length >= sizeof(number)) length = sizeof(number) - 1;
+    memcpy(number, text, length);
+    number[length] = '\0';
 
-    if (!copy) {
-        free(props);
-        return NULL;
+    char* unit;
+    const double value = strtod(number, &unit);
+    if (unit == number) return 0;
+
+    /* the unit is the next word after the number */
+    while (isspace((unsigned char)*unit)) unit++;
+    size_t unit_length = 0;
+
+    while (unit[unit_length] && !isspace((unsigned char)unit[unit_length]))
+        unit_length++;
+
+    /* convert to points */
+    if (span_equals(unit, unit_length, "px")) {
+        /* assuming 96px = 1inch = 72pt */
+        return (int)(value * 72.0 / 96.0);
+    }
+    else if (span_equals(unit, unit_length, "pt"))
+        return (int)value;
+    else if (span_equals(unit, unit_length, "em")) {
+        /* 1em ≈ 10pt in LaTeX */
+        return (int)(value * 10.0);
     }
+    else if (span_equals(unit, unit_length, "rem"))
+        return (int)(value * 10.0);
+    else if (span_equals(unit, unit_length, "%")) {
+        /* percentage of text width - handle differently */
+        return (int)(value * 0.01 * 400); /* approximation */
+    }
+    else if (span_equals(unit, unit_length, "cm"))
+        return (int)(value * 28.346);
+    else if (span_equals(unit, unit_length, "mm"))
+        return (int)(value * 2.8346);
+    else if (span_equals(unit, unit_length, "in"))
+        return (int)(value * 72.0);
+
+    /* default assumption */
+    return (int)value;
+}
 
-    char* token = strtok(copy, ";");
+static int hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
 
-    while (token) {
-        /* trim whitespace */
-        while (*token == ' ') token++;
-        char* colon = strchr(token, ':');
+/* Packs a CSS color as 0xRRGGBB; returns 0 when the value is malformed. */
+static int color_span_to_rgb(const char* text, size_t length, unsigned int* rgb) {
+    if (length == 0) return 0;
 
-        if (colon) {
-            *colon = '\0';
-            char* property = token;
-            char* value = colon + 1;
+    if (text[0] == '#') {
+        const size_t digits = length - 1;
+        unsigned int value = 0;
+
+        if (digits != 3 && digits != 6) return 0;
+
+        for (size_t i = 1; i <= digits; i++) {
+            const int nibble = hex_digit(text[i]);
+            if (nibble < 0) return 0;
 
-            /* trim value and remove !important */
-            char* cleaned_value = clean_css_value(value);
+            /* #RGB stands for #RRGGBB */
+            value = (value << 4) | (unsigned int)nibble;
+            if (digits == 3) value = (value << 4) | (unsigned int)nibble;
+        }
+
+        *rgb = value;
+        return 1;
+    }
 
-            if (!cleaned_value) {
-                token = strtok(NULL, ";");
+    int channels = 0;
+    size_t i = 0;
+
+    if (length > 4 && memcmp(text, "rgb(", 4) == 0) {
+        channels = 3;
+        i = 4;
+    }
+    else if (length > 5 && memcmp(text, "rgba(", 5) == 0) {
+        /* RGBA color - alpha must be there but is ignored */
+        channels = 4;
+        i = 5;
+    }
+
+    if (channels > 0) {
+        unsigned int value = 0;
+
+        for (int channel = 0; channel < channels; channel++) {
+            while (i < length && isspace((unsigned char)text[i])) i++;
+
+            if (channel > 0) {
+                if (i >= length || text[i] != ',') return 0;
+                i++;
+
+                while (i < length && isspace((unsigned char)text[i])) i++;
+            }
+
+            const size_t start = i;
+
+            if (channel == 3) {
+                while (i < length && (isdigit((unsigned char)text[i]) || text[i] == '.')) i++;
+                if (i == start) return 0;
                 continue;
             }
 
-            /* map CSS properties */
-            if (strcmp(property, "font-weight") == 0)
-                props->font_weight = strdup(cleaned_value);
-            else if (strcmp(property, "font-style") == 0)
-                props->font_style = strdup(cleaned_value);
-            else if (strcmp(property, "font-family") == 0)
-                props->font_family = strdup(cleaned_value);
-            else if (strcmp(property, "font-size") == 0)
-                props->font_size = strdup(cleaned_value);
-            else if (strcmp(property, "color") == 0)
-                props->color = strdup(cleaned_value);
-            else if (strcmp(property, "background-color") == 0)
-                props->background_color = strdup(cleaned_value);
-            else if (strcmp(property, "text-align") == 0)
-                props->text_align = strdup(cleaned_value);
-            else if (strcmp(property, "text-decoration") == 0)
-                props->text_decoration = strdup(cleaned_value);
-            else if (strcmp(property, "margin-top") == 0)
-                props->margin_top = strdup(cleaned_value);
-            else if (strcmp(property, "margin-bottom") == 0)
-                props->margin_bottom = strdup(cleaned_value);
-            else if (strcmp(property, "margin-left") == 0)
-                props->margin_left = strdup(cleaned_value);
-            else if (strcmp(property, "margin-right") == 0)
-                props->margin_right = strdup(cleaned_value);
-            else if (strcmp(property, "padding-top") == 0)
-                props->padding_top = strdup(cleaned_value);
-            else if (strcmp(property, "padding-bottom") == 0)
-                props->padding_bottom = strdup(cleaned_value);
-            else if (strcmp(property, "padding-left") == 0)
-                props->padding_left = strdup(cleaned_value);
-            else if (strcmp(property, "padding-right") == 0)
-                props->padding_right = strdup(cleaned_value);
-            else if (strcmp(property, "width") == 0)
-                props->width = strdup(cleaned_value);
-            else if (strcmp(property, "height") == 0)
-                props->height = strdup(cleaned_value);
-            else if (strcmp(property, "border") == 0)
-                props->border = strdup(cleaned_value);
-            else if (strcmp(property, "border-color") == 0)
-                props->border_color = strdup(cleaned_value);
-            else if (strcmp(property, "display") == 0)
-                props->display = strdup(cleaned_value);
-            else if (strcmp(property, "float") == 0)
-                props->float_pos = strdup(cleaned_value);
-            else if (strcmp(property, "vertical-align") == 0)
-                props->vertical_align = strdup(cleaned_value);
-
-            free(cleaned_value);
+            unsigned int component = 0;
+
+            while (i < length && isdigit((unsigned char)text[i])) {
+                if (component < 256) component = component * 10 + (unsigned int)(text[i] - '0');
+                i++;
+            }
+
+            if (i == start) return 0;
+            if (component > 255) component = 255;
+            value = (value << 8) | component;
         }
 
-        token = strtok(NULL, ";");
+        *rgb = value;
+        return 1;
     }
 
-    free(copy);
-    return props;
+    /* named colors */
+    static const struct {
+        const char* name;
+        unsigned int rgb;
+    } color_map[] = {
+        {"black", 0x000000}, {"white", 0xFFFFFF},
+        {"red", 0xFF0000}, {"green", 0x008000},
+        {"blue", 0x0000FF}, {"yellow", 0xFFFF00},
+        {"cyan", 0x00FFFF}, {"magenta", 0xFF00FF},
+        {"gray", 0x808080}, {"grey", 0x808080},
+        {"silver", 0xC0C0C0}, {"maroon", 0x800000},
+        {"olive", 0x808000}, {"lime", 0x00FF00},
+        {"aqua", 0x00FFFF}, {"teal", 0x008080},
+        {"navy", 0x000080}, {"fuchsia", 0xFF00FF},
+        {"purple", 0x800080}, {"orange", 0xFFA500},
+        {"transparent", 0xFFFFFF}, /* treat transparent as white */
+        {NULL, 0}
+    };
+
+    for (int k = 0; color_map[k].name; k++) {
+        if (strlen(color_map[k].name) == length &&
+            strncasecmp(text, color_map[k].name, length) == 0) {
+            *rgb = color_map[k].rgb;
+            return 1;
+        }
+    }
+
+    /* default to black for unknown colors */
+    *rgb = 0x000000;
+    return 1;
 }
 
-int css_length_to_pt(const char* length_str) {
-    if (!length_str) return 0;
+static unsigned char parse_font_weight(const char* value, size_t length) {
+    const int weight = span_to_int(value, length);
 
-    /* clean the value first in case it has !important */
-    char* cleaned = clean_css_value(length_str);
-    if (!cleaned) return 0;
+    if (span_equals(value, length, "bold") || span_equals(value, length, "bolder") || weight >= 600)
+        return HTML2TEX_WEIGHT_BOLD;
 
-    double value;
-    char unit[10] = "";
+    /* keywords read as weight 0, so normal also selects the medium series */
+    if (span_equals(value, length, "lighter") || weight <= 300)
+        return HTML2TEX_WEIGHT_MEDIUM;
 
-    if (sscanf(cleaned, "%lf%s", &value, unit) < 1) {
-        free(cleaned);
-        return 0;
-    }
+    return HTML2TEX_WEIGHT_OTHER;
+}
 
-    int result = 0;
+static unsigned char parse_font_style(const char* value, size_t length) {
+    if (span_equals(value, length, "italic")) return HTML2TEX_STYLE_ITALIC;
+    if (span_equals(value, length, "oblique")) return HTML2TEX_STYLE_OBLIQUE;
+    if (span_equals(value, length, "normal")) return HTML2TEX_STYLE_NORMAL;
+    return HTML2TEX_STYLE_OTHER;
+}
 
-    /* convert to points */
-    if (strcmp(unit, "px") == 0) {
-        /* assuming 96px = 1inch = 72pt */
-        result = (int)(value * 72.0 / 96.0);
-    }
-    else if (strcmp(unit, "pt") == 0)
-        result = (int)value;
-    else if (strcmp(unit, "em") == 0) {
-        /* 1em ≈ 10pt in LaTeX */
-        result = (int)(value * 10.0);
-    }
-    else if (strcmp(unit, "rem") == 0)
-        result = (int)(value * 10.0);
-    else if (strcmp(unit, "%") == 0) {
-        /* percentage of text width - handle differently */
-        result = (int)(value * 0.01 * 400); /* approximation */
-    }
-    else if (strcmp(unit, "cm") == 0)
-        result = (int)(value * 28.346);
-    else if (strcmp(unit, "mm") == 0)
-        result = (int)(value * 2.8346);
-    else if (strcmp(unit, "in") == 0)
-        result = (int)(value * 72.0);
-    else
-        result = (int)value; /* default assumption */
-
-    free(cleaned);
-    return result;
+static unsigned char parse_font_family(const char* value, size_t length) {
+    /* the first family LaTeX can match wins, in this order */
+    if (span_find(value, length, "monospace") || span_find(value, length, "Courier"))
+        return HTML2TEX_FAMILY_MONOSPACE;
+
+    if (span_find(value, length, "sans") || span_find(value, length, "Arial") ||
+        span_find(value, length, "Helvetica"))
+        return HTML2TEX_FAMILY_SANS;
+
+    if (span_find(value, length, "serif") || span_find(value, length, "Times"))
+        return HTML2TEX_FAMILY_SERIF;
+
+    return HTML2TEX_FAMILY_OTHER;
 }
 
-char* css_color_to_hex(const char* color_value) {
-    if (!color_value) return NULL;
+static unsigned char parse_text_align(const char* value, size_t length) {
+    if (span_equals(value, length, "left")) return HTML2TEX_ALIGN_LEFT;
+    if (span_equals(value, length, "center")) return HTML2TEX_ALIGN_CENTER;
+    if (span_equals(value, length, "right")) return HTML2TEX_ALIGN_RIGHT;
+    if (span_equals(value, length, "justify")) return HTML2TEX_ALIGN_JUSTIFY;
+    return HTML2TEX_ALIGN_OTHER;
+}
 
-    /* clean the value first in case it has !important */
-    char* cleaned = clean_css_value(color_value);
+static unsigned char parse_text_decoration(const char* value, size_t length) {
+    unsigned char lines = 0;
 
-    if (!cleaned) return NULL;
-    char* result = NULL;
+    if (span_find(value, length, "underline")) lines |= HTML2TEX_DECORATION_UNDERLINE;
+    if (span_find(value, length, "line-through")) lines |= HTML2TEX_DECORATION_LINE_THROUGH;
+    if (span_find(value, length, "overline")) lines |= HTML2TEX_DECORATION_OVERLINE;
+    return lines;
+}
 
-    if (cleaned[0] == '#') {
-        /* hex color */
-        if (strlen(cleaned) == 4) {
-            /* #RGB format */
-            result = malloc(7);
+static unsigned char parse_display(const char* value, size_t length) {
+    if (span_equals(value, length, "none")) return HTML2TEX_DISPLAY_NONE;
+    if (span_equals(value, length, "block")) return HTML2TEX_DISPLAY_BLOCK;
+    if (span_equals(value, length, "inline")) return HTML2TEX_DISPLAY_INLINE;
+    if (span_equals(value, length, "inline-block")) return HTML2TEX_DISPLAY_INLINE_BLOCK;
+    return HTML2TEX_DISPLAY_OTHER;
+}
 
-            snprintf(result, 7, "%c%c%c%c%c%c",
-                cleaned[1], cleaned[1],
-                cleaned[2], cleaned[2],
-                cleaned[3], cleaned[3]);
-        }
-        else /* #RRGGBB format */
-            result = strdup(cleaned + 1);
-    }
-    else if (strncmp(cleaned, "rgb(", 4) == 0) {
-        /* RGB color */
-        int r, g, b;
+static unsigned char parse_float(const char* value, size_t length) {
+    if (span_equals(value, length, "none")) return HTML2TEX_FLOAT_NONE;
+    if (span_equals(value, length, "left")) return HTML2TEX_FLOAT_LEFT;
+    if (span_equals(value, length, "right")) return HTML2TEX_FLOAT_RIGHT;
+    return HTML2TEX_FLOAT_OTHER;
+}
 
-        if (sscanf(cleaned, "rgb(%d, %d, %d)", &r, &g, &b) == 3) {
-            result = malloc(7);
-            snprintf(result, 7, "%02X%02X%02X", r, g, b);
-        }
+static unsigned char parse_vertical_align(const char* value, size_t length) {
+    if (span_equals(value, length, "baseline")) return HTML2TEX_VALIGN_BASELINE;
+    if (span_equals(value, length, "top")) return HTML2TEX_VALIGN_TOP;
+    if (span_equals(value, length, "middle")) return HTML2TEX_VALIGN_MIDDLE;
+    if (span_equals(value, length, "bottom")) return HTML2TEX_VALIGN_BOTTOM;
+    return HTML2TEX_VALIGN_OTHER;
+}
+
+/* Stores one trimmed declaration value in its typed field. */
+static void set_css_property(CSSProperties* props, unsigned int bit, const char* value, size_t length) {
+    switch (bit) {
+    case HTML2TEX_CSS_FONT_WEIGHT: props->font_weight = parse_font_weight(value, length); break;
+    case HTML2TEX_CSS_FONT_STYLE: props->font_style = parse_font_style(value, length); break;
+    case HTML2TEX_CSS_FONT_FAMILY: props->font_family = parse_font_family(value, length); break;
+    case HTML2TEX_CSS_FONT_SIZE: props->font_size = length_span_to_pt(value, length); break;
+    case HTML2TEX_CSS_TEXT_ALIGN: props->text_align = parse_text_align(value, length); break;
+    case HTML2TEX_CSS_TEXT_DECORATION: props->text_decoration = parse_text_decoration(value, length); break;
+    case HTML2TEX_CSS_MARGIN_TOP: props->margin_top = length_span_to_pt(value, length); break;
+    case HTML2TEX_CSS_MARGIN_BOTTOM: props->margin_bottom = length_span_to_pt(value, length); break;
+    case HTML2TEX_CSS_MARGIN_LEFT: props->margin_left = length_span_to_pt(value, length); break;
+    case HTML2TEX_CSS_MARGIN_RIGHT: props->margin_right = length_span_to_pt(value, length); break;
+    case HTML2TEX_CSS_PADDING_TOP: props->padding_top = length_span_to_pt(value, length); break;
+    case HTML2TEX_CSS_PADDING_BOTTOM: props->padding_bottom = length_span_to_pt(value, length); break;
+    case HTML2TEX_CSS_PADDING_LEFT: props->padding_left = length_span_to_pt(value, length); break;
+    case HTML2TEX_CSS_PADDING_RIGHT: props->padding_right = length_span_to_pt(value, length); break;
+    case HTML2TEX_CSS_WIDTH: props->width = length_span_to_pt(value, length); break;
+    case HTML2TEX_CSS_HEIGHT: props->height = length_span_to_pt(value, length); break;
+    case HTML2TEX_CSS_DISPLAY: props->display = parse_display(value, length); break;
+    case HTML2TEX_CSS_FLOAT: props->float_pos = parse_float(value, length); break;
+    case HTML2TEX_CSS_VERTICAL_ALIGN: props->vertical_align = parse_vertical_align(value, length); break;
+    case HTML2TEX_CSS_BORDER:
+        props->border_style = span_find(value, length, "solid") ? HTML2TEX_BORDER_SOLID : HTML2TEX_BORDER_OTHER;
+        break;
+    /* malformed colors leave the property undeclared */
+    case HTML2TEX_CSS_COLOR:
+        if (!color_span_to_rgb(value, length, &props->color)) return;
+        break;
+    case HTML2TEX_CSS_BACKGROUND_COLOR:
+        if (!color_span_to_rgb(value, length, &props->background_color)) return;
+        break;
+    case HTML2TEX_CSS_BORDER_COLOR:
+        if (!color_span_to_rgb(value, length, &props->border_color)) return;
+        break;
+    default:
+        return;
     }
-    else if (strncmp(cleaned, "rgba(", 5) == 0) {
-        /* RGBA color - ignore alpha */
-        int r, g, b;
-        float a;
-
-        if (sscanf(cleaned, "rgba(%d, %d, %d, %f)", &r, &g, &b, &a) == 4) {
-            result = malloc(7);
-            snprintf(result, 7, "%02X%02X%02X", r, g, b);
+
+    props->present |= bit;
+}
+
+void parse_css_style_into(const char* style_str, CSSProperties* props) {
+    if (!props) return;
+    memset(props, 0, sizeof(*props));
+
+    if (!style_str) return;
+    const char* declaration = style_str;
+
+    while (*declaration) {
+        /* find the end of this declaration and its colon in one scan */
+        const char* colon = NULL;
+        const char* end = declaration;
+
+        while (*end && *end != ';') {
+            if (*end == ':' && !colon) colon = end;
+            end++;
         }
-    }
-    else {
-        /* named colors */
-        struct {
-            const char* name;
-            const char* hex;
-        } color_map[] = {
-            {"black", "000000"}, {"white", "FFFFFF"},
-            {"red", "FF0000"}, {"green", "008000"},
-            {"blue", "0000FF"}, {"yellow", "FFFF00"},
-            {"cyan", "00FFFF"}, {"magenta", "FF00FF"},
-            {"gray", "808080"}, {"grey", "808080"},
-            {"silver", "C0C0C0"}, {"maroon", "800000"},
-            {"olive", "808000"}, {"lime", "00FF00"},
-            {"aqua", "00FFFF"}, {"teal", "008080"},
-            {"navy", "000080"}, {"fuchsia", "FF00FF"},
-            {"purple", "800080"}, {"orange", "FFA500"},
-            {"transparent", "FFFFFF"}, /* treat transparent as white */
-            {NULL, NULL}
-        };
-
-        for (int i = 0; color_map[i].name; i++) {
-            if (strcasecmp(cleaned, color_map[i].name) == 0) {
-                result = strdup(color_map[i].hex);
-                break;
+
+        if (colon) {
+            const char* name = declaration;
+            const char* name_end = colon;
+
+            while (name < name_end && isspace((unsigned char)*name)) name++;
+            while (name_end > name && isspace((unsigned char)name_end[-1])) name_end--;
+
+            const char* value = colon + 1;
+            size_t value_length = (size_t)(end - value);
+            trim_css_value(&value, &value_length);
+
+            const size_t name_length = (size_t)(name_end - name);
+
+            if (value_length > 0) {
+                for (size_t i = 0; i < sizeof(css_properties) / sizeof(css_properties[0]); i++) {
+                    if (css_properties[i].length == name_length &&
+                        memcmp(css_properties[i].name, name, name_length) == 0) {
+                        /* a later declaration overrides an earlier one */
+                        set_css_property(props, css_properties[i].bit, value, value_length);
+                        break;
+                    }
+                }
             }
         }
 
-        if (!result)
-            /* default to black for unknown colors */
-            result = strdup("000000");
+        declaration = *end ? end + 1 : end;
     }
+}
 
-    free(cleaned);
+CSSProperties* parse_css_style(const char* style_str) {
+    if (!style_str) return NULL;
+    CSSProperties* props = (CSSProperties*)malloc(sizeof(CSSProperties));
 
-    if (result) {
-        /* convert to uppercase */
-        for (char* p = result; *p; p++)
-            *p = toupper(*p);
-    }
+    if (props) parse_css_style_into(style_str, props);
+    return props;
+}
+
+int css_length_to_pt(const char* length_str) {
+    if (!length_str) return 0;
+
+    const char* value = length_str;
+    size_t length = strlen(length_str);
+
+    trim_css_value(&value, &length);
+    return length_span_to_pt(value, length);
+}
+
+char* css_color_to_hex(const char* color_value) {
+    if (!color_value) return NULL;
+
+    const char* value = color_value;
+    size_t length = strlen(color_value);
+    unsigned int rgb;
+
+    trim_css_value(&value, &length);
+    if (!color_span_to_rgb(value, length, &rgb)) return NULL;
+
+    char* result = (char*)malloc(7);
+    if (result) snprintf(result, 7, "%06X", rgb & 0xFFFFFFu);
 
     return result;
 }
 
-void apply_css_properties(LaTeXConverter* converter, CSSProperties* props, const char* tag_name) {
-    if (!converter || !props) return;
+/* What a style attribute turns into, given the element and the current CSS state. */
+#define CSS_CTX_BLOCK            0x1u
+#define CSS_CTX_TABLE_CELL       0x2u
+#define CSS_CTX_INSIDE_CELL      0x4u
+#define CSS_CTX_HAS_BACKGROUND   0x8u
+#define CSS_CTX_HAS_COLOR        0x10u
+#define CSS_CTX_HAS_BOLD         0x20u
+#define CSS_CTX_HAS_ITALIC       0x40u
+#define CSS_CTX_HAS_FONT_FAMILY  0x80u
+#define CSS_CTX_HAS_UNDERLINE    0x100u
+
+/* open addressing window searched before a slot gets evicted */
+#define CSS_STYLE_PROBES 4
+
+/* Opening LaTeX of a style and the state changes that go with it. */
+typedef struct {
+    char text[256];
+    size_t length;
+
+    int braces;
+    int environments;
+    int margin_bottom;
+
+    /* CSS_CTX_HAS_* properties this opening applied */
+    unsigned int flags;
+} CSSOpening;
+
+typedef struct {
+    /* key: the style attribute and the context it was rendered in, NULL when empty */
+    char* style;
+    size_t length;
+    unsigned int hash;
+    unsigned int context;
+
+    CSSProperties props;
+
+    /* points into the style allocation, right after the key */
+    const char* open;
+    size_t open_length;
+
+    int braces;
+    int environments;
+    int margin_bottom;
+    unsigned int flags;
+} CSSStyleEntry;
+
+struct CSSStyleCache {
+    CSSStyleEntry* entries;
+    size_t mask;
+};
+
+static unsigned int css_context(const LaTeXConverter* converter, int tag_id) {
+    unsigned int context = 0;
+
+    if (html2tex_tag_flags(tag_id) & HTML2TEX_TAG_IS_BLOCK) context |= CSS_CTX_BLOCK;
+    if (tag_id == HTML2TEX_TAG_TD || tag_id == HTML2TEX_TAG_TH) context |= CSS_CTX_TABLE_CELL;
+    if (converter->state.in_table_cell) context |= CSS_CTX_INSIDE_CELL;
+
+    if (converter->state.has_background) context |= CSS_CTX_HAS_BACKGROUND;
+    if (converter->state.has_color) context |= CSS_CTX_HAS_COLOR;
+    if (converter->state.has_bold) context |= CSS_CTX_HAS_BOLD;
+    if (converter->state.has_italic) context |= CSS_CTX_HAS_ITALIC;
+    if (converter->state.has_font_family) context |= CSS_CTX_HAS_FONT_FAMILY;
+    if (converter->state.has_underline) context |= CSS_CTX_HAS_UNDERLINE;
+    return context;
+}
 
-    int is_block = is_block_element(tag_name);
-    int is_inline = is_inline_element(tag_name);
+static void opening_append(CSSOpening* opening, const char* str) {
+    size_t len = strlen(str);
 
-    int is_table_cell = (tag_name && (strcmp(tag_name, "td") == 0 || strcmp(tag_name, "th") == 0));
-    int inside_table_cell = converter->state.in_table_cell;
+    /* the longest opening is well under the buffer size */
+    if (len >= sizeof(opening->text) - opening->length)
+        len = sizeof(opening->text) - opening->length - 1;
 
-    /* for inline elements, don't reset css_braces completely as they might be nested */
-    if (is_block && !inside_table_cell) {
-        converter->state.css_braces = 0;
-        converter->state.css_environments = 0;
-    }
+    memcpy(opening->text + opening->length, str, len);
+    opening->length += len;
+    opening->text[opening->length] = '\0';
+}
+
+/* Renders the opening LaTeX of props without touching any converter. */
+static void render_css_opening(const CSSProperties* props, unsigned int context, CSSOpening* opening) {
+    const int is_block = (context & CSS_CTX_BLOCK) != 0;
+    const int is_table_cell = (context & CSS_CTX_TABLE_CELL) != 0;
+    const int inside_table_cell = (context & CSS_CTX_INSIDE_CELL) != 0;
+
+    opening->text[0] = '\0';
+    opening->length = 0;
+
+    opening->braces = 0;
+    opening->environments = 0;
+    opening->margin_bottom = 0;
+    opening->flags = 0;
 
     /* text alignment (block elements only) */
-    if (is_block && props->text_align && !inside_table_cell) {
-        if (strcmp(props->text_align, "center") == 0) {
+    if (is_block && (props->present & HTML2TEX_CSS_TEXT_ALIGN) && !inside_table_cell) {
+        switch (props->text_align) {
+        case HTML2TEX_ALIGN_CENTER:
             /* center environment */
-            append_string(converter, "\\begin{center}\n");
-            converter->state.css_environments |= 1;
-        }
-        else if (strcmp(props->text_align, "right") == 0) {
+            opening_append(opening, "\\begin{center}\n");
+            opening->environments |= 1;
+            break;
+        case HTML2TEX_ALIGN_RIGHT:
             /* flushright environment */
-            append_string(converter, "\\begin{flushright}\n");
-            converter->state.css_environments |= 2;
-        }
-        else if (strcmp(props->text_align, "left") == 0) {
+            opening_append(opening, "\\begin{flushright}\n");
+            opening->environments |= 2;
+            break;
+        case HTML2TEX_ALIGN_LEFT:
             /* flushleft environment */
-            append_string(converter, "\\begin{flushleft}\n");
-            converter->state.css_environments |= 4;
-        }
-        else if (strcmp(props->text_align, "justify") == 0) {
+            opening_append(opening, "\\begin{flushleft}\n");
+            opening->environments |= 4;
+            break;
+        case HTML2TEX_ALIGN_JUSTIFY:
             /* justifying command */
-            append_string(converter, "\\justifying\n");
-            converter->state.css_environments |= 8;
+            opening_append(opening, "\\justifying\n");
+            opening->environments |= 8;
+            break;
         }
     }
 
     /* margins (block elements) */
     if (is_block && !inside_table_cell) {
-        if (props->margin_top) {
-            int pt = css_length_to_pt(props->margin_top);
-
-            if (pt > 0) {
-                char margin_cmd[32];
-                snprintf(margin_cmd, sizeof(margin_cmd), "\\vspace*{%dpt}\n", pt);
-                append_string(converter, margin_cmd);
-            }
+        if ((props->present & HTML2TEX_CSS_MARGIN_TOP) && props->margin_top > 0) {
+            char margin_cmd[32];
+            snprintf(margin_cmd, sizeof(margin_cmd), "\\vspace*{%dpt}\n", props->margin_top);
+            opening_append(opening, margin_cmd);
         }
 
-        if (props->margin_bottom) {
-            int pt = css_length_to_pt(props->margin_bottom);
-            if (pt > 0) converter->state.pending_margin_bottom = pt;
-        }
+        if ((props->present & HTML2TEX_CSS_MARGIN_BOTTOM) && props->margin_bottom > 0)
+            opening->margin_bottom = props->margin_bottom;
 
         /* horizontal margins */
-        if (props->margin_left) {
-            int pt = css_length_to_pt(props->margin_left);
-
-            if (pt > 0) {
-                char margin_cmd[32];
-                snprintf(margin_cmd, sizeof(margin_cmd), "\\hspace*{%dpt}", pt);
-                append_string(converter, margin_cmd);
-            }
+        if ((props->present & HTML2TEX_CSS_MARGIN_LEFT) && props->margin_left > 0) {
+            char margin_cmd[32];
+            snprintf(margin_cmd, sizeof(margin_cmd), "\\hspace*{%dpt}", props->margin_left);
+            opening_append(opening, margin_cmd);
         }
     }
 
-    /* background color - use cellcolor for table cells and their contents */
-    if (props->background_color && !converter->state.has_background) {
-        char* hex_color = css_color_to_hex(props->background_color);
-        if (hex_color && strcmp(hex_color, "FFFFFF") != 0) {
-            /* skip white background */
-            if (is_table_cell || inside_table_cell) {
-                /* use cellcolor for table cells and elements inside table cells */
-                append_string(converter, "\\cellcolor[HTML]{");
-
-                /* cellcolor doesn't add braces, so we don't increment css_braces */
-                append_string(converter, hex_color);
-                append_string(converter, "}");
-            }
-            else {
-                /* use colorbox for non-table elements */
-                append_string(converter, "\\colorbox[HTML]{");
-                append_string(converter, hex_color);
+    /* background color - use cellcolor for table cells and their contents, skip white */
+    if ((props->present & HTML2TEX_CSS_BACKGROUND_COLOR) && !(context & CSS_CTX_HAS_BACKGROUND) &&
+        props->background_color != 0xFFFFFF) {
+        char hex_color[8];
+        snprintf(hex_color, sizeof(hex_color), "%06X", props->background_color & 0xFFFFFFu);
 
-                append_string(converter, "}{");
-                converter->state.css_braces++;
-            }
+        if (is_table_cell || inside_table_cell) {
+            /* use cellcolor for table cells and elements inside table cells */
+            opening_append(opening, "\\cellcolor[HTML]{");
 
-            converter->state.has_background = 1;
-            free(hex_color);
+            /* cellcolor doesn't add braces, so we don't increment css_braces */
+            opening_append(opening, hex_color);
+            opening_append(opening, "}");
         }
-        else if (hex_color)
-            free(hex_color);
-    }
+        else {
+            /* use colorbox for non-table elements */
+            opening_append(opening, "\\colorbox[HTML]{");
+            opening_append(opening, hex_color);
 
-    /* text color */
-    if (props->color && !converter->state.has_color) {
-        char* hex_color = css_color_to_hex(props->color);
-        if (hex_color && strcmp(hex_color, "000000") != 0) {
-            /* skip the black text */
-            append_string(converter, "\\textcolor[HTML]{");
-            append_string(converter, hex_color);
-            append_string(converter, "}{");
-            free(hex_color);
-            converter->state.css_braces++;
-            converter->state.has_color = 1;
+            opening_append(opening, "}{");
+            opening->braces++;
         }
-        else if (hex_color)
-            free(hex_color);
+
+        opening->flags |= CSS_CTX_HAS_BACKGROUND;
+    }
+
+    /* text color, skipping black text */
+    if ((props->present & HTML2TEX_CSS_COLOR) && !(context & CSS_CTX_HAS_COLOR) && props->color != 0x000000) {
+        char hex_color[8];
+        snprintf(hex_color, sizeof(hex_color), "%06X", props->color & 0xFFFFFFu);
+
+        opening_append(opening, "\\textcolor[HTML]{");
+        opening_append(opening, hex_color);
+        opening_append(opening, "}{");
+        opening->braces++;
+        opening->flags |= CSS_CTX_HAS_COLOR;
     }
 
     /* font weight - only apply if not already applied */
-    if (props->font_weight && !converter->state.has_bold) {
-        if (strcmp(props->font_weight, "bold") == 0 ||
-            strcmp(props->font_weight, "bolder") == 0 ||
-            atoi(props->font_weight) >= 600) {
-            append_string(converter, "\\textbf{");
-            converter->state.css_braces++;
-            converter->state.has_bold = 1;
+    if ((props->present & HTML2TEX_CSS_FONT_WEIGHT) && !(context & CSS_CTX_HAS_BOLD)) {
+        if (props->font_weight == HTML2TEX_WEIGHT_BOLD) {
+            opening_append(opening, "\\textbf{");
+            opening->braces++;
+            opening->flags |= CSS_CTX_HAS_BOLD;
         }
-        else if (strcmp(props->font_weight, "lighter") == 0 ||
-            atoi(props->font_weight) <= 300) {
-            append_string(converter, "\\textmd{");
-            converter->state.css_braces++;
+        else if (props->font_weight == HTML2TEX_WEIGHT_MEDIUM) {
+            opening_append(opening, "\\textmd{");
+            opening->braces++;
         }
     }
 
     /* font style - only apply if not already applied */
-    if (props->font_style && !converter->state.has_italic) {
-        if (strcmp(props->font_style, "italic") == 0) {
-            append_string(converter, "\\textit{");
-            converter->state.css_braces++;
-            converter->state.has_italic = 1;
+    if ((props->present & HTML2TEX_CSS_FONT_STYLE) && !(context & CSS_CTX_HAS_ITALIC)) {
+        if (props->font_style == HTML2TEX_STYLE_ITALIC) {
+            opening_append(opening, "\\textit{");
+            opening->braces++;
+            opening->flags |= CSS_CTX_HAS_ITALIC;
         }
-        else if (strcmp(props->font_style, "oblique") == 0) {
-            append_string(converter, "\\textsl{");
-            converter->state.css_braces++;
+        else if (props->font_style == HTML2TEX_STYLE_OBLIQUE) {
+            opening_append(opening, "\\textsl{");
+            opening->braces++;
         }
-        else if (strcmp(props->font_style, "normal") == 0) {
-            append_string(converter, "\\textup{");
-            converter->state.css_braces++;
+        else if (props->font_style == HTML2TEX_STYLE_NORMAL) {
+            opening_append(opening, "\\textup{");
+            opening->braces++;
         }
     }
 
     /* font family - only apply if not already applied */
-    if (props->font_family && !converter->state.has_font_family) {
-        if (strstr(props->font_family, "monospace") ||
-            strstr(props->font_family, "Courier")) {
-            append_string(converter, "\\texttt{");
-            converter->state.css_braces++;
-            converter->state.has_font_family = 1;
-        }
-        else if (strstr(props->font_family, "sans") ||
-            strstr(props->font_family, "Arial") ||
-            strstr(props->font_family, "Helvetica")) {
-            append_string(converter, "\\textsf{");
-            converter->state.css_braces++;
-            converter->state.has_font_family = 1;
-        }
-        else if (strstr(props->font_family, "serif") ||
-            strstr(props->font_family, "Times")) {
-            append_string(converter, "\\textrm{");
-            converter->state.css_braces++;
-            converter->state.has_font_family = 1;
-        }
+    if ((props->present & HTML2TEX_CSS_FONT_FAMILY) && !(context & CSS_CTX_HAS_FONT_FAMILY) &&
+        props->font_family != HTML2TEX_FAMILY_OTHER) {
+        if (props->font_family == HTML2TEX_FAMILY_MONOSPACE)
+            opening_append(opening, "\\texttt{");
+        else if (props->font_family == HTML2TEX_FAMILY_SANS)
+            opening_append(opening, "\\textsf{");
+        else
+            opening_append(opening, "\\textrm{");
+
+        opening->braces++;
+        opening->flags |= CSS_CTX_HAS_FONT_FAMILY;
     }
 
     /* text decoration */
-    if (props->text_decoration && !converter->state.has_underline) {
-        if (strstr(props->text_decoration, "underline")) {
-            append_string(converter, "\\underline{");
-            converter->state.css_braces++;
-            converter->state.has_underline = 1;
+    if ((props->present & HTML2TEX_CSS_TEXT_DECORATION) && !(context & CSS_CTX_HAS_UNDERLINE)) {
+        if (props->text_decoration & HTML2TEX_DECORATION_UNDERLINE) {
+            opening_append(opening, "\\underline{");
+            opening->braces++;
+            opening->flags |= CSS_CTX_HAS_UNDERLINE;
         }
 
-        if (strstr(props->text_decoration, "line-through")) {
-            append_string(converter, "\\sout{");
-            converter->state.css_braces++;
+        if (props->text_decoration & HTML2TEX_DECORATION_LINE_THROUGH) {
+            opening_append(opening, "\\sout{");
+            opening->braces++;
         }
 
-        if (strstr(props->text_decoration, "overline")) {
-            append_string(converter, "\\overline{");
-            converter->state.css_braces++;
+        if (props->text_decoration & HTML2TEX_DECORATION_OVERLINE) {
+            opening_append(opening, "\\overline{");
+            opening->braces++;
         }
     }
 
     /* font size */
-    if (props->font_size) {
-        int pt = css_length_to_pt(props->font_size);
-        if (pt > 0) {
-            if (pt <= 8)
-                append_string(converter, "{\\tiny ");
-            else if (pt <= 10)
-                append_string(converter, "{\\small ");
-            else if (pt <= 12)
-                append_string(converter, "{\\normalsize ");
-            else if (pt <= 14)
-                append_string(converter, "{\\large ");
-            else if (pt <= 18)
-                append_string(converter, "{\\Large ");
-            else if (pt <= 24)
-                append_string(converter, "{\\LARGE ");
-            else
-                append_string(converter, "{\\huge ");
-
-            converter->state.css_braces++;
-        }
+    if ((props->present & HTML2TEX_CSS_FONT_SIZE) && props->font_size > 0) {
+        const int pt = props->font_size;
+
+        if (pt <= 8)
+            opening_append(opening, "{\\tiny ");
+        else if (pt <= 10)
+            opening_append(opening, "{\\small ");
+        else if (pt <= 12)
+            opening_append(opening, "{\\normalsize ");
+        else if (pt <= 14)
+            opening_append(opening, "{\\large ");
+        else if (pt <= 18)
+            opening_append(opening, "{\\Large ");
+        else if (pt <= 24)
+            opening_append(opening, "{\\LARGE ");
+        else
+            opening_append(opening, "{\\huge ");
+
+        opening->braces++;
     }
 
     /* border support */
-    if (props->border && strstr(props->border, "solid")) {
-        append_string(converter, "\\framebox{");
-        converter->state.css_braces++;
+    if ((props->present & HTML2TEX_CSS_BORDER) && props->border_style == HTML2TEX_BORDER_SOLID) {
+        opening_append(opening, "\\framebox{");
+        opening->braces++;
+    }
+}
+
+/* Writes an opening and replays its state changes on the converter. */
+static void commit_css_opening(LaTeXConverter* converter, unsigned int context, const char* text,
+    size_t length, int braces, int environments, int margin_bottom, unsigned int flags) {
+    /* for inline elements, don't reset css_braces completely as they might be nested */
+    if ((context & CSS_CTX_BLOCK) && !(context & CSS_CTX_INSIDE_CELL)) {
+        converter->state.css_braces = 0;
+        converter->state.css_environments = 0;
+    }
+
+    if (length > 0) append_string_len(converter, text, length);
+
+    converter->state.css_braces += braces;
+    converter->state.css_environments |= environments;
+    if (margin_bottom > 0) converter->state.pending_margin_bottom = margin_bottom;
+
+    if (flags & CSS_CTX_HAS_BACKGROUND) converter->state.has_background = 1;
+    if (flags & CSS_CTX_HAS_COLOR) converter->state.has_color = 1;
+    if (flags & CSS_CTX_HAS_BOLD) converter->state.has_bold = 1;
+    if (flags & CSS_CTX_HAS_ITALIC) converter->state.has_italic = 1;
+    if (flags & CSS_CTX_HAS_FONT_FAMILY) converter->state.has_font_family = 1;
+    if (flags & CSS_CTX_HAS_UNDERLINE) converter->state.has_underline = 1;
+}
+
+void apply_css_properties(LaTeXConverter* converter, CSSProperties* props, const char* tag_name) {
+    if (!converter || !props) return;
+
+    /* resolve the tag once for every classification */
+    const int tag_id = tag_name ? html2tex_tag_lookup(tag_name, strlen(tag_name)) : HTML2TEX_TAG_UNKNOWN;
+    const unsigned int context = css_context(converter, tag_id);
+    CSSOpening opening;
+
+    render_css_opening(props, context, &opening);
+    commit_css_opening(converter, context, opening.text, opening.length,
+        opening.braces, opening.environments, opening.margin_bottom, opening.flags);
+}
+
+/* Returns the style cache of converter, creating it on first use; NULL when disabled. */
+static CSSStyleCache* style_cache_get(LaTeXConverter* converter) {
+    if (converter->style_cache || converter->style_cache_size == 0)
+        return converter->style_cache;
+
+    /* slots are found by masking, so round up to a power of two */
+    size_t capacity = CSS_STYLE_PROBES;
+
+    while (capacity < converter->style_cache_size && capacity <= ((size_t)-1 >> 2))
+        capacity <<= 1;
+
+    CSSStyleCache* cache = (CSSStyleCache*)malloc(sizeof(CSSStyleCache));
+    if (!cache) return NULL;
+
+    cache->entries = (CSSStyleEntry*)calloc(capacity, sizeof(CSSStyleEntry));
+
+    if (!cache->entries) {
+        free(cache);
+        return NULL;
     }
+
+    cache->mask = capacity - 1;
+    converter->style_cache = cache;
+    return cache;
+}
+
+/* FNV-1a over the style attribute, mixed with the rendering context. */
+static unsigned int style_hash(const char* style, size_t* length, unsigned int context) {
+    unsigned int hash = 2166136261u;
+    const char* p = style;
+
+    while (*p) {
+        hash ^= (unsigned char)*p++;
+        hash *= 16777619u;
+    }
+
+    *length = (size_t)(p - style);
+    hash ^= context;
+    return hash * 16777619u;
+}
+
+CSSProperties* apply_css_style(LaTeXConverter* converter, const char* style_str, int tag_id, CSSProperties* props) {
+    if (!converter || !style_str || !props) return NULL;
+
+    const unsigned int context = css_context(converter, tag_id);
+    CSSStyleCache* cache = style_cache_get(converter);
+    CSSOpening opening;
+
+    if (!cache) {
+        parse_css_style_into(style_str, props);
+        render_css_opening(props, context, &opening);
+
+        commit_css_opening(converter, context, opening.text, opening.length,
+            opening.braces, opening.environments, opening.margin_bottom, opening.flags);
+        return props;
+    }
+
+    size_t length;
+    const unsigned int hash = style_hash(style_str, &length, context);
+    const size_t home = hash & cache->mask;
+    CSSStyleEntry* slot = NULL;
+
+    for (size_t probe = 0; probe < CSS_STYLE_PROBES; probe++) {
+        CSSStyleEntry* entry = &cache->entries[(home + probe) & cache->mask];
+
+        /* slots are never emptied, so the key is not further along */
+        if (!entry->style) {
+            slot = entry;
+            break;
+        }
+
+        if (entry->hash == hash && entry->context == context && entry->length == length &&
+            memcmp(entry->style, style_str, length) == 0) {
+            converter->style_cache_hits++;
+            *props = entry->props;
+
+            commit_css_opening(converter, context, entry->open, entry->open_length,
+                entry->braces, entry->environments, entry->margin_bottom, entry->flags);
+            return props;
+        }
+    }
+
+    converter->style_cache_misses++;
+    parse_css_style_into(style_str, props);
+    render_css_opening(props, context, &opening);
+
+    commit_css_opening(converter, context, opening.text, opening.length,
+        opening.braces, opening.environments, opening.margin_bottom, opening.flags);
+
+    /* the whole window is taken, replace the entry in the home slot */
+    if (!slot) slot = &cache->entries[home];
+
+    /* key and opening share one allocation */
+    char* storage = (char*)malloc(length + 1 + opening.length + 1);
+    if (!storage) return props;
+
+    free(slot->style);
+    memcpy(storage, style_str, length + 1);
+    memcpy(storage + length + 1, opening.text, opening.length + 1);
+
+    slot->style = storage;
+    slot->length = length;
+    slot->hash = hash;
+    slot->context = context;
+
+    slot->props = *props;
+    slot->open = storage + length + 1;
+    slot->open_length = opening.length;
+
+    slot->braces = opening.braces;
+    slot->environments = opening.environments;
+    slot->margin_bottom = opening.margin_bottom;
+    slot->flags = opening.flags;
+    return props;
+}
+
+void free_css_style_cache(CSSStyleCache* cache) {
+    if (!cache) return;
+
+    for (size_t i = 0; i <= cache->mask; i++)
+        free(cache->entries[i].style);
+
+    free(cache->entries);
+    free(cache);
 }
 
 void end_css_properties(LaTeXConverter* converter, CSSProperties* props, const char* tag_name) {
@@ -488,25 +882,20 @@ void end_css_properties(LaTeXConverter* converter, CSSProperties* props, const c
 
     int is_block = is_block_element(tag_name);
     int inside_table_cell = converter->state.in_table_cell;
-    int is_inline = is_inline_element(tag_name);
 
     /* For table cells, we handle brace closing separately in the cell processing */
     if (!inside_table_cell) {
-        /* for inline elements, we need to be more careful about brace closing */
-        if (is_inline) {
-            /* close braces but don't reset all state for inline elements */
-            for (int i = 0; i < converter->state.css_braces; i++)
-                append_string(converter, "}");
-
-            converter->state.css_braces = 0;
+        static const char closing[] = "}}}}}}}}}}}}}}}}}}}}}}}}}}}}}}}}";
+        int remaining = converter->state.css_braces;
+
+        /* close braces in blocks instead of one append per brace */
+        while (remaining > 0) {
+            const int chunk = remaining < (int)(sizeof(closing) - 1) ? remaining : (int)(sizeof(closing) - 1);
+            append_string_len(converter, closing, (size_t)chunk);
+            remaining -= chunk;
         }
-        else {
-            /* for block elements, use normal closing */
-            for (int i = 0; i < converter->state.css_braces; i++)
-                append_string(converter, "}");
 
-            converter->state.css_braces = 0;
-        }
+        converter->state.css_braces = 0;
     }
 
     /* close text alignment environments */
@@ -529,14 +918,10 @@ void end_css_properties(LaTeXConverter* converter, CSSProperties* props, const c
         }
 
         /* right margin at end */
-        if (props->margin_right) {
-            int pt = css_length_to_pt(props->margin_right);
-
-            if (pt > 0) {
-                char margin_cmd[32];
-                snprintf(margin_cmd, sizeof(margin_cmd), "\\hspace*{%dpt}", pt);
-                append_string(converter, margin_cmd);
-            }
+        if ((props->present & HTML2TEX_CSS_MARGIN_RIGHT) && props->margin_right > 0) {
+            char margin_cmd[32];
+            snprintf(margin_cmd, sizeof(margin_cmd), "\\hspace*{%dpt}", props->margin_right);
+            append_string(converter, margin_cmd);
         }
     }
 
@@ -562,40 +947,5 @@ void reset_css_state(LaTeXConverter* converter) {
 }
 
 void free_css_properties(CSSProperties* props) {
-    if (!props) return;
-    free(props->font_weight);
-
-    free(props->font_style);
-    free(props->font_family);
-
-    free(props->font_size);
-    free(props->color);
-
-    free(props->background_color);
-    free(props->text_align);
-
-    free(props->text_decoration);
-    free(props->margin_top);
-
-    free(props->margin_bottom);
-    free(props->margin_left);
-
-    free(props->margin_right);
-    free(props->padding_top);
-
-    free(props->padding_bottom);
-    free(props->padding_left);
-
-    free(props->padding_right);
-    free(props->width);
-
-    free(props->height);
-    free(props->border);
-
-    free(props->border_color);
-    free(props->display);
-
-    free(props->float_pos);
-    free(props->vertical_align);
     free(props);
 }
\ No newline at end of file
@@ -0,0 +1,339 @@
+#include "html2tex.h"
+#include <string.h>
+
+#if !defined(HTML2TEX_NO_SIMD) && (defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86))
+#define SCAN_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+/* Vector kernels are compiled for their own ISA and only called once the CPU has it. */
+#if defined(__GNUC__) || defined(__clang__)
+#define SCAN_TARGET(isa) __attribute__((target(isa)))
+#define SCAN_CTZ(mask) ((size_t)__builtin_ctz(mask))
+#else
+#define SCAN_TARGET(isa)
+static size_t scan_ctz(unsigned int mask) {
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (size_t)index;
+}
+#define SCAN_CTZ(mask) scan_ctz(mask)
+#endif
+
+/* Below one vector the scalar loop wins over the dispatch. */
+#define SCAN_MIN_VECTOR 16
+
+typedef size_t (*ScanFn)(const char* text, size_t length);
+typedef size_t (*DecodeFn)(const char* text, size_t length, unsigned char* out);
+
+typedef struct {
+    ScanFn latex;
+    ScanFn space;
+    DecodeFn base64;
+    const char* name;
+} ScanKernels;
+
+/* Every byte escape_latex rewrites; escape_latex_special rewrites a subset. */
+static const unsigned char latex_bytes[256] = {
+    ['\\'] = 1,['{'] = 1,['}'] = 1,['&'] = 1,['%'] = 1,['$'] = 1,['#'] = 1,
+    ['_'] = 1,['^'] = 1,['~'] = 1,['<'] = 1,['>'] = 1,['\n'] = 1
+};
+
+static const unsigned char space_bytes[256] = {
+    [' '] = 1,['\t'] = 1,['\n'] = 1,['\v'] = 1,['\f'] = 1,['\r'] = 1
+};
+
+static size_t scan_latex_scalar(const char* text, size_t length) {
+    size_t i = 0;
+
+    while (i < length && !latex_bytes[(unsigned char)text[i]])
+        i++;
+
+    return i;
+}
+
+static size_t scan_space_scalar(const char* text, size_t length) {
+    size_t i = 0;
+
+    while (i < length && !space_bytes[(unsigned char)text[i]])
+        i++;
+
+    return i;
+}
+
+/* 0x40 | sextet of each base64 character, 0 for the rest, padding included. */
+static const unsigned char base64_sextets[256] = {
+    ['A'] = 0x40, ['B'] = 0x41, ['C'] = 0x42, ['D'] = 0x43, ['E'] = 0x44, ['F'] = 0x45, ['G'] = 0x46, ['H'] = 0x47,
+    ['I'] = 0x48, ['J'] = 0x49, ['K'] = 0x4A, ['L'] = 0x4B, ['M'] = 0x4C, ['N'] = 0x4D, ['O'] = 0x4E, ['P'] = 0x4F,
+    ['Q'] = 0x50, ['R'] = 0x51, ['S'] = 0x52, ['T'] = 0x53, ['U'] = 0x54, ['V'] = 0x55, ['W'] = 0x56, ['X'] = 0x57,
+    ['Y'] = 0x58, ['Z'] = 0x59, ['a'] = 0x5A, ['b'] = 0x5B, ['c'] = 0x5C, ['d'] = 0x5D, ['e'] = 0x5E, ['f'] = 0x5F,
+    ['g'] = 0x60, ['h'] = 0x61, ['i'] = 0x62, ['j'] = 0x63, ['k'] = 0x64, ['l'] = 0x65, ['m'] = 0x66, ['n'] = 0x67,
+    ['o'] = 0x68, ['p'] = 0x69, ['q'] = 0x6A, ['r'] = 0x6B, ['s'] = 0x6C, ['t'] = 0x6D, ['u'] = 0x6E, ['v'] = 0x6F,
+    ['w'] = 0x70, ['x'] = 0x71, ['y'] = 0x72, ['z'] = 0x73, ['0'] = 0x74, ['1'] = 0x75, ['2'] = 0x76, ['3'] = 0x77,
+    ['4'] = 0x78, ['5'] = 0x79, ['6'] = 0x7A, ['7'] = 0x7B, ['8'] = 0x7C, ['9'] = 0x7D, ['+'] = 0x7E, ['/'] = 0x7F
+};
+
+static size_t decode_base64_scalar(const char* text, size_t length, unsigned char* out) {
+    const unsigned char* in = (const unsigned char*)text;
+    size_t i = 0;
+
+    for (; i + 4 <= length; i += 4) {
+        const unsigned int a = base64_sextets[in[i]], b = base64_sextets[in[i + 1]];
+        const unsigned int c = base64_sextets[in[i + 2]], d = base64_sextets[in[i + 3]];
+        if (!(a & b & c & d & 0x40)) break;
+
+        const unsigned int group = (a & 0x3F) << 18 | (b & 0x3F) << 12 | (c & 0x3F) << 6 | (d & 0x3F);
+        *out++ = (unsigned char)(group >> 16);
+        *out++ = (unsigned char)(group >> 8);
+        *out++ = (unsigned char)group;
+    }
+
+    return i;
+}
+
+#ifdef SCAN_X86
+SCAN_TARGET("sse2")
+static size_t scan_latex_sse2(const char* text, size_t length) {
+    const __m128i backslash = _mm_set1_epi8('\\'), open = _mm_set1_epi8('{');
+    const __m128i close = _mm_set1_epi8('}'), amp = _mm_set1_epi8('&');
+    const __m128i percent = _mm_set1_epi8('%'), dollar = _mm_set1_epi8('$');
+    const __m128i hash = _mm_set1_epi8('#'), under = _mm_set1_epi8('_');
+    const __m128i caret = _mm_set1_epi8('^'), tilde = _mm_set1_epi8('~');
+    const __m128i less = _mm_set1_epi8('<'), greater = _mm_set1_epi8('>');
+    const __m128i newline = _mm_set1_epi8('\n');
+    size_t i = 0;
+
+    for (; i + 16 <= length; i += 16) {
+        const __m128i v = _mm_loadu_si128((const __m128i*)(text + i));
+        __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(v, backslash), _mm_cmpeq_epi8(v, open));
+
+        hit = _mm_or_si128(hit, _mm_or_si128(_mm_cmpeq_epi8(v, close), _mm_cmpeq_epi8(v, amp)));
+        hit = _mm_or_si128(hit, _mm_or_si128(_mm_cmpeq_epi8(v, percent), _mm_cmpeq_epi8(v, dollar)));
+        hit = _mm_or_si128(hit, _mm_or_si128(_mm_cmpeq_epi8(v, hash), _mm_cmpeq_epi8(v, under)));
+        hit = _mm_or_si128(hit, _mm_or_si128(_mm_cmpeq_epi8(v, caret), _mm_cmpeq_epi8(v, tilde)));
+        hit = _mm_or_si128(hit, _mm_or_si128(_mm_cmpeq_epi8(v, less), _mm_cmpeq_epi8(v, greater)));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, newline));
+
+        const unsigned int mask = (unsigned int)_mm_movemask_epi8(hit);
+        if (mask) return i + SCAN_CTZ(mask);
+    }
+
+    return i + scan_latex_scalar(text + i, length - i);
+}
+
+SCAN_TARGET("sse2")
+static size_t scan_space_sse2(const char* text, size_t length) {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i range = _mm_set1_epi8('\r' - '\t');
+    size_t i = 0;
+
+    for (; i + 16 <= length; i += 16) {
+        const __m128i v = _mm_loadu_si128((const __m128i*)(text + i));
+
+        /* '\t'..'\r' is one range, tested as an unsigned distance from '\t' */
+        const __m128i offset = _mm_sub_epi8(v, tab);
+        const __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(offset, range), offset);
+        const __m128i hit = _mm_or_si128(control, _mm_cmpeq_epi8(v, space));
+
+        const unsigned int mask = (unsigned int)_mm_movemask_epi8(hit);
+        if (mask) return i + SCAN_CTZ(mask);
+    }
+
+    return i + scan_space_scalar(text + i, length - i);
+}
+
+/* Nibble tables of latex_bytes: a byte is special when lo[c & 15] & hi[c >> 4] is set. */
+SCAN_TARGET("avx2")
+static size_t scan_latex_avx2(const char* text, size_t length) {
+    const __m256i lo_table = _mm256_setr_epi8(
+        0x00, 0x00, 0x00, 0x02, 0x02, 0x02, 0x02, 0x00, 0x00, 0x00, 0x01, 0x10, 0x0C, 0x10, 0x1C, 0x08,
+        0x00, 0x00, 0x00, 0x02, 0x02, 0x02, 0x02, 0x00, 0x00, 0x00, 0x01, 0x10, 0x0C, 0x10, 0x1C, 0x08);
+    const __m256i hi_table = _mm256_setr_epi8(
+        0x01, 0x00, 0x02, 0x04, 0x00, 0x08, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x01, 0x00, 0x02, 0x04, 0x00, 0x08, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00);
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    const __m256i zero = _mm256_setzero_si256();
+    size_t i = 0;
+
+    for (; i + 32 <= length; i += 32) {
+        const __m256i v = _mm256_loadu_si256((const __m256i*)(text + i));
+        const __m256i lo = _mm256_shuffle_epi8(lo_table, _mm256_and_si256(v, nibble));
+        const __m256i hi = _mm256_shuffle_epi8(hi_table, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+
+        const __m256i miss = _mm256_cmpeq_epi8(_mm256_and_si256(lo, hi), zero);
+        const unsigned int mask = ~(unsigned int)_mm256_movemask_epi8(miss);
+        if (mask) return i + SCAN_CTZ(mask);
+    }
+
+    return i + scan_latex_sse2(text + i, length - i);
+}
+
+SCAN_TARGET("avx2")
+static size_t scan_space_avx2(const char* text, size_t length) {
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i range = _mm256_set1_epi8('\r' - '\t');
+    size_t i = 0;
+
+    for (; i + 32 <= length; i += 32) {
+        const __m256i v = _mm256_loadu_si256((const __m256i*)(text + i));
+        const __m256i offset = _mm256_sub_epi8(v, tab);
+        const __m256i control = _mm256_cmpeq_epi8(_mm256_min_epu8(offset, range), offset);
+        const __m256i hit = _mm256_or_si256(control, _mm256_cmpeq_epi8(v, space));
+
+        const unsigned int mask = (unsigned int)_mm256_movemask_epi8(hit);
+        if (mask) return i + SCAN_CTZ(mask);
+    }
+
+    return i + scan_space_sse2(text + i, length - i);
+}
+
+/* Translates 32 characters to sextets through nibble tables, validating them on
+   the way, then packs the sextets into 24 bytes; an invalid block ends the run. */
+SCAN_TARGET("avx2")
+static size_t decode_base64_avx2(const char* text, size_t length, unsigned char* out) {
+    const __m256i lut_lo = _mm256_setr_epi8(
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m256i lut_hi = _mm256_setr_epi8(
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m256i lut_roll = _mm256_setr_epi8(
+        0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i pack_shuffle = _mm256_setr_epi8(
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    const __m256i pack_lanes = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+    const __m256i mask_2f = _mm256_set1_epi8(0x2F);
+    size_t i = 0;
+
+    for (; i + 32 <= length; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(text + i));
+        const __m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(v, 4), mask_2f);
+        const __m256i lo_nibbles = _mm256_and_si256(v, mask_2f);
+
+        const __m256i hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+        const __m256i lo = _mm256_shuffle_epi8(lut_lo, lo_nibbles);
+        if (!_mm256_testz_si256(lo, hi)) break;
+
+        /* '/' shares its high nibble with '+', so it gets a roll of its own */
+        const __m256i roll = _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(_mm256_cmpeq_epi8(v, mask_2f), hi_nibbles));
+        v = _mm256_add_epi8(v, roll);
+
+        /* sextets to 24-bit groups, then the groups of both lanes side by side */
+        v = _mm256_maddubs_epi16(v, _mm256_set1_epi32(0x01400140));
+        v = _mm256_madd_epi16(v, _mm256_set1_epi32(0x00011000));
+        v = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v, pack_shuffle), pack_lanes);
+
+        _mm_storeu_si128((__m128i*)out, _mm256_castsi256_si128(v));
+        _mm_storel_epi64((__m128i*)(out + 16), _mm256_extracti128_si256(v, 1));
+        out += 24;
+    }
+
+    return i + decode_base64_scalar(text + i, length - i, out);
+}
+
+static int cpu_has_sse2(void) {
+#if defined(__x86_64__) || defined(_M_X64)
+    return 1;
+#elif defined(_MSC_VER)
+    return IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE) != 0;
+#else
+    return __builtin_cpu_supports("sse2");
+#endif
+}
+
+static int cpu_has_avx2(void) {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return 0;
+
+    /* the OS must also save the ymm registers */
+    __cpuid(info, 1);
+    if (!(info[2] & (1 << 27)) || (_xgetbv(0) & 6) != 6) return 0;
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+static ScanKernels kernels = { scan_latex_scalar, scan_space_scalar, decode_base64_scalar, "scalar" };
+
+static void select_kernels(void) {
+#ifdef SCAN_X86
+    if (cpu_has_avx2()) {
+        kernels.latex = scan_latex_avx2;
+        kernels.space = scan_space_avx2;
+        kernels.base64 = decode_base64_avx2;
+        kernels.name = "avx2";
+    }
+    else if (cpu_has_sse2()) {
+        kernels.latex = scan_latex_sse2;
+        kernels.space = scan_space_sse2;
+        kernels.name = "sse2";
+    }
+#endif
+}
+
+#ifdef _WIN32
+static INIT_ONCE kernels_once = INIT_ONCE_STATIC_INIT;
+
+static BOOL CALLBACK select_kernels_callback(PINIT_ONCE once, PVOID parameter, PVOID* context) {
+    (void)once; (void)parameter; (void)context;
+    select_kernels();
+    return TRUE;
+}
+#else
+static pthread_once_t kernels_once = PTHREAD_ONCE_INIT;
+#endif
+
+/* Picks the kernels for this CPU on first use, from whichever thread gets there first. */
+static const ScanKernels* scan_kernels(void) {
+#ifdef _WIN32
+    InitOnceExecuteOnce(&kernels_once, select_kernels_callback, NULL, NULL);
+#else
+    pthread_once(&kernels_once, select_kernels);
+#endif
+    return &kernels;
+}
+
+size_t html2tex_scan_latex(const char* text, size_t length) {
+    if (length < SCAN_MIN_VECTOR)
+        return scan_latex_scalar(text, length);
+
+    return scan_kernels()->latex(text, length);
+}
+
+size_t html2tex_scan_space(const char* text, size_t length) {
+    if (length < SCAN_MIN_VECTOR)
+        return scan_space_scalar(text, length);
+
+    return scan_kernels()->space(text, length);
+}
+
+size_t html2tex_decode_base64(const char* text, size_t length, unsigned char* out) {
+    if (length < 32)
+        return decode_base64_scalar(text, length, out);
+
+    return scan_kernels()->base64(text, length, out);
+}
+
+const char* html2tex_scan_isa(void) {
+    return scan_kernels()->name;
+}
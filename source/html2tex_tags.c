@@ -0,0 +1,255 @@
+/* Generated by scripts/gen_tags.py from the tag enum in html2tex.h; do not edit. */
+#include "html2tex.h"
+#include <string.h>
+
+#define TAG_HASH_SEED 97u
+#define TAG_HASH_SLOTS 1024
+#define TAG_MAX_LENGTH 10
+
+static const char* const tag_names[HTML2TEX_TAG_COUNT] = {
+    NULL, NULL,
+    "a", "abbr", "address", "area", "article", "aside", "audio", "b",
+    "base", "bdi", "bdo", "blockquote", "body", "br", "button", "canvas",
+    "caption", "center", "cite", "code", "col", "colgroup", "data", "dd",
+    "del", "dfn", "div", "dl", "dt", "em", "embed", "figcaption",
+    "figure", "font", "footer", "form", "frame", "frameset", "h1", "h2",
+    "h3", "h4", "h5", "h6", "head", "header", "hr", "html",
+    "i", "iframe", "img", "input", "ins", "kbd", "label", "li",
+    "link", "main", "map", "mark", "meta", "meter", "nav", "noframes",
+    "noscript", "object", "ol", "optgroup", "option", "output", "p", "param",
+    "picture", "pre", "progress", "q", "rp", "rt", "ruby", "s",
+    "samp", "script", "search", "section", "select", "small", "source", "span",
+    "strike", "strong", "style", "sub", "sup", "svg", "table", "tbody",
+    "td", "template", "textarea", "tfoot", "th", "thead", "time", "title",
+    "tr", "track", "tt", "u", "ul", "var", "video", "wbr",
+};
+
+static const unsigned int tag_flags[HTML2TEX_TAG_COUNT] = {
+    0, 0,
+    HTML2TEX_TAG_IS_INLINE | HTML2TEX_TAG_IS_PHRASING, /* a */
+    HTML2TEX_TAG_IS_INLINE | HTML2TEX_TAG_IS_PHRASING, /* abbr */
+    0, /* address */
+    HTML2TEX_TAG_IS_EXCLUDED | HTML2TEX_TAG_IS_VOID, /* area */
+    HTML2TEX_TAG_IS_BLOCK, /* article */
+    HTML2TEX_TAG_IS_BLOCK, /* aside */
+    HTML2TEX_TAG_IS_EXCLUDED, /* audio */
+    HTML2TEX_TAG_IS_INLINE | HTML2TEX_TAG_IS_PHRASING, /* b */
+    HTML2TEX_TAG_IS_VOID, /* base */
+    HTML2TEX_TAG_IS_INLINE | HTML2TEX_TAG_IS_PHRASING, /* bdi */
+    HTML2TEX_TAG_IS_INLINE | HTML2TEX_TAG_IS_EXCLUDED | HTML2TEX_TAG_IS_PHRASING, /* bdo */
+    HTML2TEX_TAG_IS_BLOCK | HTML2TEX_TAG_IS_EXCLUDED, /* blockquote */
+    0, /* body */
+    HTML2TEX_TAG_IS_INLINE | HTML2TEX_TAG_IS_VOID | HTML2TEX_TAG_IS_ESSENTIAL | HTML2TEX_TAG_IS_PHRASING, /* br */
+    HTML2TEX_TAG_IS_INLINE | HTML2TEX_TAG_IS_EXCLUDED, /* button */
+    HTML2TEX_TAG_IS_EXCLUDED, /* canvas */
+    0, /* caption */
+    0, /* center */
+    HTML2TEX_TAG_IS_INLINE | HTML2TEX_TAG_IS_PHRASING, /* cite */
+    HTML2TEX_TAG_IS_INLINE | HTML2TEX_TAG_IS_PRESERVE_WS | HTML2TEX_TAG_IS_PHRASING, /* code */
+    HTML2TEX_TAG_IS_VOID, /* col */
+    0, /* colgroup */
+    HTML2TEX_TAG_IS_INLINE | HTML2TEX_TAG_IS_PHRASING, /* data */
+    0, /* dd */
+    0, /* del */
+    HTML2TEX_TAG_IS_INLINE | HTML2TEX_TAG_IS_PHRASING, /* dfn */
+    HTML2TEX_TAG_IS_BLOCK, /* div */
+    0, /* dl */
+    0, /* dt */
+    HTML2TEX_TAG_IS_INLINE | HTML2TEX_TAG_IS_PHRASING, /* em */
+    HTML2TEX_TAG_IS_VOID, /* embed */
+    HTML2TEX_TAG_IS_BLOCK, /* figcaption */
+    HTML2TEX_TAG_IS_BLOCK, /* figure */
+    HTML2TEX_TAG_IS_INLINE | HTML2TEX_TAG_IS_PHRASING, /* font */
+    HTML2TEX_TAG_IS_BLOCK, /* footer */
+    HTML2TEX_TAG_IS_EXCLUDED, /* form */
+    HTML2TEX_TAG_IS_EXCLUDED, /* frame */
+    HTML2TEX_TAG_IS_EXCLUDED, /* frameset */
+    HTML2TEX_TAG_IS_BLOCK, /* h1 */
+    HTML2TEX_TAG_IS_BLOCK, /* h2 */
+    HTML2TEX_TAG_IS_BLOCK, /* h3 */
+    HTML2TEX_TAG_IS_BLOCK, /* h4 */
+    HTML2TEX_TAG_IS_BLOCK, /* h5 */
+    HTML2TEX_TAG_IS_BLOCK, /* h6 */
+    HTML2TEX_TAG_IS_EXCLUDED, /* head */
+    HTML2TEX_TAG_IS_BLOCK, /* header */
+    HTML2TEX_TAG_IS_VOID | HTML2TEX_TAG_IS_ESSENTIAL, /* hr */
+    0, /* html */
+    HTML2TEX_TAG_IS_INLINE | HTML2TEX_TAG_IS_PHRASING, /* i */
+    HTML2TEX_TAG_IS_EXCLUDED, /* iframe */
+    HTML2TEX_TAG_IS_INLINE | HTML2TEX_TAG_IS_VOID | HTML2TEX_TAG_IS_ESSENTIAL, /* img */
+    HTML2TEX_TAG_IS_INLINE | HTML2TEX_TAG_IS_EXCLUDED | HTML2TEX_TAG_IS_VOID | HTML2TEX_TAG_IS_ESSENTIAL, /* input */
+    0, /* ins */
+    HTML2TEX_TAG_IS_INLINE | HTML2TEX_TAG_IS_PHRASING, /* kbd */
+    HTML2TEX_TAG_IS_INLINE | HTML2TEX_TAG_IS_EXCLUDED, /* label */
+    HTML2TEX_TAG_IS_BLOCK, /* li */
+    HTML2TEX_TAG_IS_EXCLUDED | HTML2TEX_TAG_IS_VOID | HTML2TEX_TAG_IS_ESSENTIAL, /* link */
+    HTML2TEX_TAG_IS_BLOCK, /* main */
+    HTML2TEX_TAG_IS_INLINE | HTML2TEX_TAG_IS_EXCLUDED, /* map */
+    HTML2TEX_TAG_IS_INLINE | HTML2TEX_TAG_IS_EXCLUDED | HTML2TEX_TAG_IS_PHRASING, /* mark */
+    HTML2TEX_TAG_IS_EXCLUDED | HTML2TEX_TAG_IS_VOID | HTML2TEX_TAG_IS_ESSENTIAL, /* meta */
+    HTML2TEX_TAG_IS_INLINE | HTML2TEX_TAG_IS_EXCLUDED, /* meter */
+    HTML2TEX_TAG_IS_BLOCK | HTML2TEX_TAG_IS_EXCLUDED, /* nav */
+    HTML2TEX_TAG_IS_EXCLUDED, /* noframes */
+    HTML2TEX_TAG_IS_EXCLUDED, /* noscript */
+    HTML2TEX_TAG_IS_INLINE | HTML2TEX_TAG_IS_EXCLUDED, /* object */
+    HTML2TEX_TAG_IS_BLOCK, /* ol */
+    HTML2TEX_TAG_IS_EXCLUDED, /* optgroup */
+    HTML2TEX_TAG_IS_EXCLUDED, /* option */
+    HTML2TEX_TAG_IS_INLINE, /* output */
+    HTML2TEX_TAG_IS_BLOCK, /* p */
+    HTML2TEX_TAG_IS_EXCLUDED | HTML2TEX_TAG_IS_VOID, /* param */
+    HTML2TEX_TAG_IS_EXCLUDED, /* picture */
+    HTML2TEX_TAG_IS_PRESERVE_WS, /* pre */
+    HTML2TEX_TAG_IS_INLINE | HTML2TEX_TAG_IS_EXCLUDED, /* progress */
+    HTML2TEX_TAG_IS_INLINE | HTML2TEX_TAG_IS_EXCLUDED | HTML2TEX_TAG_IS_PHRASING, /* q */
+    HTML2TEX_TAG_IS_INLINE | HTML2TEX_TAG_IS_PHRASING, /* rp */
+    HTML2TEX_TAG_IS_INLINE | HTML2TEX_TAG_IS_PHRASING, /* rt */
+    HTML2TEX_TAG_IS_INLINE | HTML2TEX_TAG_IS_PHRASING, /* ruby */
+    HTML2TEX_TAG_IS_PHRASING, /* s */
+    HTML2TEX_TAG_IS_INLINE | HTML2TEX_TAG_IS_EXCLUDED | HTML2TEX_TAG_IS_PHRASING, /* samp */
+    HTML2TEX_TAG_IS_EXCLUDED | HTML2TEX_TAG_IS_PRESERVE_WS, /* script */
+    HTML2TEX_TAG_IS_EXCLUDED, /* search */
+    HTML2TEX_TAG_IS_BLOCK, /* section */
+    HTML2TEX_TAG_IS_INLINE | HTML2TEX_TAG_IS_EXCLUDED, /* select */
+    HTML2TEX_TAG_IS_INLINE | HTML2TEX_TAG_IS_PHRASING, /* small */
+    HTML2TEX_TAG_IS_EXCLUDED | HTML2TEX_TAG_IS_VOID, /* source */
+    HTML2TEX_TAG_IS_INLINE | HTML2TEX_TAG_IS_PHRASING, /* span */
+    0, /* strike */
+    HTML2TEX_TAG_IS_INLINE | HTML2TEX_TAG_IS_PHRASING, /* strong */
+    HTML2TEX_TAG_IS_EXCLUDED | HTML2TEX_TAG_IS_PRESERVE_WS, /* style */
+    HTML2TEX_TAG_IS_INLINE | HTML2TEX_TAG_IS_PHRASING, /* sub */
+    HTML2TEX_TAG_IS_INLINE | HTML2TEX_TAG_IS_PHRASING, /* sup */
+    HTML2TEX_TAG_IS_EXCLUDED, /* svg */
+    HTML2TEX_TAG_IS_BLOCK, /* table */
+    0, /* tbody */
+    HTML2TEX_TAG_IS_BLOCK, /* td */
+    HTML2TEX_TAG_IS_EXCLUDED, /* template */
+    HTML2TEX_TAG_IS_INLINE | HTML2TEX_TAG_IS_PRESERVE_WS, /* textarea */
+    0, /* tfoot */
+    HTML2TEX_TAG_IS_BLOCK, /* th */
+    0, /* thead */
+    HTML2TEX_TAG_IS_INLINE | HTML2TEX_TAG_IS_PHRASING, /* time */
+    0, /* title */
+    HTML2TEX_TAG_IS_BLOCK, /* tr */
+    HTML2TEX_TAG_IS_EXCLUDED | HTML2TEX_TAG_IS_VOID, /* track */
+    0, /* tt */
+    HTML2TEX_TAG_IS_INLINE | HTML2TEX_TAG_IS_PHRASING, /* u */
+    HTML2TEX_TAG_IS_BLOCK, /* ul */
+    HTML2TEX_TAG_IS_INLINE | HTML2TEX_TAG_IS_EXCLUDED | HTML2TEX_TAG_IS_PHRASING, /* var */
+    HTML2TEX_TAG_IS_EXCLUDED, /* video */
+    HTML2TEX_TAG_IS_INLINE | HTML2TEX_TAG_IS_EXCLUDED | HTML2TEX_TAG_IS_VOID | HTML2TEX_TAG_IS_PHRASING, /* wbr */
+};
+
+/* perfect hash: every known name maps to its own slot */
+static const unsigned char tag_slots[TAG_HASH_SLOTS] = {
+    16, 0, 0, 109, 0, 0, 0, 0, 0, 0, 0, 91, 0, 0, 0, 0,
+    0, 49, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 51, 0, 0, 83,
+    0, 0, 0, 0, 34, 0, 0, 39, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 42, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    15, 0, 0, 0, 29, 0, 0, 68, 0, 0, 60, 0, 108, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 45, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 88, 0, 0, 0, 0, 0, 0, 0, 0, 0, 55, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 59, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 69, 19, 0, 0,
+    0, 10, 103, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 72, 0, 0, 0,
+    0, 0, 0, 85, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 11, 0, 0, 0, 0, 0, 0, 0, 113, 0, 0, 30, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 71, 0, 52, 24, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 38, 56, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 90, 40,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 31, 0, 0, 0, 0, 2,
+    0, 0, 79, 0, 0, 0, 106, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    43, 0, 0, 0, 101, 0, 0, 0, 54, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 18, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    94, 0, 0, 0, 58, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 32, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 81, 22, 0, 96, 0, 0, 0, 98, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 63, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 89, 0, 0, 0,
+    0, 0, 0, 57, 0, 0, 0, 0, 0, 26, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 50, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 82, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 86, 0, 0, 0,
+    0, 62, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 27, 0, 0, 0, 0, 0, 0, 0, 0, 75, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 104, 0, 0, 0, 92, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 8, 0,
+    0, 0, 0, 0, 0, 73, 0, 0, 0, 0, 0, 0, 0, 0, 0, 77,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 21, 0, 0, 0, 0, 0, 0, 0, 0, 95, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 46, 0, 0, 0, 0, 0, 97, 0, 0, 0,
+    0, 0, 41, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 9, 0, 0, 0, 0, 3, 0, 0, 0, 107, 0, 110, 0, 0,
+    0, 0, 0, 44, 0, 0, 0, 0, 33, 0, 0, 0, 0, 0, 0, 0,
+    17, 0, 0, 0, 0, 0, 78, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 64, 0, 0, 80, 0, 0, 0, 0, 0, 0, 87, 0, 0, 6, 13,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 47, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 100, 0,
+    0, 0, 0, 0, 4, 0, 93, 28, 0, 0, 0, 0, 0, 0, 0, 76,
+    0, 0, 0, 67, 0, 0, 74, 0, 0, 0, 0, 0, 0, 61, 0, 36,
+    0, 0, 48, 0, 66, 0, 0, 0, 0, 0, 0, 0, 0, 0, 99, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 65, 0, 0, 7, 0, 0, 0, 0, 23, 0, 0, 0, 70, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 53, 0, 0, 0, 25, 0, 0, 20,
+    0, 0, 0, 0, 0, 5, 0, 0, 84, 0, 0, 0, 0, 0, 0, 112,
+    14, 0, 37, 0, 0, 0, 0, 0, 102, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 105, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 111, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 35, 0, 0, 0, 0, 0, 12, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+int html2tex_tag_lookup(const char* name, size_t length) {
+    if (!name || length == 0 || length > TAG_MAX_LENGTH)
+        return HTML2TEX_TAG_UNKNOWN;
+
+    /* FNV-1a with a seed chosen so the known names never collide */
+    unsigned int hash = 2166136261u ^ TAG_HASH_SEED;
+
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)name[i];
+        hash *= 16777619u;
+    }
+
+    const int id = tag_slots[hash % TAG_HASH_SLOTS];
+
+    /* one comparison rejects names that merely share a slot, stopping at the shorter one */
+    if (id && strncmp(tag_names[id], name, length) == 0 && tag_names[id][length] == '\0')
+        return id;
+
+    return HTML2TEX_TAG_UNKNOWN;
+}
+
+const char* html2tex_tag_name(int tag_id) {
+    if (tag_id <= HTML2TEX_TAG_UNKNOWN || tag_id >= HTML2TEX_TAG_COUNT)
+        return NULL;
+
+    return tag_names[tag_id];
+}
+
+unsigned int html2tex_tag_flags(int tag_id) {
+    if (tag_id <= HTML2TEX_TAG_UNKNOWN || tag_id >= HTML2TEX_TAG_COUNT)
+        return 0;
+
+    return tag_flags[tag_id];
+}
+
+int html2tex_node_tag(HTMLNode* node) {
+    if (!node) return HTML2TEX_TAG_UNKNOWN;
+
+    /* resolve once, then every later query is a field read */
+    if (node->tag_id == HTML2TEX_TAG_UNRESOLVED)
+        node->tag_id = node->tag ? html2tex_tag_lookup(node->tag, strlen(node->tag))
+            : HTML2TEX_TAG_UNKNOWN;
+
+    return node->tag_id;
+}
@@ -1,8 +1,21 @@
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 #include "html2tex.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <errno.h>
 
 
 static void rev_str(char* str, int length) {
@@ -72,4 +85,145 @@ char* html2tex_strdup(const char* str) {
         memcpy(copy, str, len);
 
     return copy;
-}
\ No newline at end of file
+}
+
+size_t html2tex_file_sink(void* context, const char* data, size_t size) {
+    FILE* file = (FILE*)context;
+    if (!file) return 0;
+
+    return fwrite(data, 1, size, file);
+}
+
+size_t html2tex_fd_sink(void* context, const char* data, size_t size) {
+    const int fd = (int)(intptr_t)context;
+    size_t written = 0;
+
+    /* write() may accept less than asked, so loop until done */
+    while (written < size) {
+        size_t chunk = size - written;
+#ifdef _WIN32
+        if (chunk > INT_MAX) chunk = INT_MAX;
+        int result = _write(fd, data + written, (unsigned int)chunk);
+#else
+        ssize_t result = write(fd, data + written, chunk);
+#endif
+        if (result < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        if (result == 0) break;
+        written += (size_t)result;
+    }
+
+    return written;
+}
+
+#ifdef _WIN32
+typedef HANDLE FileHandle;
+#else
+typedef int FileHandle;
+#endif
+
+/* Reads up to size bytes, returning 0 at the end of the file and -1 on failure. */
+static ptrdiff_t read_chunk(FileHandle file, char* buffer, size_t size) {
+#ifdef _WIN32
+    DWORD count;
+    return ReadFile(file, buffer, (DWORD)size, &count, NULL) ? (ptrdiff_t)count : -1;
+#else
+    for (;;) {
+        const ssize_t count = read(file, buffer, size);
+        if (count >= 0 || errno != EINTR) return (ptrdiff_t)count;
+    }
+#endif
+}
+
+/* Parses a file that cannot be mapped, such as a pipe or an empty file, by
+   feeding it to a push parser in chunks. */
+static HTMLNode* parse_file_chunks(FileHandle file, int options) {
+    HTMLStreamParser* parser = html2tex_parser_create(options);
+    char* buffer = (char*)malloc(HTML2TEX_SINK_BUFFER_SIZE);
+
+    if (!parser || !buffer) {
+        html2tex_parser_destroy(parser);
+        free(buffer);
+        return NULL;
+    }
+
+    ptrdiff_t count;
+
+    /* a failed feed leaves the parser failed, so finishing it returns NULL */
+    while ((count = read_chunk(file, buffer, HTML2TEX_SINK_BUFFER_SIZE)) > 0)
+        if (html2tex_parser_feed(parser, buffer, (size_t)count) != 0) break;
+
+    free(buffer);
+
+    if (count < 0) {
+        html2tex_parser_destroy(parser);
+        return NULL;
+    }
+
+    return html2tex_parser_finish(parser);
+}
+
+HTMLNode* html2tex_parse_file(const char* path, int options) {
+    if (!path) return NULL;
+    HTMLNode* root;
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+        OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+    if (file == INVALID_HANDLE_VALUE) return NULL;
+    LARGE_INTEGER size;
+
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0 && (unsigned long long)size.QuadPart <= SIZE_MAX) {
+        HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        const char* view = mapping ? (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+
+        /* the view keeps the mapping alive on its own */
+        if (mapping) CloseHandle(mapping);
+
+        if (view) {
+            CloseHandle(file);
+            root = html2tex_parse_ex(view, (size_t)size.QuadPart, options);
+
+            UnmapViewOfFile(view);
+            return root;
+        }
+    }
+
+    root = parse_file_chunks(file, options);
+    CloseHandle(file);
+#else
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat info;
+
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0 &&
+        (unsigned long long)info.st_size <= SIZE_MAX) {
+        const size_t size = (size_t)info.st_size;
+        void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (map != MAP_FAILED) {
+            close(fd);
+
+            /* the tokenizer reads the mapping once, front to back */
+#ifdef MADV_SEQUENTIAL
+            madvise(map, size, MADV_SEQUENTIAL);
+#endif
+            /* the tree copies what it keeps, so the mapping can go right after */
+            root = html2tex_parse_ex((const char*)map, size, options);
+
+            munmap(map, size);
+            return root;
+        }
+    }
+
+    root = parse_file_chunks(fd, options);
+    close(fd);
+#endif
+
+    return root;
+}
@@ -3,6 +3,78 @@
 #include <iostream>
 #include <fstream>
 #include <stdexcept>
+#include <cstring>
+#include <vector>
+
+/* Sink forwarding streamed LaTeX output to the std::ostream passed as context. */
+static std::size_t ostream_sink(void* context, const char* data, std::size_t size) {
+    std::ostream* const output = static_cast<std::ostream*>(context);
+    return output->write(data, static_cast<std::streamsize>(size)) ? size : 0;
+}
+
+/* Writes filePath through a temporary beside it that replaces the file only once write
+   succeeded, so a failed or empty conversion leaves the previous file untouched. */
+template<typename Writer>
+static bool write_file_replacing(const std::string& filePath, const void* owner,
+    std::ios::openmode mode, Writer write) {
+    /* converters writing at once never share a temporary */
+    char suffix[32];
+    std::snprintf(suffix, sizeof(suffix), ".%lx.tmp",
+        static_cast<unsigned long>(reinterpret_cast<std::uintptr_t>(owner)));
+
+    const std::string temp = filePath + suffix;
+    bool written = false;
+
+    {
+        std::ofstream fout;
+
+        /* the converter already writes in large chunks, skip stream buffering */
+        fout.rdbuf()->pubsetbuf(nullptr, 0);
+        fout.open(temp, mode | std::ios::trunc);
+
+        if (!fout)
+            throw std::runtime_error("Cannot open output file: " + filePath);
+
+        try {
+            written = write(static_cast<std::ostream&>(fout));
+        }
+        catch (...) {
+            fout.close();
+            std::remove(temp.c_str());
+            throw;
+        }
+
+        fout.close();
+
+        if (written && !fout) {
+            std::remove(temp.c_str());
+            throw std::runtime_error("Failed to write LaTeX output.");
+        }
+    }
+
+    if (!written) {
+        std::remove(temp.c_str());
+        return false;
+    }
+
+    if (std::rename(temp.c_str(), filePath.c_str()) != 0) {
+#ifdef _WIN32
+        /* rename does not replace an existing file there, so the old one goes first */
+        std::remove(filePath.c_str());
+
+        if (std::rename(temp.c_str(), filePath.c_str()) != 0) {
+            std::remove(temp.c_str());
+            throw std::runtime_error("Cannot replace output file: " + filePath);
+        }
+#else
+        /* POSIX rename replaces atomically, a failure leaves the old file in place */
+        std::remove(temp.c_str());
+        throw std::runtime_error("Cannot replace output file: " + filePath);
+#endif
+    }
+
+    return true;
+}
 
 HtmlTeXConverter::HtmlTeXConverter() : converter(nullptr, &html2tex_destroy), valid(false) {
     LaTeXConverter* raw_converter = html2tex_create();
@@ -31,6 +103,48 @@ HtmlTeXConverter::HtmlTeXConverter(HtmlTeXConverter&& other) noexcept
     other.valid = false;
 }
 
+void HtmlTeXConverter::setRetainOutput(bool enable) const noexcept {
+    if (converter && valid)
+        html2tex_set_retain_output(converter.get(), enable ? 1 : 0);
+}
+
+void HtmlTeXConverter::setStyleCacheSize(std::size_t entries) const noexcept {
+    if (converter && valid)
+        html2tex_set_style_cache_size(converter.get(), entries);
+}
+
+std::size_t HtmlTeXConverter::getStyleCacheHits() const noexcept {
+    std::size_t hits = 0;
+    html2tex_get_style_cache_stats(converter.get(), &hits, nullptr);
+    return hits;
+}
+
+std::size_t HtmlTeXConverter::getStyleCacheMisses() const noexcept {
+    std::size_t misses = 0;
+    html2tex_get_style_cache_stats(converter.get(), nullptr, &misses);
+    return misses;
+}
+
+void HtmlTeXConverter::setMaxDepth(std::size_t depth) const noexcept {
+    if (converter && valid)
+        html2tex_set_max_depth(converter.get(), depth);
+}
+
+void HtmlTeXConverter::setDownloadConcurrency(int limit) const noexcept {
+    if (converter && valid)
+        html2tex_set_download_concurrency(converter.get(), limit);
+}
+
+void HtmlTeXConverter::setAsyncImages(bool enable) const noexcept {
+    if (converter && valid)
+        html2tex_set_async_images(converter.get(), enable ? 1 : 0);
+}
+
+bool HtmlTeXConverter::setImageCache(const std::string& directory, unsigned long long maxBytes) const noexcept {
+    if (!converter || !valid) return false;
+    return html2tex_set_image_cache(converter.get(), directory.empty() ? nullptr : directory.c_str(), maxBytes) == 0;
+}
+
 bool HtmlTeXConverter::setDirectory(const std::string& fullPath) const noexcept {
     if (!converter || !valid) return false;
     html2tex_set_image_directory(converter.get(), fullPath.c_str());
@@ -48,8 +162,9 @@ std::string HtmlTeXConverter::convert(const std::string& html) const {
     if (html.empty())
         return "";
 
-    /* convert HTML to LaTeX */
-    char* const raw_result = html2tex_convert(converter.get(), html.c_str());
+    /* convert HTML to LaTeX, borrowing the converter's buffer */
+    std::size_t result_len = 0;
+    const char* const raw_result = html2tex_convert_view(converter.get(), html.c_str(), &result_len);
 
     /* handle nullptr result */
     if (!raw_result) {
@@ -63,18 +178,7 @@ std::string HtmlTeXConverter::convert(const std::string& html) const {
         return "";
     }
 
-    /* ensures memory is freed even on exceptions */
-    const auto deleter = [](char* p) noexcept { if (p) std::free(p); };
-    std::unique_ptr<char[], decltype(deleter)> result_guard(raw_result, deleter);
-
-    /* check if result is actually empty */
-    if (raw_result[0] == '\0')
-        return "";
-
-    /* measure length first to avoid double calculation */
-    const std::size_t result_len = std::char_traits<char>::length(raw_result);
-
-    /* return the result */
+    /* the only copy made of the output */
     return std::string(raw_result, result_len);
 }
 
@@ -86,33 +190,23 @@ bool HtmlTeXConverter::convertToFile(const std::string& html, const std::string&
     if (html.empty()) 
         return false;
 
-    /* convert the HTML code first */
-    std::unique_ptr<char[], void(*)(char*)> result(
-        html2tex_convert(converter.get(), html.c_str()),
-        [](char* p) noexcept { 
-            std::free(p); 
-        });
+    /* memory stays bounded by the sink buffer, whatever the document size */
+    return write_file_replacing(filePath, converter.get(), std::ios::out,
+        [this, &html](std::ostream& fout) {
+            if (html2tex_stream(converter.get(), html.c_str(), &ostream_sink, &fout) != 0) {
+                if (hasError()) throw std::runtime_error(getErrorMessage());
 
-    if (!result) {
-        if (hasError()) throw std::runtime_error(getErrorMessage());
-        
-        /* empty but valid conversion */
-        return false;
-    }
-
-    /* write the file */
-    std::ofstream fout(filePath);
-
-    if (!fout)
-        throw std::runtime_error("Cannot open output file.");
+                /* empty but valid conversion */
+                return false;
+            }
 
-    fout << result.get();
-    fout.flush();
+            fout.flush();
 
-    if (!fout)
-        throw std::runtime_error("Failed to write LaTeX output.");
+            if (!fout)
+                throw std::runtime_error("Failed to write LaTeX output.");
 
-    return true;
+            return true;
+        });
 }
 
 std::string HtmlTeXConverter::convert(const HtmlParser& parser) const {
@@ -120,18 +214,12 @@ std::string HtmlTeXConverter::convert(const HtmlParser& parser) const {
     if (!isValid())
         throw std::runtime_error("HtmlTeXConverter in invalid state.");
 
-    /* get HTML content - one serialization only */
-    std::string html = parser.toString();
-
     /* return empty string for empty input */
-    if (html.empty()) return "";
+    if (!parser.hasContent()) return "";
 
-    /* perform conversion */
-    char* raw_result = html2tex_convert(converter.get(), html.c_str());
-
-    /* RAII management with custom deleter */
-    const auto deleter = [](char* p) noexcept { std::free(p); };
-    std::unique_ptr<char[], decltype(deleter)> result_guard(raw_result, deleter);
+    /* convert the parsed tree directly, no serialization round trip */
+    std::size_t result_len = 0;
+    const char* const raw_result = html2tex_convert_dom_view(converter.get(), parser.getHtmlNode(), &result_len);
 
     /* error analysis */
     if (!raw_result) {
@@ -144,8 +232,8 @@ std::string HtmlTeXConverter::convert(const HtmlParser& parser) const {
         return "";
     }
 
-    /* return result (compiler will optimize it) */
-    return std::string(raw_result);
+    /* the only copy made of the output */
+    return std::string(raw_result, result_len);
 }
 
 bool HtmlTeXConverter::convertToFile(const HtmlParser& parser, const std::string& filePath) const {
@@ -157,66 +245,17 @@ bool HtmlTeXConverter::convertToFile(const HtmlParser& parser, const std::string
     if (!parser.hasContent())
         return false;
 
-    /* get serialized HTML - only serialize once */
-    const std::string html = parser.toString();
-
-    /* validate serialized content */
-    if (html.empty())
-        return false;
-
-    /* convert HTML to LaTeX */
-    char* raw_result = html2tex_convert(converter.get(), html.c_str());
-
-    /* RAII with custom deleter */
-    const auto deleter = [](char* p) noexcept {
-        if (p) std::free(p);
-    };
-
-    std::unique_ptr<char[], decltype(deleter)> result_guard(raw_result, deleter);
-
-    /* check for conversion errors */
-    if (!raw_result) {
-        if (hasError()) {
-            throw std::runtime_error(
-                "HTML to LaTeX conversion failed: " + getErrorMessage());
-        }
-
-        /* valid empty conversion */
-        return false;
-    }
-
-    /* check if result is empty */
-    if (raw_result[0] == '\0')
-        return false;
-
-    /* open file with optimal flags */
-    std::ofstream fout;
-
-    /* config stream for maximum performance */
-    fout.rdbuf()->pubsetbuf(nullptr, 0);
-    fout.open(filePath, std::ios::binary | std::ios::trunc);
-
-    if (!fout)
-        throw std::runtime_error("Cannot open output file: " + filePath);
-
-    /* get result length once */
-    const size_t result_len = std::strlen(raw_result);
-
-    /* write entire result in one operation */
-    if (!fout.write(raw_result, static_cast<std::streamsize>(result_len)))
-        throw std::runtime_error("Failed to write LaTeX output to: " + filePath);
-
-    /* explicit flush to ensure data is written */
-    fout.flush();
-
-    /* final check */
-    if (!fout)
-        throw std::runtime_error("Failed to flush LaTeX output to: " + filePath);
-
-    return true;
+    return write_file_replacing(filePath, converter.get(), std::ios::binary,
+        [this, &parser](std::ostream& fout) {
+            return convertToFile(parser, fout);
+        });
 }
 
 bool HtmlTeXConverter::convertToFile(const HtmlParser& parser, std::ofstream& output) const {
+    return convertToFile(parser, static_cast<std::ostream&>(output));
+}
+
+bool HtmlTeXConverter::convertToFile(const HtmlParser& parser, std::ostream& output) const {
     /* fast precondition validation */
     if (!converter || !valid)
         throw std::runtime_error("HtmlTeXConverter: Converter not initialized.");
@@ -225,26 +264,8 @@ bool HtmlTeXConverter::convertToFile(const HtmlParser& parser, std::ofstream& ou
     if (!parser.hasContent())
         return false;
 
-    /* get serialized HTML - only serialize once */
-    const std::string html = parser.toString();
-
-    /* validate serialized content */
-    if (html.empty())
-        return false;
-
-    /* convert HTML to LaTeX */
-    char* raw_result = html2tex_convert(converter.get(), html.c_str());
-
-    /* RAII with custom deleter */
-    const auto deleter = [](char* p) noexcept {
-        /* free handles nullptr */
-        std::free(p);
-    };
-
-    std::unique_ptr<char[], decltype(deleter)> result_guard(raw_result, deleter);
-
-    /* check for conversion errors */
-    if (!raw_result) {
+    /* stream the parsed tree directly, no serialization round trip */
+    if (html2tex_stream_dom(converter.get(), parser.getHtmlNode(), &ostream_sink, &output) != 0) {
         if (hasError()) {
             throw std::runtime_error(
                 std::string("HTML to LaTeX conversion failed: ") + getErrorMessage());
@@ -254,17 +275,6 @@ bool HtmlTeXConverter::convertToFile(const HtmlParser& parser, std::ofstream& ou
         return false;
     }
 
-    /* check if result is empty */
-    if (raw_result[0] == '\0')
-        return false;
-
-    /* get result length once */
-    const std::size_t result_len = std::strlen(raw_result);
-
-    /* write entire result in one operation */
-    if (!output.write(raw_result, static_cast<std::streamsize>(result_len)))
-        throw std::runtime_error("Failed to write LaTeX output to stream.");
-
     /* ensure data is written */
     output.flush();
 
@@ -274,6 +284,44 @@ bool HtmlTeXConverter::convertToFile(const HtmlParser& parser, std::ofstream& ou
     return true;
 }
 
+std::vector<HtmlTeXResult> HtmlTeXConverter::convertBatch(const std::vector<std::string>& documents, 
+    unsigned int threads) const {
+    if (!isValid())
+        throw std::runtime_error("Converter not initialized.");
+
+    std::vector<const char*> html;
+    html.reserve(documents.size());
+
+    for (const std::string& document : documents)
+        html.push_back(document.c_str());
+
+    std::vector<HTML2TeXResult> raw_results(documents.size());
+
+    /* workers copy the image settings of this converter */
+    if (html2tex_convert_batch(converter.get(), html.data(), html.size(), 
+        raw_results.data(), static_cast<int>(threads)) != 0)
+        throw std::runtime_error("Batch conversion could not be started.");
+
+    std::vector<HtmlTeXResult> results;
+    results.reserve(raw_results.size());
+
+    /* add RAII ownership for each malloc'd document */
+    const auto deleter = [](char* p) noexcept { std::free(p); };
+
+    for (HTML2TeXResult& raw : raw_results) {
+        std::unique_ptr<char, decltype(deleter)> output_guard(raw.output, deleter);
+        HtmlTeXResult result;
+
+        result.errorCode = raw.error_code;
+        result.errorMessage = raw.error_message;
+
+        if (raw.output) result.output = raw.output;
+        results.push_back(std::move(result));
+    }
+
+    return results;
+}
+
 bool HtmlTeXConverter::hasError() const {
     return converter && html2tex_get_error(converter.get()) != 0;
 }
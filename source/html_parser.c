@@ -2,7 +2,6 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
 
 #define BUFFER_SIZE 4096
 
@@ -10,53 +9,154 @@ typedef struct {
     const char* input;
     size_t position;
     size_t length;
-} ParserState;
+    HTMLArena* arena;
 
-static void skip_whitespace(ParserState* state) {
-    const char* input = state->input;
-    size_t pos = state->position;
-    const size_t length = state->length;
+    /* in-situ mode: writable alias of input that strings point into */
+    char* insitu;
+    char* pending_nul;
 
-    while (pos < length) {
-        unsigned char c = (unsigned char)input[pos];
-        if (c > ' ' || c == 0) break;
-        pos++;
+    /* push parsing: input up to here is known to hold no markup */
+    size_t scanned;
+} ParserState;
+
+/* ASCII case folding, independent of the C locale. */
+static const unsigned char ascii_lower[256] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F,
+    0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F,
+    ' ', '!', '"', '#', '$', '%', '&', '\'', '(', ')', '*', '+', ',', '-', '.', '/',
+    '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', ':', ';', '<', '=', '>', '?',
+    '@', 'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o',
+    'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y', 'z', '[', '\\', ']', '^', '_',
+    '`', 'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o',
+    'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y', 'z', '{', '|', '}', '~', 0x7F,
+    0x80, 0x81, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8A, 0x8B, 0x8C, 0x8D, 0x8E, 0x8F,
+    0x90, 0x91, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0x9B, 0x9C, 0x9D, 0x9E, 0x9F,
+    0xA0, 0xA1, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xAB, 0xAC, 0xAD, 0xAE, 0xAF,
+    0xB0, 0xB1, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xBB, 0xBC, 0xBD, 0xBE, 0xBF,
+    0xC0, 0xC1, 0xC2, 0xC3, 0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xCB, 0xCC, 0xCD, 0xCE, 0xCF,
+    0xD0, 0xD1, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xDB, 0xDC, 0xDD, 0xDE, 0xDF,
+    0xE0, 0xE1, 0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xEB, 0xEC, 0xED, 0xEE, 0xEF,
+    0xF0, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8, 0xF9, 0xFA, 0xFB, 0xFC, 0xFD, 0xFE, 0xFF
+};
+
+/* Bytes that may appear in tag and attribute names: ASCII letters, digits and '-'. */
+static const unsigned char name_bytes[256] = {
+    ['-'] = 1,
+    ['0'] = 1,['1'] = 1,['2'] = 1,['3'] = 1,['4'] = 1,['5'] = 1,['6'] = 1,['7'] = 1,['8'] = 1,['9'] = 1,
+    ['A'] = 1,['B'] = 1,['C'] = 1,['D'] = 1,['E'] = 1,['F'] = 1,['G'] = 1,['H'] = 1,['I'] = 1,
+    ['J'] = 1,['K'] = 1,['L'] = 1,['M'] = 1,['N'] = 1,['O'] = 1,['P'] = 1,['Q'] = 1,['R'] = 1,
+    ['S'] = 1,['T'] = 1,['U'] = 1,['V'] = 1,['W'] = 1,['X'] = 1,['Y'] = 1,['Z'] = 1,
+    ['a'] = 1,['b'] = 1,['c'] = 1,['d'] = 1,['e'] = 1,['f'] = 1,['g'] = 1,['h'] = 1,['i'] = 1,
+    ['j'] = 1,['k'] = 1,['l'] = 1,['m'] = 1,['n'] = 1,['o'] = 1,['p'] = 1,['q'] = 1,['r'] = 1,
+    ['s'] = 1,['t'] = 1,['u'] = 1,['v'] = 1,['w'] = 1,['x'] = 1,['y'] = 1,['z'] = 1
+};
+
+/* Common attribute names shared by every arena document instead of being copied. */
+static const char* const interned_keys[] = {
+    "align", "alt", "bgcolor", "border", "cellpadding", "cellspacing",
+    "charset", "class", "color", "colspan", "content", "face", "height",
+    "href", "id", "lang", "name", "rel", "rowspan", "size", "src", "style",
+    "title", "type", "valign", "width", NULL
+};
+
+/* Returns the interned copy of a name, matched case-insensitively. */
+static const char* intern_name(const char* const* table, const char* name, size_t length) {
+    const char first = (char)ascii_lower[(unsigned char)name[0]];
+
+    for (; *table; table++) {
+        const char* entry = *table;
+
+        if (entry[0] == first && strncasecmp(entry, name, length) == 0 && entry[length] == '\0')
+            return entry;
     }
 
-    state->position = pos;
+    return NULL;
 }
 
-static char* parse_tag_name(ParserState* state) {
+/* Allocates parser memory from the document arena when one is in use. */
+static void* parser_alloc(ParserState* state, size_t size) {
+    return state->arena ? html2tex_arena_alloc(state->arena, size) : malloc(size);
+}
+
+/* Copies length bytes of src into a new null-terminated string. */
+static char* parser_strndup(ParserState* state, const char* src, size_t length) {
+    if (state->arena)
+        return html2tex_arena_strndup(state->arena, src, length);
+
+    char* str = (char*)malloc(length + 1);
+    if (!str) return NULL;
+
+    if (length > 0) memcpy(str, src, length);
+    str[length] = '\0';
+    return str;
+}
+
+/* Arena memory is only released together with the whole document. */
+static void parser_free(ParserState* state, void* ptr) {
+    if (!state->arena) free(ptr);
+}
+
+/* Allocates an empty node owned by the parser's allocator. */
+static HTMLNode* parser_new_node(ParserState* state) {
+    HTMLNode* node = (HTMLNode*)parser_alloc(state, sizeof(HTMLNode));
+    if (!node) return NULL;
+
+    node->tag = NULL;
+    node->content = NULL;
+    node->attributes = NULL;
+    node->children = NULL;
+    node->next = NULL;
+    node->parent = NULL;
+    node->flags = state->arena ? HTML2TEX_NODE_ARENA : 0;
+    node->tag_id = HTML2TEX_TAG_UNKNOWN;
+
+    return node;
+}
+
+/* Propagates the nested-table flags of a freshly linked child to its parent. */
+static void link_child_flags(HTMLNode* parent, const HTMLNode* child) {
+    if ((child->flags & HTML2TEX_NODE_HAS_TABLE) || child->tag_id == HTML2TEX_TAG_TABLE)
+        parent->flags |= HTML2TEX_NODE_HAS_TABLE;
+}
+
+/* Skips a tag or attribute name and returns its length, 0 if there is none. */
+static size_t scan_name(ParserState* state) {
     const char* const input = state->input;
     const size_t length = state->length;
 
     size_t pos = state->position;
-    if (pos >= length) return NULL;
+    const size_t start = pos;
 
-    /* find end of tag name */
-    size_t start = pos;
-
-    while (pos < length) {
-        unsigned char c = (unsigned char)input[pos];
-        if (!(isalnum(c) || c == '-')) break;
+    while (pos < length && name_bytes[(unsigned char)input[pos]])
         pos++;
-    }
 
-    if (pos == start) return NULL;
-    size_t tag_len = pos - start;
+    state->position = pos;
+    return pos - start;
+}
 
-    char* name = (char*)malloc(tag_len + 1);
-    if (!name) return NULL;
+/* Resolves a raw element name case-insensitively to its tag identifier. */
+static int lookup_tag(const char* name, size_t length) {
+    char lower[16];
+    if (length >= sizeof(lower)) return HTML2TEX_TAG_UNKNOWN;
 
-    /* copy and lowercase */
-    const char* src = input + start;
-    char* dest = name;
+    for (size_t i = 0; i < length; i++)
+        lower[i] = (char)ascii_lower[(unsigned char)name[i]];
 
-    for (size_t i = 0; i < tag_len; i++)
-        dest[i] = (char)tolower((unsigned char)src[i]);
+    return html2tex_tag_lookup(lower, length);
+}
 
-    dest[tag_len] = '\0';
-    state->position = pos;
+/* Returns a lowercase name for the slice at start; with in_place set the
+   caller terminates the in-situ buffer at start + length itself. */
+static char* store_name(ParserState* state, size_t start, size_t length, int in_place) {
+    const char* src = state->input + start;
+    char* name = (in_place && state->insitu) ? state->insitu + start
+        : parser_strndup(state, src, length);
+
+    if (!name) return NULL;
+
+    /* lowercase in place */
+    for (size_t i = 0; i < length; i++)
+        name[i] = (char)ascii_lower[(unsigned char)name[i]];
 
     return name;
 }
@@ -83,18 +183,19 @@ static char* parse_quoted_string(ParserState* state) {
     /* validate we found the quote */
     if (pos >= length) return NULL;
 
-    /* allocate and copy */
-    const size_t str_len = pos - start;
-    char* str = (char*)malloc(str_len + 1);
+    char* str;
 
-    if (str) {
-        if (str_len > 0)
-            memcpy(str, input + start, str_len);
-        
-        /* skip closing quote */
-        str[str_len] = '\0';
-        state->position = pos + 1;
+    /* the closing quote becomes the terminator of an in-situ value */
+    if (state->insitu) {
+        str = state->insitu + start;
+        state->insitu[pos] = '\0';
     }
+    else
+        str = parser_strndup(state, input + start, pos - start);
+
+    /* skip closing quote */
+    if (str)
+        state->position = pos + 1;
 
     return str;
 }
@@ -121,11 +222,24 @@ static HTMLAttribute* parse_attributes(ParserState* state) {
 
         /* parse key */
         state->position = pos;
-        char* key = parse_tag_name(state);
+        const size_t key_start = pos;
+        const size_t key_len = scan_name(state);
 
-        if (!key) break;
+        if (key_len == 0) break;
         pos = state->position;
 
+        /* an in-situ key can end at its delimiter once that has been consumed */
+        const char delimiter = pos < length ? input[pos] : '\0';
+        const int in_place = delimiter == '=' || (delimiter > '\0' && delimiter <= ' ');
+
+        /* arena documents share common keys */
+        char* key = state->arena ? (char*)intern_name(interned_keys, input + key_start, key_len) : NULL;
+
+        if (!key)
+            key = store_name(state, key_start, key_len, in_place);
+
+        if (!key) break;
+
         /* skip whitespace after key */
         while (pos < length) {
             c = (unsigned char)input[pos];
@@ -150,7 +264,7 @@ static HTMLAttribute* parse_attributes(ParserState* state) {
 
             /* cleanup on parse failure */
             if (!value) {
-                free(key);
+                parser_free(state, key);
                 break;
             }
 
@@ -158,14 +272,17 @@ static HTMLAttribute* parse_attributes(ParserState* state) {
         }
 
         /* allocate and link attribute */
-        HTMLAttribute* attr = (HTMLAttribute*)malloc(sizeof(HTMLAttribute));
+        HTMLAttribute* attr = (HTMLAttribute*)parser_alloc(state, sizeof(HTMLAttribute));
 
         if (!attr) {
-            free(key);
-            if (value) free(value);
+            parser_free(state, key);
+            if (value) parser_free(state, value);
             break;
         }
 
+        if (in_place && key == state->insitu + key_start)
+            state->insitu[key_start + key_len] = '\0';
+
         attr->key = key;
         attr->value = value;
         attr->next = NULL;
@@ -178,79 +295,72 @@ static HTMLAttribute* parse_attributes(ParserState* state) {
     return head;
 }
 
-static char* parse_text_content(ParserState* state) {
-    const char* input = state->input;
-    size_t pos = state->position;
-    const size_t length = state->length;
-    const char* start_ptr = input + pos;
-    const char* current = start_ptr;
+/* Reports whether the byte after a '<' makes it markup rather than text. */
+static int opens_markup(unsigned char c) {
+    return (unsigned int)(ascii_lower[c] - 'a') < 26u || c == '/' || c == '!' || c == '?';
+}
+
+/* Returns the position of the next '<' that starts markup, or length. Unless
+   the input is finished, a trailing '<' is returned too: the next byte decides it. */
+static size_t find_markup(const char* input, size_t pos, size_t length, int finished) {
     const char* const end = input + length;
+    const char* current = input + pos;
 
-    /* scan for tag beginning */
-    while (current < end && *current != '<')
+    /* memchr is already vectorized by the C library */
+    while ((current = (const char*)memchr(current, '<', (size_t)(end - current))) != NULL) {
+        if (current + 1 == end) return finished ? length : length - 1;
+        if (opens_markup((unsigned char)current[1])) return (size_t)(current - input);
         current++;
+    }
 
-    size_t text_len = (size_t)(current - start_ptr);
-    if (text_len == 0) return NULL;
+    return length;
+}
 
-    char* text = (char*)malloc(text_len + 1);
-    if (!text) return NULL;
+/* Returns the text from the current position up to end, where the next markup starts. */
+static char* parse_text_content(ParserState* state, size_t end) {
+    const size_t pos = state->position;
+    const size_t text_len = end - pos;
+    char* text;
+
+    if (state->insitu && end < state->length) {
+        /* the '<' is still needed, so terminate it once the parser has moved on */
+        if (state->pending_nul) *state->pending_nul = '\0';
+        state->pending_nul = state->insitu + end;
+        text = state->insitu + pos;
+    }
+    else
+        text = parser_strndup(state, state->input + pos, text_len);
 
-    memcpy(text, start_ptr, text_len);
-    text[text_len] = '\0';
+    if (!text) return NULL;
 
-    state->position = (size_t)(current - input);
+    state->position = end;
     return text;
 }
 
-static HTMLNode* parse_element(ParserState* state);
-
-static HTMLNode* parse_node(ParserState* state) {
-    /* quick bounds check */
-    if (state->position >= state->length) return NULL;
-
-    /* element node */
-    if (state->input[state->position] == '<')
-        return parse_element(state);
-
-    /* text node */
-    HTMLNode* node = (HTMLNode*)malloc(sizeof(HTMLNode));
-    if (!node) return NULL;
-
-    /* initialize all fields */
-    node->tag = NULL;
-    node->content = parse_text_content(state);
-    node->attributes = NULL;
-    node->children = NULL;
-    node->next = NULL;
-    node->parent = NULL;
-
-    return node;
-}
+/* Parses a start tag whose '<' has been read; has_children reports whether
+   the element takes content, which is left to the caller. */
+static HTMLNode* parse_start_tag(ParserState* state, int* has_children) {
+    const size_t tag_start = state->position;
+    const size_t tag_len = scan_name(state);
+    if (tag_len == 0) return NULL;
 
-static HTMLNode* parse_element(ParserState* state) {
-    if (state->input[state->position] != '<') return NULL;
-    state->position++;
+    /* whitespace after an in-situ tag name can hold its terminator */
+    const char delimiter = tag_start + tag_len < state->length ? state->input[tag_start + tag_len] : '\0';
+    const int in_place = delimiter > '\0' && delimiter <= ' ';
 
-    /* check for closing tag */
-    if (state->position < state->length && state->input[state->position] == '/') {
-        state->position++;
-        char* tag_name = parse_tag_name(state);
-        skip_whitespace(state);
+    const int tag_id = lookup_tag(state->input + tag_start, tag_len);
 
-        if (state->position < state->length && state->input[state->position] == '>')
-            state->position++;
+    /* arena documents point known names at the shared tag table */
+    char* tag_name = (state->arena && tag_id != HTML2TEX_TAG_UNKNOWN)
+        ? (char*)html2tex_tag_name(tag_id)
+        : store_name(state, tag_start, tag_len, in_place);
 
-        /* closing tags do not create nodes */
-        if (tag_name) free(tag_name);
-        return NULL;
-    }
-
-    /* parse opening tag */
-    char* tag_name = parse_tag_name(state);
     if (!tag_name) return NULL;
     HTMLAttribute* attributes = parse_attributes(state);
 
+    if (in_place && tag_name == state->insitu + tag_start)
+        state->insitu[tag_start + tag_len] = '\0';
+
     /* check for self-closing tag */
     int self_closing = 0;
 
@@ -262,16 +372,16 @@ static HTMLNode* parse_element(ParserState* state) {
     if (state->position < state->length && state->input[state->position] == '>')
         state->position++;
 
-    HTMLNode* node = (HTMLNode*)malloc(sizeof(HTMLNode));
+    HTMLNode* node = parser_new_node(state);
 
     if (!node) {
-        free(tag_name);
+        parser_free(state, tag_name);
 
         while (attributes) {
             HTMLAttribute* next = attributes->next;
-            free(attributes->key);
-            if (attributes->value) free(attributes->value);
-            free(attributes);
+            parser_free(state, attributes->key);
+            if (attributes->value) parser_free(state, attributes->value);
+            parser_free(state, attributes);
             attributes = next;
         }
 
@@ -279,313 +389,839 @@ static HTMLNode* parse_element(ParserState* state) {
     }
 
     node->tag = tag_name;
-    node->content = NULL;
+    node->tag_id = tag_id;
     node->attributes = attributes;
-    node->children = NULL;
-    node->next = NULL;
-    node->parent = NULL;
 
-    /* parse children if not self-closing and not a void element */
-    if (!self_closing) {
-        /* HTML void element list */
-        static const char* const void_elements[] = {
-            "area", "base", "br", "col", "embed", "hr", "img",
-            "input", "link", "meta", "param", "source", "track", "wbr", NULL
-        };
-
-        int is_void_element = 0;
-        for (int i = 0; void_elements[i]; i++) {
-            if (strcmp(tag_name, void_elements[i]) == 0) {
-                is_void_element = 1;
-                break;
-            }
-        }
+    /* self-closing and void elements have no children */
+    *has_children = !self_closing && !(html2tex_tag_flags(tag_id) & HTML2TEX_TAG_IS_VOID);
+    return node;
+}
 
-        if (!is_void_element) {
-            /* cache frequently accessed values */
-            HTMLNode** current_child = &node->children;
-            const char* input = state->input;
-
-            size_t* pos = &state->position;
-            const size_t length = state->length;
-
-            while (*pos < length) {
-                /* optimized whitespace skipping inline */
-                size_t saved_pos = *pos;
-
-                while (*pos < length && (unsigned char)input[*pos] <= ' ' && input[*pos])
-                    (*pos)++;
-
-                /* check for closing tag */
-                if (*pos < length - 1 && input[*pos] == '<' && input[*pos + 1] == '/') {
-                    /* found potential closing tag */
-                    size_t check_pos = *pos;
-
-                    /* skip whitespace before checking tag name */
-                    while (check_pos < length && (unsigned char)input[check_pos] <= ' ' && input[check_pos])
-                        check_pos++;
-
-                    /* if we still have the closing tag after skipping whitespace */
-                    if (check_pos < length - 1 && input[check_pos] == '<' && input[check_pos + 1] == '/') {
-                        size_t parse_pos = check_pos + 2;
-
-                        /* parse closing tag name */
-                        char* closing_tag = NULL;
-
-                        if (parse_pos < length) {
-                            size_t start = parse_pos;
-
-                            while (parse_pos < length &&
-                                (isalnum((unsigned char)input[parse_pos]) || input[parse_pos] == '-')) {
-                                parse_pos++;
-                            }
-                            if (parse_pos > start) {
-                                size_t tag_len = parse_pos - start;
-                                closing_tag = (char*)malloc(tag_len + 1);
-
-                                if (closing_tag) {
-                                    for (size_t i = 0; i < tag_len; i++)
-                                        closing_tag[i] = (char)tolower((unsigned char)input[start + i]);
-
-                                    closing_tag[tag_len] = '\0';
-                                }
-                            }
-                        }
-
-                        /* skip whitespace after tag name */
-                        while (parse_pos < length && (unsigned char)input[parse_pos] <= ' ' && input[parse_pos])
-                            parse_pos++;
-
-                        /* only break if this is the correct closing tag */
-                        if (closing_tag && strcmp(closing_tag, tag_name) == 0) {
-                            if (parse_pos < length && input[parse_pos] == '>') {
-                                free(closing_tag);
-                                *pos = parse_pos + 1;
-                                break;
-                            }
-                        }
-
-                        if (closing_tag) free(closing_tag);
-                        *pos = saved_pos;
-                    }
-                    else
-                        /* the whitespace was actually text content */
-                        *pos = saved_pos;
-                }
-
-                /* parse child node */
-                HTMLNode* child = parse_node(state);
-
-                if (child) {
-                    child->parent = node;
-                    *current_child = child;
-                    current_child = &child->next;
-                }
-                else
-                    /* if no child was parsed, we might be at the end */
-                    break;
-            }
-        }
+static size_t skip_space_at(const char* input, size_t pos, size_t length) {
+    while (pos < length && (unsigned char)input[pos] <= ' ' && input[pos])
+        pos++;
+
+    return pos;
+}
+
+static size_t skip_name_at(const char* input, size_t pos, size_t length) {
+    while (pos < length && name_bytes[(unsigned char)input[pos]])
+        pos++;
+
+    return pos;
+}
+
+/* An element still waiting for its end tag, with the tail of its child list
+   and the link that holds it in the list of its parent. */
+typedef struct {
+    HTMLNode* node;
+    HTMLNode** tail;
+    HTMLNode** link;
+} OpenElement;
+
+/* Open elements, the document root first. Past max_depth elements are still
+   tracked for their end tags, but like in browsers their content goes to the
+   deepest element within the limit, so the tree depth stays bounded. */
+typedef struct {
+    OpenElement* open;
+    size_t depth;
+    size_t capacity;
+    size_t max_depth;
+
+    /* HTML2TEX_PARSE_MINIFY, and the open elements that keep their whitespace */
+    int minify;
+    size_t preformatted;
+
+    /* open elements by tag_id, the root aside, so recovery skips hopeless searches */
+    size_t open_tags[HTML2TEX_TAG_COUNT];
+} OpenStack;
+
+/* Returns the open element that receives new nodes. */
+static OpenElement* open_host(OpenStack* stack) {
+    const size_t top = stack->depth - 1;
+    return (stack->max_depth && top > stack->max_depth) ? &stack->open[stack->max_depth] : &stack->open[top];
+}
+
+/* Links a node under the element that receives new nodes, returning the
+   link that holds it; the flags of an element are linked once it closes. */
+static HTMLNode** open_append(OpenStack* stack, HTMLNode* node) {
+    OpenElement* host = open_host(stack);
+    HTMLNode** link = host->tail;
+
+    /* top-level nodes keep a NULL parent */
+    if (host != stack->open) node->parent = host->node;
+
+    *link = node;
+    host->tail = &node->next;
+    return link;
+}
+
+static int open_push(OpenStack* stack, HTMLNode* node, HTMLNode** link) {
+    if (stack->depth == stack->capacity) {
+        size_t capacity = stack->capacity ? stack->capacity * 2 : 32;
+        OpenElement* open = (OpenElement*)realloc(stack->open, capacity * sizeof(OpenElement));
+
+        if (!open) return -1;
+        stack->open = open;
+        stack->capacity = capacity;
     }
 
-    return node;
+    if (stack->depth > 0) stack->open_tags[node->tag_id]++;
+    if (html2tex_tag_flags(node->tag_id) & HTML2TEX_TAG_IS_PRESERVE_WS) stack->preformatted++;
+
+    stack->open[stack->depth].node = node;
+    stack->open[stack->depth].tail = &node->children;
+    stack->open[stack->depth].link = link;
+    stack->depth++;
+    return 0;
+}
+
+/* Closes the innermost element, its subtree is complete now. */
+static void open_pop(OpenStack* stack) {
+    const OpenElement* element = &stack->open[--stack->depth];
+    HTMLNode* node = element->node;
+
+    stack->open_tags[node->tag_id]--;
+    if (html2tex_tag_flags(node->tag_id) & HTML2TEX_TAG_IS_PRESERVE_WS) stack->preformatted--;
+
+    OpenElement* host = open_host(stack);
+
+    /* minified documents drop elements left empty, which are the last node of their host */
+    if (stack->minify && !node->children && host->tail == &node->next &&
+        !(html2tex_tag_flags(node->tag_id) & HTML2TEX_TAG_IS_ESSENTIAL)) {
+        *element->link = NULL;
+        host->tail = element->link;
+        html2tex_free_node(node);
+        return;
+    }
+
+    /* a table with a table below it is skipped during conversion */
+    if ((node->flags & HTML2TEX_NODE_HAS_TABLE) && node->tag_id == HTML2TEX_TAG_TABLE)
+        node->flags |= HTML2TEX_NODE_NESTED_TABLE;
+
+    link_child_flags(host->node, node);
+}
+
+/* Reports whether an end tag with the name at input + name closes element. */
+static int closes_element(const char* input, size_t name, size_t name_len, const HTMLNode* element) {
+    return name_len > 0 && strncasecmp(input + name, element->tag, name_len) == 0 &&
+        element->tag[name_len] == '\0';
+}
+
+/* Closes the open elements down to the one at index, which is closed too. */
+static void open_pop_to(OpenStack* stack, size_t index) {
+    while (stack->depth > index)
+        open_pop(stack);
+}
+
+static int is_table_part(int tag_id) {
+    switch (tag_id) {
+    case HTML2TEX_TAG_CAPTION: case HTML2TEX_TAG_TABLE: case HTML2TEX_TAG_TBODY:
+    case HTML2TEX_TAG_TD: case HTML2TEX_TAG_TFOOT: case HTML2TEX_TAG_TH:
+    case HTML2TEX_TAG_THEAD: case HTML2TEX_TAG_TR:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/* Elements that end tags do not reach through, as in the HTML5 element scope;
+   table parts only stop at the table that holds them. */
+static int is_scope_boundary(int tag_id, int table_scope) {
+    switch (tag_id) {
+    case HTML2TEX_TAG_TABLE: case HTML2TEX_TAG_TEMPLATE:
+        return 1;
+    case HTML2TEX_TAG_CAPTION: case HTML2TEX_TAG_OBJECT:
+    case HTML2TEX_TAG_TD: case HTML2TEX_TAG_TH:
+        return !table_scope;
+    default:
+        return 0;
+    }
+}
+
+/* Returns the index of the open element an end tag closes, 0 when it closes
+   none; such stray end tags are ignored like browsers do. */
+static size_t open_find(const OpenStack* stack, const char* input, size_t name, size_t name_len) {
+    const int tag_id = lookup_tag(input + name, name_len);
+    const int table_scope = is_table_part(tag_id);
+
+    if (stack->open_tags[tag_id] == 0) return 0;
+
+    for (size_t i = stack->depth - 1; i > 0; i--) {
+        const HTMLNode* element = stack->open[i].node;
+
+        if (closes_element(input, name, name_len, element)) return i;
+        if (is_scope_boundary(element->tag_id, table_scope)) break;
+    }
+
+    return 0;
+}
+
+/* Start tags that end an open paragraph. */
+static int closes_paragraph(int tag_id) {
+    switch (tag_id) {
+    case HTML2TEX_TAG_ADDRESS: case HTML2TEX_TAG_ARTICLE: case HTML2TEX_TAG_ASIDE:
+    case HTML2TEX_TAG_BLOCKQUOTE: case HTML2TEX_TAG_CENTER: case HTML2TEX_TAG_DD:
+    case HTML2TEX_TAG_DIV: case HTML2TEX_TAG_DL: case HTML2TEX_TAG_DT:
+    case HTML2TEX_TAG_FIGCAPTION: case HTML2TEX_TAG_FIGURE: case HTML2TEX_TAG_FOOTER:
+    case HTML2TEX_TAG_FORM: case HTML2TEX_TAG_H1: case HTML2TEX_TAG_H2:
+    case HTML2TEX_TAG_H3: case HTML2TEX_TAG_H4: case HTML2TEX_TAG_H5:
+    case HTML2TEX_TAG_H6: case HTML2TEX_TAG_HEADER: case HTML2TEX_TAG_HR:
+    case HTML2TEX_TAG_LI: case HTML2TEX_TAG_MAIN: case HTML2TEX_TAG_NAV:
+    case HTML2TEX_TAG_OL: case HTML2TEX_TAG_P: case HTML2TEX_TAG_PRE:
+    case HTML2TEX_TAG_SEARCH: case HTML2TEX_TAG_SECTION: case HTML2TEX_TAG_TABLE:
+    case HTML2TEX_TAG_UL:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/* Reports whether the start tag tag_id ends an open element open_id of the same kind. */
+static int ends_sibling(int tag_id, int open_id) {
+    switch (tag_id) {
+    case HTML2TEX_TAG_DD: case HTML2TEX_TAG_DT:
+        return open_id == HTML2TEX_TAG_DD || open_id == HTML2TEX_TAG_DT;
+    case HTML2TEX_TAG_TD: case HTML2TEX_TAG_TH:
+        return open_id == HTML2TEX_TAG_TD || open_id == HTML2TEX_TAG_TH;
+    case HTML2TEX_TAG_TBODY: case HTML2TEX_TAG_TFOOT: case HTML2TEX_TAG_THEAD:
+        return open_id == HTML2TEX_TAG_TBODY || open_id == HTML2TEX_TAG_TFOOT || open_id == HTML2TEX_TAG_THEAD;
+    case HTML2TEX_TAG_LI: case HTML2TEX_TAG_OPTION: case HTML2TEX_TAG_TR:
+        return open_id == tag_id;
+    default:
+        return 0;
+    }
+}
+
+/* Reports whether open_id holds the siblings of tag_id, so the search for one stops there. */
+static int holds_siblings(int tag_id, int open_id) {
+    switch (tag_id) {
+    case HTML2TEX_TAG_LI:
+        return open_id == HTML2TEX_TAG_UL || open_id == HTML2TEX_TAG_OL;
+    case HTML2TEX_TAG_DD: case HTML2TEX_TAG_DT:
+        return open_id == HTML2TEX_TAG_DL;
+    case HTML2TEX_TAG_OPTION:
+        return open_id == HTML2TEX_TAG_SELECT;
+    case HTML2TEX_TAG_TR:
+        return open_id == HTML2TEX_TAG_TBODY || open_id == HTML2TEX_TAG_TFOOT || open_id == HTML2TEX_TAG_THEAD;
+    case HTML2TEX_TAG_TD: case HTML2TEX_TAG_TH:
+        return open_id == HTML2TEX_TAG_TR;
+    default:
+        return 0;
+    }
+}
+
+/* Counts the open elements the start tag tag_id could end as siblings. */
+static size_t open_siblings(const OpenStack* stack, int tag_id) {
+    const size_t* const open = stack->open_tags;
+
+    switch (tag_id) {
+    case HTML2TEX_TAG_DD: case HTML2TEX_TAG_DT:
+        return open[HTML2TEX_TAG_DD] + open[HTML2TEX_TAG_DT];
+    case HTML2TEX_TAG_TD: case HTML2TEX_TAG_TH:
+        return open[HTML2TEX_TAG_TD] + open[HTML2TEX_TAG_TH];
+    case HTML2TEX_TAG_TBODY: case HTML2TEX_TAG_TFOOT: case HTML2TEX_TAG_THEAD:
+        return open[HTML2TEX_TAG_TBODY] + open[HTML2TEX_TAG_TFOOT] + open[HTML2TEX_TAG_THEAD];
+    case HTML2TEX_TAG_LI: case HTML2TEX_TAG_OPTION: case HTML2TEX_TAG_TR:
+        return open[tag_id];
+    default:
+        return 0;
+    }
+}
+
+/* Searches the open elements for a sibling the start tag tag_id ends, or with
+   siblings unset for a paragraph it ends. Returns its index, or 0. */
+static size_t open_find_implied(const OpenStack* stack, int tag_id, int siblings) {
+    const int table_scope = siblings && is_table_part(tag_id);
+
+    if (!(siblings ? open_siblings(stack, tag_id) : stack->open_tags[HTML2TEX_TAG_P]))
+        return 0;
+
+    for (size_t i = stack->depth - 1; i > 0; i--) {
+        const int open_id = stack->open[i].node->tag_id;
+
+        if (siblings ? ends_sibling(tag_id, open_id) : open_id == HTML2TEX_TAG_P) return i;
+        if (is_scope_boundary(open_id, table_scope) || (siblings && holds_siblings(tag_id, open_id))) break;
+    }
+
+    return 0;
+}
+
+/* Returns the index of the open element a start tag ends implicitly, as a
+   new list item ends the previous one, or 0 when it ends none. */
+static size_t implied_end(const OpenStack* stack, int tag_id) {
+    size_t index = open_find_implied(stack, tag_id, 1);
+
+    if (closes_paragraph(tag_id)) {
+        const size_t paragraph = open_find_implied(stack, tag_id, 0);
+        if (paragraph && (!index || paragraph < index)) index = paragraph;
+    }
+
+    return index;
 }
 
 HTMLNode* html2tex_parse(const char* html) {
     if (!html) return NULL;
+    return html2tex_parse_ex(html, strlen(html), 0);
+}
+
+/* Reports whether the start tag at pos ends inside the buffered input,
+   following the same rules as parse_start_tag. */
+static int start_tag_complete(const char* input, size_t pos, size_t length) {
+    pos = skip_name_at(input, pos + 1, length);
+
+    for (;;) {
+        pos = skip_space_at(input, pos, length);
+        if (pos >= length) return 0;
+        if (input[pos] == '>' || input[pos] == '/') break;
+
+        const size_t key_end = skip_name_at(input, pos, length);
+        if (key_end >= length) return 0;
+
+        /* attribute parsing stops at anything that is not a name */
+        if (key_end == pos) return 1;
+        pos = skip_space_at(input, key_end, length);
+
+        if (pos >= length) return 0;
+        if (input[pos] != '=') continue;
+
+        pos = skip_space_at(input, pos + 1, length);
+        if (pos >= length) return 0;
+
+        /* unquoted values end the attribute list as well */
+        const char quote = input[pos];
+        if (quote != '"' && quote != '\'') return 1;
+
+        const char* close = (const char*)memchr(input + pos + 1, quote, length - pos - 1);
+        if (!close) return 0;
+        pos = (size_t)(close - input) + 1;
+    }
+
+    /* a '/' still needs to know whether '>' follows */
+    if (input[pos] == '/') pos++;
+    return pos < length;
+}
+
+/* Returns the position after the comment, declaration or processing
+   instruction at pos, or 0 when the input ends inside it. */
+static size_t skip_markup_declaration(const char* input, size_t pos, size_t length) {
+    const char* const end = input + length;
+
+    if (length - pos >= 4 && memcmp(input + pos, "<!--", 4) == 0) {
+        const char* current = input + pos + 4;
+
+        while (end - current >= 3 && (current = (const char*)memchr(current, '-', (size_t)(end - current - 2))) != NULL) {
+            if (current[1] == '-' && current[2] == '>') return (size_t)(current - input) + 3;
+            current++;
+        }
+
+        return 0;
+    }
+
+    const char* close = (const char*)memchr(input + pos + 2, '>', length - pos - 2);
+    return close ? (size_t)(close - input) + 1 : 0;
+}
+
+/* An end tag read ahead: where it ends and the open element it closes. */
+typedef struct {
+    size_t end;
+    size_t target;
+} EndTag;
+
+/* Reads the end tag at pos without consuming it. Returns 0 when the input
+   ends inside the tag and more may follow. */
+static int read_end_tag(const char* input, size_t pos, size_t length, int finished,
+    const OpenStack* stack, EndTag* tag) {
+    const size_t name = pos + 2;
+    const size_t name_end = skip_name_at(input, name, length);
+    const char* close = (const char*)memchr(input + name_end, '>', length - name_end);
+
+    if (!close && !finished) return 0;
+
+    tag->end = close ? (size_t)(close - input) + 1 : length;
+    tag->target = open_find(stack, input, name, name_end - name);
+    return 1;
+}
+
+/* Adds the text up to end as a node of the innermost element. */
+static int append_text(ParserState* state, OpenStack* stack, size_t end) {
+    HTMLNode* node = parser_new_node(state);
+    if (!node) return 0;
+
+    const size_t length = end - state->position;
+    node->content = parse_text_content(state, end);
+
+    if (!node->content) {
+        parser_free(state, node);
+        return 0;
+    }
+
+    /* minified text is collapsed where it lies, blank text is dropped */
+    if (stack->minify && !stack->preformatted &&
+        html2tex_collapse_space(node->content, length) == 0) {
+        parser_free(state, node->content);
+        parser_free(state, node);
+        return 1;
+    }
+
+    open_append(stack, node);
+    return 1;
+}
+
+/* Turns the next token into nodes, in one forward pass: end tags are matched
+   against the open elements in place and malformed markup is recovered from
+   like HTML5 does, without rescanning. Returns 1 on progress, 0 when more
+   input is needed and -1 on allocation failure; with finished set the
+   buffered input is all there is. */
+static int parse_step(ParserState* state, OpenStack* stack, int finished) {
+    const char* const input = state->input;
+    const size_t length = state->length;
+    size_t pos = state->position;
+    EndTag end_tag;
+    int has_end_tag = 0;
+
+    if (pos >= length) return 0;
+
+    if (stack->depth > 1) {
+        /* inside elements whitespace is only kept before a foreign end tag */
+        const size_t check = skip_space_at(input, pos, length);
+        if (!finished && check + 1 >= length) return 0;
+
+        if (check + 1 < length && input[check] == '<' && input[check + 1] == '/') {
+            if (!read_end_tag(input, check, length, finished, stack, &end_tag)) return 0;
+            has_end_tag = 1;
+
+            if (check > pos && end_tag.target != stack->depth - 1 && !append_text(state, stack, check))
+                return -1;
+        }
+
+        pos = check;
+
+        if (pos >= length) {
+            state->position = pos;
+            return 1;
+        }
+    }
+
+    if (!has_end_tag && input[pos] == '<' && pos + 1 < length && input[pos + 1] == '/') {
+        if (!read_end_tag(input, pos, length, finished, stack, &end_tag)) return 0;
+        has_end_tag = 1;
+    }
+
+    /* the end tag closes everything opened after its element, stray ones are dropped */
+    if (has_end_tag) {
+        if (end_tag.target) open_pop_to(stack, end_tag.target);
+        state->position = end_tag.end;
+        return 1;
+    }
+
+    if (input[pos] == '<' && pos + 1 < length && (input[pos + 1] == '!' || input[pos + 1] == '?')) {
+        const size_t end = skip_markup_declaration(input, pos, length);
+
+        if (end == 0 && !finished) return 0;
+        state->position = end ? end : length;
+        return 1;
+    }
+
+    if (input[pos] == '<' && pos + 1 < length && opens_markup((unsigned char)input[pos + 1])) {
+        if (!finished && !start_tag_complete(input, pos, length)) return 0;
+        int has_children;
+
+        state->position = pos + 1;
+        HTMLNode* node = parse_start_tag(state, &has_children);
+        if (!node) return -1;
+
+        /* a new list item ends the previous one, a block ends the paragraph */
+        const size_t implied = implied_end(stack, node->tag_id);
+        if (implied) open_pop_to(stack, implied);
+
+        /* a childless element is complete, unless minified it is empty */
+        if (!has_children && stack->minify &&
+            !(html2tex_tag_flags(node->tag_id) & (HTML2TEX_TAG_IS_VOID | HTML2TEX_TAG_IS_ESSENTIAL))) {
+            html2tex_free_node(node);
+            return 1;
+        }
+
+        HTMLNode** link = open_append(stack, node);
+        if (has_children) return open_push(stack, node, link) == 0 ? 1 : -1;
+
+        link_child_flags(open_host(stack)->node, node);
+        return 1;
+    }
+
+    if (!finished && pos + 1 >= length) return 0;
+
+    /* text runs up to the next markup, a '<' that starts none is text as well */
+    size_t from = input[pos] == '<' ? pos + 1 : pos;
+    if (state->scanned > from) from = state->scanned;
+
+    const size_t end = find_markup(input, from, length, finished);
+
+    if (!finished && end + 1 >= length) {
+        state->scanned = end;
+        return 0;
+    }
+
+    state->position = pos;
+    return append_text(state, stack, end) ? 1 : -1;
+}
+
+/* Builds the document tree; in-situ parsing always uses an arena. Open elements
+   are kept on an explicit stack, so the C stack does not grow with the nesting. */
+static HTMLNode* parse_document(const char* html, char* insitu, size_t length, int options, size_t max_depth) {
     ParserState state;
     state.input = html;
 
     state.position = 0;
-    state.length = strlen(html);
+    state.length = length;
+    state.arena = NULL;
+
+    state.insitu = insitu;
+    state.pending_nul = NULL;
+    state.scanned = 0;
+    HTMLNode* root;
+
+    if (insitu || (options & HTML2TEX_PARSE_ARENA)) {
+        /* the root heads the arena, so freeing it releases the document */
+        root = html2tex_arena_document(length);
+        if (!root) return NULL;
+        state.arena = html2tex_node_arena(root);
+    }
+    else {
+        root = parser_new_node(&state);
+        if (!root) return NULL;
+    }
 
-    HTMLNode* root = (HTMLNode*)malloc(sizeof(HTMLNode));
-    if (!root) return NULL;
+    /* flags are maintained while the tree is built */
+    root->flags |= HTML2TEX_NODE_ANNOTATED;
 
-    root->tag = NULL;
-    root->content = NULL;
-    root->attributes = NULL;
-    root->children = NULL;
-    root->next = NULL;
-    root->parent = NULL;
+    OpenStack elements;
+    memset(&elements, 0, sizeof(elements));
+    elements.max_depth = max_depth;
+    elements.minify = options & HTML2TEX_PARSE_MINIFY;
 
-    HTMLNode** current = &root->children;
+    int result = open_push(&elements, root, NULL) == 0 ? 1 : -1;
 
-    while (state.position < state.length) {
-        HTMLNode* node = parse_node(&state);
+    while (result > 0)
+        result = parse_step(&state, &elements, 1);
 
-        if (node) {
-            *current = node;
-            current = &node->next;
+    /* elements without an end tag close at the end of the input */
+    while (elements.depth > 1)
+        open_pop(&elements);
+
+    free(elements.open);
+    if (state.pending_nul) *state.pending_nul = '\0';
+
+    if (result < 0) {
+        html2tex_free_node(root);
+        return NULL;
+    }
+
+    return root;
+}
+
+HTMLNode* html2tex_parse_ex(const char* html, size_t length, int options) {
+    if (!html) return NULL;
+    return parse_document(html, NULL, length, options, HTML2TEX_MAX_DEPTH);
+}
+
+HTMLNode* html2tex_parse_bounded(const char* html, size_t length, int options, size_t max_depth) {
+    if (!html) return NULL;
+    return parse_document(html, NULL, length, options, max_depth);
+}
+
+HTMLNode* html2tex_parse_insitu(char* html, size_t length) {
+    if (!html) return NULL;
+    return parse_document(html, html, length, HTML2TEX_PARSE_ARENA, HTML2TEX_MAX_DEPTH);
+}
+
+struct HTMLStreamParser {
+    HTMLNode* root;
+    HTMLArena* arena;
+
+    /* input that has not been turned into nodes yet */
+    char* buffer;
+    size_t start;
+    size_t length;
+    size_t capacity;
+
+    /* bytes after start already known to hold no markup */
+    size_t text_scanned;
+
+    OpenStack elements;
+    int error;
+};
+
+static void stream_state(HTMLStreamParser* parser, ParserState* state) {
+    state->input = parser->buffer;
+    state->position = parser->start;
+    state->length = parser->length;
+    state->arena = parser->arena;
+    state->insitu = NULL;
+    state->pending_nul = NULL;
+    state->scanned = parser->start + parser->text_scanned;
+}
+
+/* Consumes as many complete tokens as the buffered input holds, with the same
+   steps as html2tex_parse; finished means no more input follows. */
+static int stream_drain(HTMLStreamParser* parser, int finished) {
+    ParserState state;
+    int result;
+
+    stream_state(parser, &state);
+
+    while ((result = parse_step(&state, &parser->elements, finished)) > 0)
+        state.scanned = 0;
+
+    parser->start = state.position;
+    parser->text_scanned = state.scanned > state.position ? state.scanned - state.position : 0;
+
+    if (result < 0) parser->error = 1;
+    return result;
+}
+
+HTMLStreamParser* html2tex_parser_create(int options) {
+    HTMLStreamParser* parser = (HTMLStreamParser*)calloc(1, sizeof(HTMLStreamParser));
+    if (!parser) return NULL;
+
+    if (options & HTML2TEX_PARSE_ARENA) {
+        parser->root = html2tex_arena_document(0);
+        parser->arena = html2tex_node_arena(parser->root);
+    }
+    else {
+        ParserState state;
+        stream_state(parser, &state);
+        parser->root = parser_new_node(&state);
+    }
+
+    parser->elements.max_depth = HTML2TEX_MAX_DEPTH;
+    parser->elements.minify = options & HTML2TEX_PARSE_MINIFY;
+
+    if (!parser->root || open_push(&parser->elements, parser->root, NULL) != 0) {
+        html2tex_parser_destroy(parser);
+        return NULL;
+    }
+
+    /* flags are maintained while the tree is built */
+    parser->root->flags |= HTML2TEX_NODE_ANNOTATED;
+    return parser;
+}
+
+int html2tex_parser_feed(HTMLStreamParser* parser, const char* data, size_t length) {
+    if (!parser || (!data && length > 0)) return -1;
+    if (parser->error) return -1;
+
+    /* drop the consumed input, only an unfinished token is kept */
+    if (parser->start > 0) {
+        parser->length -= parser->start;
+        memmove(parser->buffer, parser->buffer + parser->start, parser->length);
+        parser->start = 0;
+    }
+
+    if (length > parser->capacity - parser->length) {
+        size_t capacity = parser->capacity ? parser->capacity : BUFFER_SIZE;
+
+        while (capacity - parser->length < length) {
+            if (capacity > ((size_t)-1) / 2) {
+                parser->error = 1;
+                return -1;
+            }
+
+            capacity *= 2;
         }
-        else {
-            /* skip one character if parsing fails to avoid infinite loop */
-            if (state.position < state.length)
-                state.position++;
-            else
-                break;
+
+        char* buffer = (char*)realloc(parser->buffer, capacity);
+
+        if (!buffer) {
+            parser->error = 1;
+            return -1;
         }
+
+        parser->buffer = buffer;
+        parser->capacity = capacity;
     }
 
+    if (length > 0) memcpy(parser->buffer + parser->length, data, length);
+    parser->length += length;
+
+    return stream_drain(parser, 0) < 0 ? -1 : 0;
+}
+
+HTMLNode* html2tex_parser_finish(HTMLStreamParser* parser) {
+    if (!parser) return NULL;
+
+    /* whatever is left is the end of the document */
+    if (!parser->error && parser->buffer)
+        stream_drain(parser, 1);
+
+    HTMLNode* root = NULL;
+
+    if (!parser->error) {
+        /* elements without an end tag close at the end of the input */
+        while (parser->elements.depth > 1)
+            open_pop(&parser->elements);
+
+        root = parser->root;
+        parser->root = NULL;
+    }
+
+    html2tex_parser_destroy(parser);
     return root;
 }
 
-HTMLNode* html2tex_parse_minified(const char* html) {
-    if (!html) return NULL;
-    HTMLNode* parsed = html2tex_parse(html);
+void html2tex_parser_set_max_depth(HTMLStreamParser* parser, size_t max_depth) {
+    if (parser) parser->elements.max_depth = max_depth;
+}
 
-    if (!parsed) return NULL;
-    HTMLNode* minified = html2tex_minify_html(parsed);
+void html2tex_parser_destroy(HTMLStreamParser* parser) {
+    if (!parser) return;
 
-    /* free parsed since minify should create new tree */
-    html2tex_free_node(parsed);
+    if (parser->root)
+        html2tex_free_node(parser->root);
 
-    /* minified DOM tree */
-    return minified;
+    free(parser->elements.open);
+    free(parser->buffer);
+    free(parser);
 }
 
-HTMLNode* dom_tree_copy(HTMLNode* node) {
-    if (!node) return NULL;
+HTMLNode* html2tex_parse_minified(const char* html) {
+    if (!html) return NULL;
 
-    /* create root copy */
-    HTMLNode* new_root = (HTMLNode*)malloc(sizeof(HTMLNode));
-    if (!new_root) return NULL;
+    /* minified while it is built, in one tree */
+    return html2tex_parse_ex(html, strlen(html), HTML2TEX_PARSE_MINIFY);
+}
 
-    /* copy root data */
-    new_root->tag = node->tag ? strdup(node->tag) : NULL;
-    new_root->content = node->content ? strdup(node->content) : NULL;
-    new_root->parent = NULL;
-    new_root->next = NULL;
-    new_root->children = NULL;
+/* Copies a node with its tag, content and attributes but no links. */
+static HTMLNode* copy_node_data(const HTMLNode* node) {
+    HTMLNode* copy = (HTMLNode*)malloc(sizeof(HTMLNode));
+    if (!copy) return NULL;
+
+    copy->tag = node->tag ? html2tex_strdup(node->tag) : NULL;
+    copy->content = node->content ? html2tex_strdup(node->content) : NULL;
+    copy->parent = NULL;
+    copy->next = NULL;
+    copy->children = NULL;
+    copy->attributes = NULL;
+    copy->flags = node->flags & ~(HTML2TEX_NODE_ARENA | HTML2TEX_NODE_ARENA_ROOT);
+    copy->tag_id = node->tag_id;
+
+    if ((node->tag && !copy->tag) || (node->content && !copy->content)) {
+        html2tex_free_node(copy);
+        return NULL;
+    }
 
-    /* copy root attributes */
-    HTMLAttribute* new_attrs = NULL;
-    HTMLAttribute** current_attr = &new_attrs;
-    HTMLAttribute* old_attr = node->attributes;
+    HTMLAttribute** tail = &copy->attributes;
 
-    while (old_attr) {
+    for (const HTMLAttribute* attr = node->attributes; attr; attr = attr->next) {
         HTMLAttribute* new_attr = (HTMLAttribute*)malloc(sizeof(HTMLAttribute));
 
         if (!new_attr) {
-            html2tex_free_node(new_root);
+            html2tex_free_node(copy);
             return NULL;
         }
 
-        new_attr->key = strdup(old_attr->key);
-        new_attr->value = old_attr->value ? strdup(old_attr->value) : NULL;
-
+        new_attr->key = html2tex_strdup(attr->key);
+        new_attr->value = attr->value ? html2tex_strdup(attr->value) : NULL;
         new_attr->next = NULL;
-        *current_attr = new_attr;
 
-        current_attr = &new_attr->next;
-        old_attr = old_attr->next;
+        *tail = new_attr;
+        tail = &new_attr->next;
+
+        if (!new_attr->key || (attr->value && !new_attr->value)) {
+            html2tex_free_node(copy);
+            return NULL;
+        }
     }
-    new_root->attributes = new_attrs;
 
-    /* BFS queue for copying children */
-    NodeQueue* src_queue = NULL;
-    NodeQueue* src_rear = NULL;
+    return copy;
+}
 
-    NodeQueue* dst_queue = NULL;
-    NodeQueue* dst_rear = NULL;
+HTMLNode* dom_tree_copy(HTMLNode* node) {
+    if (!node) return NULL;
 
-    /* enqueue the root and its parent copy */
-    queue_enqueue(&src_queue, &src_rear, node);
-    queue_enqueue(&dst_queue, &dst_rear, new_root);
+    HTMLNode* new_root = copy_node_data(node);
+    if (!new_root) return NULL;
 
-    /* process nodes in BFS order */
-    while (src_queue) {
-        HTMLNode* src_current = queue_dequeue(&src_queue, &src_rear);
-        HTMLNode* dst_current = queue_dequeue(&dst_queue, &dst_rear);
+    /* Depth-first over the source without relying on its parent links: until
+       a copy gets its next sibling, its next field holds the source node. */
+    HTMLNode* src = node;
+    HTMLNode* dst = new_root;
 
-        /* copy children of current node */
-        HTMLNode* src_child = src_current->children;
-        HTMLNode** dst_child_ptr = &dst_current->children;
+    for (;;) {
+        HTMLNode* parent;
+        HTMLNode** link;
 
-        while (src_child) {
-            /* create child copy */
-            HTMLNode* new_child = (HTMLNode*)malloc(sizeof(HTMLNode));
+        if (src->children) {
+            src = src->children;
+            parent = dst;
+            link = &dst->children;
+        }
+        else {
+            /* climb to the closest copy whose source has a next sibling */
+            while (dst != new_root && !src->next) {
+                HTMLNode* up = dst->parent;
 
-            if (!new_child) {
-                html2tex_free_node(new_root);
-                queue_cleanup(&src_queue, &src_rear);
-                queue_cleanup(&dst_queue, &dst_rear);
-                return NULL;
+                dst->next = NULL;
+                dst = up;
+                src = dst == new_root ? node : dst->next;
             }
 
-            /* copy child data */
-            new_child->tag = src_child->tag ? strdup(src_child->tag) : NULL;
-            new_child->content = src_child->content ? strdup(src_child->content) : NULL;
-            new_child->parent = dst_current;
-            new_child->next = NULL;
-            new_child->children = NULL;
-
-            /* copy child attributes */
-            HTMLAttribute* child_attrs = NULL;
-            HTMLAttribute** child_attr_ptr = &child_attrs;
-            HTMLAttribute* src_child_attr = src_child->attributes;
-
-            while (src_child_attr) {
-                HTMLAttribute* new_child_attr = (HTMLAttribute*)malloc(sizeof(HTMLAttribute));
-
-                if (!new_child_attr) {
-                    html2tex_free_node(new_child);
-                    html2tex_free_node(new_root);
-                    queue_cleanup(&src_queue, &src_rear);
-                    queue_cleanup(&dst_queue, &dst_rear);
-                    return NULL;
-                }
-
-                new_child_attr->key = strdup(src_child_attr->key);
-                new_child_attr->value = src_child_attr->value ? strdup(src_child_attr->value) : NULL;
-
-                new_child_attr->next = NULL;
-                *child_attr_ptr = new_child_attr;
-
-                child_attr_ptr = &new_child_attr->next;
-                src_child_attr = src_child_attr->next;
-            }
+            if (dst == new_root) break;
 
-            /* link child to parent */
-            new_child->attributes = child_attrs;
-            *dst_child_ptr = new_child;
-            dst_child_ptr = &new_child->next;
+            src = src->next;
+            parent = dst->parent;
+            link = &dst->next;
+        }
+
+        HTMLNode* copy = copy_node_data(src);
+
+        if (!copy) {
+            /* drop the source nodes parked on the path before freeing */
+            for (HTMLNode* path = dst; path != new_root; path = path->parent)
+                path->next = NULL;
 
-            /* enqueue child for further processing (its children will be copied later) */
-            queue_enqueue(&src_queue, &src_rear, src_child);
-            queue_enqueue(&dst_queue, &dst_rear, new_child);
-            src_child = src_child->next;
+            html2tex_free_node(new_root);
+            return NULL;
         }
+
+        copy->parent = parent;
+        copy->next = src;
+        *link = copy;
+        dst = copy;
     }
 
-    /* cleanup queues */
-    queue_cleanup(&src_queue, &src_rear);
-    queue_cleanup(&dst_queue, &dst_rear);
     return new_root;
 }
 
 void html2tex_free_node(HTMLNode* node) {
     if (!node) return;
 
-    NodeQueue* q_front = NULL;
-    NodeQueue* q_rear = NULL;
+    /* arena nodes die with their document in a single release */
+    if (node->flags & HTML2TEX_NODE_ARENA) {
+        if (node->flags & HTML2TEX_NODE_ARENA_ROOT)
+            html2tex_arena_release(node);
+
+        return;
+    }
+
+    /* the siblings of node are not its to free */
+    node->next = NULL;
+    HTMLNode* current = node;
 
-    /* BFS using queue */
-    queue_enqueue(&q_front, &q_rear, node);
+    /* children are spliced in front of the nodes left to free, so the walk
+       needs neither a queue nor parent links */
+    while (current) {
+        if (current->children) {
+            HTMLNode* last = current->children;
 
-    while (q_front) {
-        /* process all children */
-        HTMLNode* current = queue_dequeue(&q_front, &q_rear);
-        HTMLNode* child = current->children;
+            while (last->next)
+                last = last->next;
 
-        while (child) {
-            HTMLNode* next_child = child->next;
-            queue_enqueue(&q_front, &q_rear, child);
-            child = next_child;
+            last->next = current->next;
+            current->next = current->children;
         }
 
-        /* break parent link */
-        current->children = NULL;
+        HTMLNode* next = current->next;
 
         /* free current node */
         if (current->tag) free(current->tag);
@@ -603,5 +1239,6 @@ void html2tex_free_node(HTMLNode* node) {
         }
 
         free(current);
+        current = next;
     }
 }
\ No newline at end of file
@@ -7,64 +7,74 @@
 #include <fstream>
 #include <sstream>
 
-HtmlParser::HtmlParser() : node(nullptr, &html2tex_free_node), minify(0) 
+/* Sinks that let the serializer write into C++ objects without a C string in between. */
+static std::size_t ostream_sink(void* context, const char* data, std::size_t size) {
+    std::ostream* const output = static_cast<std::ostream*>(context);
+    return output->write(data, static_cast<std::streamsize>(size)) ? size : 0;
+}
+
+static std::size_t string_sink(void* context, const char* data, std::size_t size) {
+    try {
+        static_cast<std::string*>(context)->append(data, size);
+        return size;
+    }
+    catch (...) {
+        /* exceptions must not cross the C serializer */
+        return 0;
+    }
+}
+
+HtmlParser::HtmlParser() : node(), minify(0) 
 { }
 
 HtmlParser::HtmlParser(const std::string& html) : HtmlParser(html, 0) { }
 
 HtmlParser::HtmlParser(const std::string& html, int minify_flag) noexcept
-    : node(nullptr, &html2tex_free_node), minify(minify_flag) {
+    : node(), minify(minify_flag) {
     /* empty parser, but valid state */
     if (html.empty()) return;
 
-    HTMLNode* raw_node = minify_flag ? html2tex_parse_minified(html.c_str())
-        : html2tex_parse(html.c_str());
-
     /* if parsing fails, node remains nullptr */
-    if (raw_node) node.reset(raw_node);
+    setParent(minify_flag ? html2tex_parse_minified(html.c_str())
+        : html2tex_parse(html.c_str()));
 }
 
 HtmlParser::HtmlParser(HTMLNode* raw_node) : HtmlParser(raw_node, 0)
 { }
 
 HtmlParser::HtmlParser(HTMLNode* raw_node, int minify_flag) noexcept
-    : node(nullptr, &html2tex_free_node), minify(minify_flag) {
-    /* object is in empty but valid state */
-    if (!raw_node) return;
+    : node(), minify(minify_flag) {
+    /* object is in empty but valid state, the caller keeps raw_node */
+    if (raw_node) setParent(dom_tree_copy(raw_node));
+}
 
-    HTMLNode* copied_node = dom_tree_copy(raw_node);
-    if (copied_node) node.reset(copied_node);
+HtmlParser::HtmlParser(std::unique_ptr<HTMLNode, decltype(&html2tex_free_node)> owned, int minify_flag) noexcept
+    : node(), minify(minify_flag) {
+    setParent(owned.release());
 }
 
-HtmlParser::HtmlParser(const HtmlParser& other) noexcept
-    : node(nullptr, &html2tex_free_node), minify(other.minify) {
-    if (other.node) {
-        HTMLNode* copied_node = dom_tree_copy(other.node.get());
-        if (copied_node) node.reset(copied_node);
-    }
+/* Annotates a tree that was edited since its flags were computed, so that sharing it keeps it read-only. */
+static const std::shared_ptr<HTMLNode>& share_annotated(const std::shared_ptr<HTMLNode>& tree) noexcept {
+    if (tree && !(tree->flags & HTML2TEX_NODE_ANNOTATED))
+        html2tex_annotate_dom(tree.get());
+
+    return tree;
 }
 
+HtmlParser::HtmlParser(const HtmlParser& other) noexcept
+    : node(share_annotated(other.node)), minify(other.minify) 
+{ }
+
 HtmlParser::HtmlParser(HtmlParser&& other) noexcept
     : node(std::move(other.node)), minify(other.minify) {
-    other.node.reset(nullptr);
+    other.node.reset();
     other.minify = 0;
 }
 
 HtmlParser& HtmlParser::operator =(const HtmlParser& other) {
-    if (this != &other) {
-        /* temp smart pointer for exception safety */
-        std::unique_ptr<HTMLNode, decltype(&html2tex_free_node)> temp(nullptr, &html2tex_free_node);
-
-        if (other.node) {
-            HTMLNode* copied_node = dom_tree_copy(other.node.get());
-            if (copied_node) temp.reset(copied_node);
-        }
-
-        /* commit changes */
-        node = std::move(temp);
-        minify = other.minify;
-    }
-
+    /* both parsers share the tree until one of them modifies it */
+    node = share_annotated(other.node);
+    minify = other.minify;
     return *this;
 }
 
@@ -79,117 +89,85 @@ HtmlParser& HtmlParser::operator =(HtmlParser&& other) noexcept {
 }
 
 std::ostream& operator <<(std::ostream& out, const HtmlParser& parser) {
-    std::string output = parser.toString();
-    out << output;
+    /* an empty parser writes nothing, a failed write marks the stream */
+    if (parser.node && html2tex_serialize(parser.node.get(), 0, &ostream_sink, &out) != 0)
+        out.setstate(std::ios_base::badbit);
+
     return out;
 }
 
-void HtmlParser::setParent(std::unique_ptr<HTMLNode, decltype(&html2tex_free_node)> new_node) noexcept {
-    node = std::move(new_node);
+void HtmlParser::setParent(HTMLNode* new_node) noexcept {
+    node.reset();
+    if (!new_node) return;
+
+    /* a shared tree is only read, so its cached flags are computed up front */
+    if (!(new_node->flags & HTML2TEX_NODE_ANNOTATED))
+        html2tex_annotate_dom(new_node);
+
+    try {
+        node.reset(new_node, &html2tex_free_node);
+    }
+    catch (const std::bad_alloc&) {
+        /* the tree was already released by the failed reset */
+        node.reset();
+    }
 }
 
 std::istream& operator >>(std::istream& in, HtmlParser& parser) {
     /* early exit for bad streams */
     if (in.bad()) {
-        parser.setParent({ nullptr, &html2tex_free_node });
+        parser.setParent(nullptr);
         return in;
     }
 
     /* use sentry for proper stream behavior */
     std::istream::sentry sentry(in);
+    auto* sbuf = in.rdbuf();
 
-    if (!sentry) {
-        parser.setParent({ nullptr, &html2tex_free_node });
+    if (!sentry || !sbuf) {
+        parser.setParent(nullptr);
         return in;
     }
 
-    constexpr std::size_t kMaxSize = 134'217'728;
-    std::string content;
+    /* a minified tree is built that way, without a second pass */
+    std::unique_ptr<HTMLStreamParser, decltype(&html2tex_parser_destroy)> stream(
+        html2tex_parser_create(parser.minify ? HTML2TEX_PARSE_MINIFY : 0),
+        &html2tex_parser_destroy);
 
-    /* use rdbuf for optimal reading */
-    auto* sbuf = in.rdbuf();
-
-    if (sbuf) {
-        /* get stream size hint if available */
-        const std::streamsize available = sbuf->in_avail();
-
-        if (available > 0) {
-            const std::size_t hint_size = static_cast<std::size_t>(
-                std::min<std::streamsize>(available, kMaxSize));
-            content.reserve(std::min(hint_size, std::size_t(262'144)));
-        }
+    if (!stream) {
+        parser.setParent(nullptr);
+        in.setstate(std::ios_base::failbit);
+        return in;
     }
 
-    /* read directly using streambuf */
-    bool success = false;
+    /* parse each chunk as it arrives instead of buffering the whole input */
+    std::vector<char> buffer(65536);
     std::size_t total_read = 0;
 
-    if (sbuf) {
-        std::streambuf::int_type ch;
-        content.clear();
+    for (;;) {
+        const std::streamsize count = sbuf->sgetn(
+            buffer.data(), static_cast<std::streamsize>(buffer.size()));
 
-        while (total_read < kMaxSize) {
-            ch = sbuf->sbumpc();
+        if (count <= 0) break;
 
-            if (ch == std::streambuf::traits_type::eof()) {
-                success = true;
-                break;
-            }
-
-            content.push_back(std::streambuf::traits_type::to_char_type(ch));
-            ++total_read;
-
-            /* bulk read optimization */
-            if (total_read == 1) {
-                const std::streamsize remaining = sbuf->in_avail();
-
-                if (remaining > 0) {
-                    const std::size_t to_read = std::min(
-                        static_cast<std::size_t>(remaining),
-                        kMaxSize - total_read);
-
-                    if (to_read > 0) {
-                        content.resize(total_read + to_read);
-                        const std::streamsize actually_read = sbuf->sgetn(
-                            &content[total_read], static_cast<std::streamsize>(to_read));
-
-                        total_read += static_cast<std::size_t>(actually_read);
-                        content.resize(total_read);
-
-                        /* EOF reached */
-                        if (actually_read < static_cast<std::streamsize>(to_read)) {
-                            success = true;
-                            break;
-                        }
-                    }
-                }
-            }
+        if (html2tex_parser_feed(stream.get(), buffer.data(), static_cast<std::size_t>(count)) != 0) {
+            parser.setParent(nullptr);
+            in.setstate(std::ios_base::failbit);
+            return in;
         }
 
-        /* size limit reached */
-        if (total_read >= kMaxSize)
-            in.clear(in.rdstate() & ~std::ios_base::failbit);
-    }
-
-    /* fallback to standard read if streambuf method failed */
-    if (!success) {
-        in.clear();
-        return operator>>(in, parser);
+        total_read += static_cast<std::size_t>(count);
     }
 
-    /* parse the content */
-    if (!content.empty()) {
-        HTMLNode* raw_node = parser.minify ?
-            html2tex_parse_minified(content.c_str()) :
-            html2tex_parse(content.c_str());
+    in.setstate(std::ios_base::eofbit);
 
-        if (raw_node) {
-            parser.setParent({ raw_node, &html2tex_free_node });
-            return in;
-        }
+    /* empty input leaves the parser empty */
+    if (total_read == 0) {
+        parser.setParent(nullptr);
+        return in;
     }
 
-    parser.setParent({ nullptr, &html2tex_free_node });
+    parser.setParent(html2tex_parser_finish(stream.release()));
     return in;
 }
 
@@ -198,90 +176,40 @@ HtmlParser HtmlParser::fromStream(std::ifstream& input) noexcept {
     if (!input.is_open() || input.bad())
         return HtmlParser();
 
-    /* get file size for optimal buffer sizing */
     const std::streampos current_pos = input.tellg();
-    input.seekg(0, std::ios::end);
-
-    const std::streamsize file_size = input.tellg() - current_pos;
-    input.seekg(current_pos);
 
-    /* optimize buffer size based on file size */
-    constexpr size_t SMALL_FILE = 65'536;
+    std::unique_ptr<HTMLStreamParser, decltype(&html2tex_parser_destroy)> stream(
+        html2tex_parser_create(0), &html2tex_parser_destroy);
 
-    constexpr size_t MEDIUM_FILE = 1'048'576;
-    constexpr size_t MAX_READ = 134'217'728;
+    if (!stream) return HtmlParser();
 
-    /* reject files over limit immediately */
-    if (file_size > static_cast<std::streamsize>(MAX_READ))
-        return HtmlParser();
-
-    /* choose optimal buffer size */
-    size_t buffer_size;
-
-    if (file_size <= static_cast<std::streamsize>(SMALL_FILE))
-        buffer_size = 4096;
-    else if (file_size <= static_cast<std::streamsize>(MEDIUM_FILE))
-        buffer_size = 16384;
-    else
-        buffer_size = 65536;
-
-    /* optimize initial capacity */
-    std::string content;
-
-    if (file_size > 0) {
-        const size_t reserve_size = static_cast<size_t>(file_size) + 1;
-        if (reserve_size <= MAX_READ) content.reserve(reserve_size);
-    }
-
-    /* use vector for potentially better memory handling */
-    std::vector<char> buffer(buffer_size);
+    /* the file is parsed chunk by chunk, so its size is not limited by memory */
+    std::vector<char> buffer(65536);
     size_t total_read = 0;
     bool read_error = false;
 
-    /* single-pass optimized read loop */
-    while (total_read < MAX_READ) {
-        /* read data directly */
+    for (;;) {
         input.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
         const std::streamsize bytes_read = input.gcount();
 
-        /* handle read results efficiently */
-        if (bytes_read <= 0) {
-            if (input.eof()) break;
-
-            if (input.fail() || input.bad()) {
+        if (bytes_read > 0) {
+            if (html2tex_parser_feed(stream.get(), buffer.data(), static_cast<size_t>(bytes_read)) != 0) {
                 read_error = true;
                 break;
             }
-            
-            /* non-blocking or empty */
-            break;
-        }
-
-        /* convert safely with single check */
-        const size_t bytes_size = static_cast<size_t>(bytes_read);
 
-        /* check for size limit violation */
-        if (bytes_size > MAX_READ - total_read) {
-            /* append only what fits */
-            const size_t can_append = MAX_READ - total_read;
-
-            if (can_append > 0 && can_append <= buffer.size())
-                content.append(buffer.data(), can_append);
-            
-            break;
+            total_read += static_cast<size_t>(bytes_read);
         }
 
-        /* bulk append for performance */
-        content.append(buffer.data(), bytes_size);
-        total_read += bytes_size;
-
-        /* early exit if EOF reached */
-        if (input.eof() || bytes_size < buffer.size())
+        /* end of file, or a failed read */
+        if (!input) {
+            read_error = input.bad();
             break;
+        }
     }
 
     /* validate read operation */
-    if (read_error || content.empty() || input.bad()) {
+    if (read_error || total_read == 0) {
         input.clear();
 
         if (current_pos != std::streampos(-1))
@@ -290,72 +218,44 @@ HtmlParser HtmlParser::fromStream(std::ifstream& input) noexcept {
         return HtmlParser();
     }
 
-    /* parse final content */
-    if (!content.empty()) {
-        HTMLNode* raw_node = html2tex_parse(content.c_str());
-        if (raw_node) return HtmlParser(raw_node);
-    }
-
-    return HtmlParser();
+    /* the finished tree is handed over without another copy */
+    return adopt(html2tex_parser_finish(stream.release()));
 }
 
 HtmlParser HtmlParser::fromHtml(const std::string& filePath) noexcept {
-    /* open with optimal flags for reading */
-    std::ifstream fin(filePath, std::ios::binary | std::ios::ate);
-    if (!fin.is_open()) return HtmlParser();
-
-    /* get exact file size */
-    const std::streamsize file_size = fin.tellg();
-    fin.seekg(0, std::ios::beg);
-
-    /* reject invalid or empty files */
-    if (file_size <= 0) {
-        fin.close();
-
-        /* truly empty file */
-        if (file_size == 0) {
-            /* parse empty content */
-            HTMLNode* raw_node = html2tex_parse("");
-            if (raw_node) return HtmlParser(raw_node);
-        }
-
-        return HtmlParser();
-    }
-
-    /* enforce absolute size limit for security reasons */
-    constexpr size_t MAX_READ = 134'217'728;
-
-    /* file too large */
-    if (static_cast<size_t>(file_size) > MAX_READ) {
-        fin.close();
-        return HtmlParser();
-    }
-
-    /* single allocation for entire file, good for performance */
-    std::string content;
-    content.resize(static_cast<size_t>(file_size));
-
-    /* read entire file in one operation, that is fastest for known size */
-    fin.read(&content[0], file_size);
-    const bool read_ok = fin.gcount() == file_size && !fin.bad();
-
-    /* close immediately after read */
-    fin.close();
-
-    /* validate complete read */
-    if (!read_ok) return HtmlParser();
+    return fromHtml(filePath, 0);
+}
 
-    /* parse the content */
-    HTMLNode* raw_node = html2tex_parse(content.c_str());
+HtmlParser HtmlParser::fromHtml(const std::string& filePath, int minify_flag) noexcept {
+    /* the file is mapped and tokenized in place, so its size is not limited by a read buffer */
+    const int options = minify_flag ? HTML2TEX_PARSE_MINIFY : 0;
+    return adopt(html2tex_parse_file(filePath.c_str(), options), minify_flag);
+}
 
-    if (raw_node) return HtmlParser(raw_node);
-    return HtmlParser();
+HtmlParser HtmlParser::adopt(HTMLNode* raw_node, int minify_flag) noexcept {
+    return HtmlParser(std::unique_ptr<HTMLNode, decltype(&html2tex_free_node)>(raw_node, &html2tex_free_node),
+        minify_flag);
 }
 
 HTMLNode* HtmlParser::getHtmlNode() const noexcept { 
     return node.get(); 
 }
 
+HTMLNode* HtmlParser::getMutableHtmlNode() noexcept {
+    /* copy on write, other parsers keep the tree as it was */
+    if (node && node.use_count() > 1) {
+        HTMLNode* copy = dom_tree_copy(node.get());
+
+        /* keep sharing the tree when it cannot be cloned */
+        if (!copy) return nullptr;
+        setParent(copy);
+    }
+
+    /* the caller may restructure the tree, its table flags are recomputed on use */
+    if (node) node->flags &= ~HTML2TEX_NODE_ANNOTATED;
+    return node.get();
+}
+
 bool HtmlParser::hasContent() const noexcept { 
     return node != nullptr; 
 }
@@ -380,22 +280,27 @@ void HtmlParser::writeTo(const std::string& filePath) const {
     }
 }
 
-std::string HtmlParser::toString() const noexcept {
+void HtmlParser::writeTo(std::ostream& output, bool compact) const {
+    /* validate the state */
+    if (!hasContent())
+        throw std::logic_error("Parser contains no HTML content.");
+
+    const int options = compact ? HTML2TEX_SERIALIZE_COMPACT : 0;
+
+    if (html2tex_serialize(node.get(), options, &ostream_sink, &output) != 0 || !output.flush())
+        throw std::runtime_error("Failed to write HTML content.");
+}
+
+std::string HtmlParser::toString(bool compact) const noexcept {
     /* quick exit for common case */
-    if (!node)
-        return "";
+    std::string output;
+    if (!node) return output;
 
-    /* get formatted HTML */
-    char* const raw_output = get_pretty_html(node.get());
+    /* serialize straight into the string, without a C copy to convert */
+    const int options = compact ? HTML2TEX_SERIALIZE_COMPACT : 0;
 
-    /* add RAII ownership for safely destroying the allocate memory */
-    const auto deleter = [](char* p) noexcept { std::free(p); };
-    std::unique_ptr<char[], decltype(deleter)> output_guard(raw_output, deleter);
+    if (html2tex_serialize(node.get(), options, &string_sink, &output) != 0)
+        return std::string();
 
-    /* now check for valid output */
-    if (!raw_output || raw_output[0] == '\0')
-        return "";
-    
-    /* return output string */
-    return std::string(raw_output);
+    return output;
 }
\ No newline at end of file
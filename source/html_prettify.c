@@ -2,372 +2,325 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
 
-/* This helper function to check if element is inline, required for formatting. */
-static int is_inline_element_for_formatting(const char* tag_name) {
-    if (!tag_name) return 0;
-
-    static const char* const inline_tags[] = {
-        "a", "abbr", "b", "bdi", "bdo", "br", "cite", "code",
-        "data", "dfn", "em", "font", "i", "kbd", "mark", "q",
-        "rp", "rt", "ruby", "samp", "small", "span", "strong",
-        "sub", "sup", "time", "u", "var", "wbr", NULL
-    };
-
-    /* fast check for single-char tags */
-    if (tag_name[1] == '\0') {
-        char c = tag_name[0];
-
-        return c == 'a' || c == 'b' 
-            || c == 'i' || c == 'u' 
-            || c == 'q' || c == 's' 
-            || c == 'v';
-    }
+/* Document wrapper around the serialized tree, pretty and compact. */
+static const char pretty_header[] = "<!DOCTYPE html>\n<html>\n<head>\n"
+    "  <meta charset=\"UTF-8\">\n"
+    "  <title>Parsed HTML Output</title>\n"
+    "</head>\n<body>\n";
 
-    /* optimize linear search with length check */
-    size_t len = strlen(tag_name);
+static const char pretty_footer[] = "</body>\n</html>\n";
 
-    for (int i = 0; inline_tags[i]; i++) {
-        /* fast reject by length first */
-        if (strlen(inline_tags[i]) != len) continue;
+static const char compact_header[] = "<!DOCTYPE html><html><head>"
+    "<meta charset=\"UTF-8\">"
+    "<title>Parsed HTML Output</title>"
+    "</head><body>";
 
-        /* compare the rest of tag name */
-        if (strcmp(tag_name, inline_tags[i]) == 0)
-            return 1;
-    }
+static const char compact_footer[] = "</body></html>";
 
-    return 0;
-}
+/* Indentation of up to 32 levels, deeper levels write it in pieces. */
+static const char indent_spaces[] = "                                                                ";
 
-/* This helper function is used to escape HTML special characters. */
-static char* escape_html(const char* text) {
-    if (!text) return NULL;
-    const char* p = text;
-    size_t extra = 0;
-
-    /* count special chars efficiently */
-    while (*p) {
-        unsigned char c = (unsigned char)*p;
-        if (c == '<' || c == '>') extra += 3;
-
-        else if (c == '&') {
-            /* check if already escaped */
-            if (strncmp(p, "&lt;", 4) && strncmp(p, "&gt;", 4) &&
-                strncmp(p, "&amp;", 5) && strncmp(p, "&quot;", 6) &&
-                strncmp(p, "&apos;", 6) && strncmp(p, "&#", 2))
-                extra += 4;
-        }
+/* Output of one serialization: a buffer handed to the sink whenever it fills,
+   or without a sink a growing string, so concurrent calls share nothing. */
+typedef struct {
+    char* data;
+    size_t size;
+    size_t capacity;
 
-        else if (c == '"') extra += 5;
-        else if (c == '\'') extra += 5;
-        p++;
-    }
+    html2tex_sink_fn sink;
+    void* context;
+    int compact;
+    int error;
+} HtmlWriter;
 
-    /* no escaping needed, return copy */
-    if (extra == 0) return strdup(text);
+/* This helper function to check if element is inline, required for formatting. */
+static int is_inline_element_for_formatting(HTMLNode* node) {
+    return (html2tex_tag_flags(html2tex_node_tag(node)) & HTML2TEX_TAG_IS_PHRASING) != 0;
+}
 
-    /* allocate once */
-    size_t len = p - text;
+static void writer_flush(HtmlWriter* writer) {
+    if (writer->size == 0) return;
 
-    char* escaped = (char*)malloc(len + extra + 1);
-    if (!escaped) return NULL;
+    if (!writer->error && writer->sink(writer->context, writer->data, writer->size) != writer->size)
+        writer->error = 1;
 
-    /* copy with escaping */
-    char* dest = escaped;
-    p = text;
+    writer->size = 0;
+}
 
-    while (*p) {
-        unsigned char c = (unsigned char)*p;
+/* Appends length bytes, flushing a full buffer to the sink or growing the string. */
+static void writer_put(HtmlWriter* writer, const char* data, size_t length) {
+    if (writer->error || length == 0) return;
 
-        if (c == '<') {
-            memcpy(dest, "&lt;", 4);
-            dest += 4;
-        }
-        else if (c == '>') {
-            memcpy(dest, "&gt;", 4);
-            dest += 4;
-        }
-        else if (c == '&') {
-            /* check if already escaped */
-            if (strncmp(p, "&lt;", 4) && strncmp(p, "&gt;", 4) &&
-                strncmp(p, "&amp;", 5) && strncmp(p, "&quot;", 6) &&
-                strncmp(p, "&apos;", 6) && strncmp(p, "&#", 2)) {
-                memcpy(dest, "&amp;", 5);
-                dest += 5;
+    if (writer->capacity - writer->size < length) {
+        if (writer->sink) {
+            writer_flush(writer);
+
+            /* a run longer than the buffer goes to the sink as it is */
+            if (length >= writer->capacity) {
+                if (!writer->error && writer->sink(writer->context, data, length) != length)
+                    writer->error = 1;
+
+                return;
             }
-            else
-                *dest++ = *p;
-        }
-        else if (c == '"') {
-            memcpy(dest, "&quot;", 6);
-            dest += 6;
         }
-        else if (c == '\'') {
-            memcpy(dest, "&apos;", 6);
-            dest += 6;
+        else {
+            size_t capacity = writer->capacity;
+
+            while (capacity - writer->size < length) {
+                if (capacity > ((size_t)-1) / 2) {
+                    writer->error = 1;
+                    return;
+                }
+
+                capacity *= 2;
+            }
+
+            char* grown = (char*)realloc(writer->data, capacity);
+
+            if (!grown) {
+                writer->error = 1;
+                return;
+            }
+
+            writer->data = grown;
+            writer->capacity = capacity;
         }
-        else
-            *dest++ = *p;
-        p++;
     }
 
-    *dest = '\0';
-    return escaped;
+    memcpy(writer->data + writer->size, data, length);
+    writer->size += length;
 }
 
-/* Recursive function to write the prettified HTML code. */
-static void write_pretty_node(FILE* file, HTMLNode* node, int indent_level) {
-    if (!node || !file) return;
+static void writer_indent(HtmlWriter* writer, int level) {
+    size_t width = (size_t)level * 2;
 
-    /* use fixed size buffer for efficient writing */
-    static char buffer[8192];
-    static size_t buf_pos = 0;
+    while (width > 0) {
+        const size_t piece = width < sizeof(indent_spaces) - 1 ? width : sizeof(indent_spaces) - 1;
+        writer_put(writer, indent_spaces, piece);
+        width -= piece;
+    }
+}
 
-    /* helper macros used for buffered writes */
-#define FLUSH_BUFFER() \
-        if (buf_pos > 0) { \
-            fwrite(buffer, 1, buf_pos, file); \
-            buf_pos = 0; \
-        }
+/* Reports whether the '&' at text already starts an entity, which is kept as it is. */
+static int starts_entity(const char* text) {
+    return !strncmp(text, "&lt;", 4) || !strncmp(text, "&gt;", 4) ||
+        !strncmp(text, "&amp;", 5) || !strncmp(text, "&quot;", 6) ||
+        !strncmp(text, "&apos;", 6) || !strncmp(text, "&#", 2);
+}
 
-#define CHECK_BUFFER(needed) \
-        if (buf_pos + (needed) >= sizeof(buffer)) FLUSH_BUFFER()
-
-#define BUFFER_WRITE(str, len) \
-        do { \
-            CHECK_BUFFER(len); \
-            memcpy(buffer + buf_pos, (str), (len)); \
-            buf_pos += (len); \
-        } while(0)
-
-#define BUFFER_PRINTF(fmt, ...) \
-        do { \
-            int needed = snprintf(NULL, 0, fmt, __VA_ARGS__); \
-            CHECK_BUFFER(needed + 1); \
-            buf_pos += snprintf(buffer + buf_pos, sizeof(buffer) - buf_pos, fmt, __VA_ARGS__); \
-        } while(0)
-
-    /* indentation */
-    for (int i = 0; i < indent_level; i++)
-        BUFFER_WRITE("  ", 2);
-
-    if (node->tag) {
-        /* node element */
-        BUFFER_PRINTF("<%s", node->tag);
-
-        /* write attributes */
-        HTMLAttribute* attr = node->attributes;
-
-        while (attr) {
-            if (attr->value) {
-                char* escaped_value = escape_html(attr->value);
-
-                if (escaped_value) {
-                    BUFFER_PRINTF(" %s=\"%s\"", attr->key, escaped_value);
-                    free(escaped_value);
-                }
-                else
-                    BUFFER_PRINTF(" %s=\"%s\"", attr->key, attr->value);
-            }
-            else
-                BUFFER_PRINTF(" %s", attr->key);
-            attr = attr->next;
+/* Writes text with the HTML special characters escaped, copying the runs between them whole. */
+static void write_escaped(HtmlWriter* writer, const char* text) {
+    for (;;) {
+        const size_t run = strcspn(text, "<>&\"'");
+        writer_put(writer, text, run);
+        text += run;
+
+        switch (*text) {
+        case '\0':
+            return;
+        case '<':
+            writer_put(writer, "&lt;", 4);
+            break;
+        case '>':
+            writer_put(writer, "&gt;", 4);
+            break;
+        case '&':
+            if (starts_entity(text)) writer_put(writer, "&", 1);
+            else writer_put(writer, "&amp;", 5);
+            break;
+        case '"':
+            writer_put(writer, "&quot;", 6);
+            break;
+        default:
+            writer_put(writer, "&apos;", 6);
+            break;
         }
 
-        /* check if inline */
-        int is_inline = is_inline_element_for_formatting(node->tag);
+        text++;
+    }
+}
+
+/* Writes a node up to its children: all of it when it has none, and returns whether
+   the walk descends into them, the closing tag then being left to write_close. */
+static int write_open(HtmlWriter* writer, HTMLNode* node, int indent_level) {
+    const int pretty = !writer->compact;
+    if (pretty) writer_indent(writer, indent_level);
+
+    if (!node->tag) {
+        /* text node element, blank text only keeps its line when pretty */
+        if (!node->content) return 0;
 
-        /* check if self-closing */
-        if (!node->children && !node->content)
-            BUFFER_WRITE(" />\n", 4);
+        if (!pretty)
+            write_escaped(writer, node->content);
         else {
-            /* write content if present */
-            BUFFER_WRITE(">", 1);
-
-            if (node->content) {
-                char* escaped_content = escape_html(node->content);
-
-                if (escaped_content) {
-                    /* check if it is whitespace only */
-                    int all_whitespace = 1;
-
-                    for (char* p = escaped_content; *p; p++) {
-                        if (!isspace((unsigned char)*p)) {
-                            all_whitespace = 0;
-                            break;
-                        }
-                    }
-
-                    if (!all_whitespace)
-                        BUFFER_PRINTF("%s", escaped_content);
-                    free(escaped_content);
-                }
-            }
+            if (!is_whitespace_only(node->content))
+                write_escaped(writer, node->content);
 
-            /* write children elements */
-            if (node->children) {
-                if (!is_inline)
-                    BUFFER_WRITE("\n", 1);
+            writer_put(writer, "\n", 1);
+        }
 
-                /* flush before recursion */
-                FLUSH_BUFFER();
-                HTMLNode* child = node->children;
+        return 0;
+    }
 
-                while (child) {
-                    write_pretty_node(file, child, indent_level + 1);
-                    child = child->next;
-                }
+    writer_put(writer, "<", 1);
+    writer_put(writer, node->tag, strlen(node->tag));
 
-                if (!is_inline) {
-                    /* indentation required for closing tag */
-                    for (int i = 0; i < indent_level; i++)
-                        BUFFER_WRITE("  ", 2);
-                }
-            }
+    /* write attributes */
+    for (HTMLAttribute* attr = node->attributes; attr; attr = attr->next) {
+        writer_put(writer, " ", 1);
+        writer_put(writer, attr->key, strlen(attr->key));
 
-            BUFFER_PRINTF("</%s>\n", node->tag);
+        if (attr->value) {
+            writer_put(writer, "=\"", 2);
+            write_escaped(writer, attr->value);
+            writer_put(writer, "\"", 1);
         }
     }
-    else {
-        /* text node element */
-        if (node->content) {
-            char* escaped_content = escape_html(node->content);
-
-            if (escaped_content) {
-                /* check if whitespace-only */
-                int all_whitespace = 1;
-
-                for (char* p = escaped_content; *p; p++) {
-                    if (!isspace((unsigned char)*p)) {
-                        all_whitespace = 0;
-                        break;
-                    }
-                }
 
-                if (!all_whitespace)
-                    BUFFER_PRINTF("%s\n", escaped_content);
-                else
-                    BUFFER_WRITE("\n", 1);
-                free(escaped_content);
-            }
-        }
+    /* check if self-closing */
+    if (!node->children && !node->content) {
+        writer_put(writer, " />\n", pretty ? 4 : 3);
+        return 0;
     }
 
-    /* final flush if we are at the top level */
-    if (indent_level == 0)
-        FLUSH_BUFFER();
-
-#undef FLUSH_BUFFER
-#undef CHECK_BUFFER
-#undef BUFFER_WRITE
-#undef BUFFER_PRINTF
-}
+    writer_put(writer, ">", 1);
 
-int write_pretty_html(HTMLNode* root, const char* filename) {
-    if (!root || !filename) return 0;
-    FILE* file = fopen(filename, "w");
+    if (node->content && (!pretty || !is_whitespace_only(node->content)))
+        write_escaped(writer, node->content);
 
-    if (!file) {
-        fprintf(stderr, "Error: Could not open file %s for writing.\n", filename);
+    if (!node->children) {
+        writer_put(writer, "</", 2);
+        writer_put(writer, node->tag, strlen(node->tag));
+        writer_put(writer, ">\n", pretty ? 2 : 1);
         return 0;
     }
 
-    /* write HTML header */
-    fprintf(file, "<!DOCTYPE html>\n<html>\n<head>\n");
-    fprintf(file, "  <meta charset=\"UTF-8\">\n");
-    fprintf(file, "  <title>Parsed HTML Output</title>\n");
-    fprintf(file, "</head>\n<body>\n");
+    /* children of block elements start on their own lines */
+    if (pretty && !is_inline_element_for_formatting(node))
+        writer_put(writer, "\n", 1);
 
-    /* write the parsed content */
-    HTMLNode* child = root->children;
+    return 1;
+}
 
-    while (child) {
-        write_pretty_node(file, child, 1);
-        child = child->next;
-    }
+/* Writes the closing tag of an element whose children were written. */
+static void write_close(HtmlWriter* writer, HTMLNode* node, int indent_level) {
+    const int pretty = !writer->compact;
 
-    /* write HTML footer and close the stream */
-    fprintf(file, "</body>\n</html>\n");
-    fclose(file);
-    return 1;
+    /* indentation required for closing tag */
+    if (pretty && !is_inline_element_for_formatting(node))
+        writer_indent(writer, indent_level);
+
+    writer_put(writer, "</", 2);
+    writer_put(writer, node->tag, strlen(node->tag));
+    writer_put(writer, ">\n", pretty ? 2 : 1);
 }
 
-char* get_pretty_html(HTMLNode* root) {
-    if (!root) return NULL;
+/* Writes the children of root and their subtrees. The walk follows the child, next and
+   parent links with the indentation as a counter, so any depth fits on the stack. */
+static void write_children(HtmlWriter* writer, HTMLNode* root) {
+    HTMLNode* node = root->children;
+    int indent_level = 1;
+
+    while (node) {
+        if (write_open(writer, node, indent_level)) {
+            node = node->children;
+            indent_level++;
+            continue;
+        }
+
+        /* climb until a node with a next sibling, closing the elements left behind */
+        while (!node->next) {
+            node = node->parent;
+            indent_level--;
 
-#ifndef _WIN32
-    /* use open_memstream for fastest, no disk I/O */
-    char* buffer = NULL;
-
-    size_t size = 0;
-    FILE* stream = open_memstream(&buffer, &size);
-
-    if (stream) {
-        /* write HTML to memory stream */
-        fprintf(stream, "<!DOCTYPE html>\n<html>\n<head>\n");
-        fprintf(stream, "  <meta charset=\"UTF-8\">\n");
-        fprintf(stream, "  <title>Parsed HTML Output</title>\n");
-        fprintf(stream, "</head>\n<body>\n");
-
-        /* write content using our buffered function */
-        HTMLNode* child = root->children;
-        while (child) {
-            write_pretty_node_buffered(stream, child, 1);
-            child = child->next;
+            if (!node || node == root) return;
+            write_close(writer, node, indent_level);
         }
 
-        fprintf(stream, "</body>\n</html>\n");
-        fclose(stream);
-        return buffer;
+        node = node->next;
     }
-#endif
-    FILE* temp_file = tmpfile();
-    if (!temp_file) return NULL;
+}
 
-    /* write to temp file */
-    fprintf(temp_file, "<!DOCTYPE html>\n<html>\n<head>\n");
-    fprintf(temp_file, "  <meta charset=\"UTF-8\">\n");
-    fprintf(temp_file, "  <title>Parsed HTML Output</title>\n");
-    fprintf(temp_file, "</head>\n<body>\n");
+/* Writes the whole document, the buffered tail is left to the caller. */
+static void write_document(HtmlWriter* writer, HTMLNode* root) {
+    if (writer->compact)
+        writer_put(writer, compact_header, sizeof(compact_header) - 1);
+    else
+        writer_put(writer, pretty_header, sizeof(pretty_header) - 1);
 
-    HTMLNode* child = root->children;
+    write_children(writer, root);
 
-    while (child) {
-        write_pretty_node(temp_file, child, 1);
-        child = child->next;
-    }
+    if (writer->compact)
+        writer_put(writer, compact_footer, sizeof(compact_footer) - 1);
+    else
+        writer_put(writer, pretty_footer, sizeof(pretty_footer) - 1);
+}
 
-    fprintf(temp_file, "</body>\n</html>\n");
+int html2tex_serialize(HTMLNode* root, int options, html2tex_sink_fn sink, void* context) {
+    if (!root || !sink) return -1;
 
-    /* get the file size and read back */
-    if (fseek(temp_file, 0, SEEK_END) != 0) {
-        fclose(temp_file);
-        return NULL;
-    }
+    HtmlWriter writer;
+    writer.data = (char*)malloc(HTML2TEX_SINK_BUFFER_SIZE);
+    if (!writer.data) return -1;
 
-    long file_size = ftell(temp_file);
+    writer.size = 0;
+    writer.capacity = HTML2TEX_SINK_BUFFER_SIZE;
+    writer.sink = sink;
+    writer.context = context;
+    writer.compact = (options & HTML2TEX_SERIALIZE_COMPACT) != 0;
+    writer.error = 0;
 
-    if (file_size <= 0) {
-        fclose(temp_file);
-        return strdup("");
-    }
+    write_document(&writer, root);
+    writer_flush(&writer);
+
+    free(writer.data);
+    return writer.error ? -1 : 0;
+}
+
+char* html2tex_serialize_string(HTMLNode* root, int options, size_t* length) {
+    if (!root) return NULL;
+
+    HtmlWriter writer;
+    writer.data = (char*)malloc(4096);
+    if (!writer.data) return NULL;
 
-    if (fseek(temp_file, 0, SEEK_SET) != 0) {
-        fclose(temp_file);
+    writer.size = 0;
+    writer.capacity = 4096;
+    writer.sink = NULL;
+    writer.context = NULL;
+    writer.compact = (options & HTML2TEX_SERIALIZE_COMPACT) != 0;
+    writer.error = 0;
+
+    write_document(&writer, root);
+    writer_put(&writer, "", 1);
+
+    if (writer.error) {
+        free(writer.data);
         return NULL;
     }
 
-    char* html_string = (char*)malloc(file_size + 1);
+    if (length) *length = writer.size - 1;
+    return writer.data;
+}
 
-    if (!html_string) {
-        fclose(temp_file);
-        return NULL;
+int write_pretty_html(HTMLNode* root, const char* filename) {
+    if (!root || !filename) return 0;
+    FILE* file = fopen(filename, "w");
+
+    if (!file) {
+        fprintf(stderr, "Error: Could not open file %s for writing.\n", filename);
+        return 0;
     }
 
-    size_t bytes_read = fread(html_string, 1, file_size, temp_file);
-    html_string[bytes_read] = '\0';
+    /* whole buffers go to the file, stdio adds no copy of its own */
+    setvbuf(file, NULL, _IONBF, 0);
+    const int result = html2tex_serialize(root, 0, html2tex_file_sink, file);
 
-    fclose(temp_file);
-    return html_string;
-}
\ No newline at end of file
+    if (fclose(file) != 0 || result != 0) return 0;
+    return 1;
+}
+
+char* get_pretty_html(HTMLNode* root) {
+    return html2tex_serialize_string(root, 0, NULL);
+}
@@ -2,12 +2,40 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <limits.h>
 #include <ctype.h>
 
 #define INITIAL_CAPACITY 1024
 #define GROWTH_FACTOR 2
 
+void html2tex_flush_output(LaTeXConverter* converter) {
+    if (!converter || !converter->sink || converter->output_size == 0)
+        return;
+
+    size_t written = converter->sink(converter->sink_context,
+        converter->output, converter->output_size);
+
+    if (written != converter->output_size && !converter->error_code) {
+        converter->error_code = 13;
+        strncpy(converter->error_message,
+            "Output sink write failed.",
+            sizeof(converter->error_message) - 1);
+    }
+
+    /* the buffer is reused from the start either way */
+    converter->output_size = 0;
+    converter->output[0] = '\0';
+}
+
 static void ensure_capacity(LaTeXConverter* converter, size_t needed) {
+    /* a streaming converter drains its buffer instead of growing it */
+    if (converter->sink && converter->output_size > 0 &&
+        converter->output_size + needed >= HTML2TEX_SINK_BUFFER_SIZE) {
+        html2tex_flush_output(converter);
+        if (converter->error_code) return;
+    }
+
     /* already enough capacity */
     if (converter->output_capacity - converter->output_size > needed)
         return;
@@ -88,7 +116,10 @@ void append_string(LaTeXConverter* converter, const char* str) {
         return;
     }
 
-    size_t len = strlen(str);
+    append_string_len(converter, str, strlen(str));
+}
+
+void append_string_len(LaTeXConverter* converter, const char* str, size_t len) {
     if (len == 0) return;
 
     ensure_capacity(converter, len + 1);
@@ -102,18 +133,6 @@ void append_string(LaTeXConverter* converter, const char* str) {
     converter->output_size += len;
 }
 
-/* Append a single character to the LaTeX output buffer. */
-static void append_char(LaTeXConverter* converter, char c) {
-    if (!converter) return;
-    ensure_capacity(converter, 2);
-
-    if (converter->error_code) return;
-    char* dest = converter->output + converter->output_size;
-
-    *dest++ = c; *dest = '\0';
-    converter->output_size++;
-}
-
 static void escape_latex_special(LaTeXConverter* converter, const char* text) {
     if (!text || !converter) return;
 
@@ -130,51 +149,30 @@ static void escape_latex_special(LaTeXConverter* converter, const char* text) {
         "\\textgreater{}", "\\\\"
     };
 
-    const char* p = text;
-    const char* start = p;
+    const size_t length = strlen(text);
+    size_t start = 0, pos = 0;
 
-    while (*p) {
-        unsigned char c = (unsigned char)*p;
-        unsigned char type = SPECIAL_SP[c];
+    /* the kernel skips whole runs of plain text, the table sorts out what it stops at */
+    while ((pos += html2tex_scan_latex(text + pos, length - pos)) < length) {
+        unsigned char type = SPECIAL_SP[(unsigned char)text[pos]];
 
         if (type == 0) {
-            p++;
+            pos++;
             continue;
         }
 
-        if (p > start) {
-            /* copy normal characters before special */
-            size_t normal_len = p - start;
-
-            ensure_capacity(converter, normal_len);
-            if (converter->error_code) return;
-
-            char* dest = converter->output + converter->output_size;
-            memcpy(dest, start, normal_len);
-
-            converter->output_size += normal_len;
-            converter->output[converter->output_size] = '\0';
-        }
+        /* copy normal characters before special */
+        append_string_len(converter, text + start, pos - start);
+        if (converter->error_code) return;
 
         /* append the escaped sequence */
         append_string(converter, ESCAPED_SP[type]);
         if (converter->error_code) return;
-        p++; start = p;
+        start = ++pos;
     }
 
-    if (p > start) {
-        /* copy remaining normal characters */
-        size_t remaining_len = p - start;
-
-        ensure_capacity(converter, remaining_len);
-        if (converter->error_code) return;
-
-        char* dest = converter->output + converter->output_size;
-        memcpy(dest, start, remaining_len);
-
-        converter->output_size += remaining_len;
-        converter->output[converter->output_size] = '\0';
-    }
+    /* copy remaining normal characters */
+    append_string_len(converter, text + start, length - start);
 }
 
 static void escape_latex(LaTeXConverter* converter, const char* text) {
@@ -194,181 +192,30 @@ static void escape_latex(LaTeXConverter* converter, const char* text) {
         "\\textless{}", "\\textgreater{}", "\\\\"
     };
 
-    const char* p = text;
-    const char* start = p;
+    const size_t length = strlen(text);
+    size_t start = 0, pos = 0;
 
-    while (*p) {
-        unsigned char c = (unsigned char)*p;
-        unsigned char type = key[c];
+    /* plain runs are found by the scan kernel and copied in one piece */
+    while ((pos += html2tex_scan_latex(text + pos, length - pos)) < length) {
+        unsigned char type = key[(unsigned char)text[pos]];
 
         if (type == 0) {
-            p++;
+            pos++;
             continue;
         }
 
-        if (p > start) {
-            /* copy normal characters before special */
-            size_t normal_len = p - start;
-
-            ensure_capacity(converter, normal_len);
-            if (converter->error_code) return;
-
-            char* dest = converter->output + converter->output_size;
-            memcpy(dest, start, normal_len);
-
-            converter->output_size += normal_len;
-            converter->output[converter->output_size] = '\0';
-        }
+        /* copy normal characters before special */
+        append_string_len(converter, text + start, pos - start);
+        if (converter->error_code) return;
 
         /* append escaped sequence */
         append_string(converter, value[type]);
         if (converter->error_code) return;
-        p++; start = p;
-    }
-
-    if (p > start) {
-        /* copy remaining normal characters */
-        size_t remaining_len = p - start;
-
-        ensure_capacity(converter, remaining_len);
-        if (converter->error_code) return;
-
-        char* dest = converter->output + converter->output_size;
-        memcpy(dest, start, remaining_len);
-
-        converter->output_size += remaining_len;
-        converter->output[converter->output_size] = '\0';
-    }
-}
-
-static void convert_node(LaTeXConverter* converter, HTMLNode* node);
-
-void convert_children(LaTeXConverter* converter, HTMLNode* node) {
-    HTMLNode* child = node->children;
-
-    while (child) {
-        convert_node(converter, child);
-        child = child->next;
-    }
-}
-
-static void begin_environment(LaTeXConverter* converter, const char* env) {
-    if (!converter || !env) {
-        if (converter) {
-            converter->error_code = 5;
-            strncpy(converter->error_message,
-                "NULL parameter to begin_environment() function.",
-                sizeof(converter->error_message) - 1);
-        }
-
-        return;
-    }
-
-    append_string(converter, "\\begin{");
-    if (converter->error_code) return;
-
-    append_string(converter, env);
-    if (converter->error_code) return;
-    append_string(converter, "}\n");
-}
-
-static void end_environment(LaTeXConverter* converter, const char* env) {
-    if (!converter || !env) {
-        if (converter) {
-            converter->error_code = 6;
-            strncpy(converter->error_message,
-                "NULL parameter to end_environment() function.",
-                sizeof(converter->error_message) - 1);
-        }
-
-        return;
-    }
-
-    append_string(converter, "\\end{");
-    if (converter->error_code) return;
-
-    append_string(converter, env);
-    if (converter->error_code) return;
-    append_string(converter, "}\n");
-}
-
-static char* extract_color_from_style(const char* style, const char* property) {
-    if (!style || !property || !*property) return NULL;
-    const char* p = style;
-
-    /* skip leading whitespace */
-    size_t prop_len = strlen(property);
-
-    while (*p) {
-        while (*p && (*p == ' ' || *p == '\t')) p++;
-        if (!*p) break;
-
-        /* find property end */
-        const char* prop_start = p;
-        while (*p && *p != ':' && *p != ';' && !(*p == ' ' || *p == '\t')) p++;
-
-        /* check if we have a match */
-        size_t current_prop_len = p - prop_start;
-
-        if (current_prop_len == prop_len &&
-            strncmp(prop_start, property, prop_len) == 0) {
-
-            /* skip to value */
-            while (*p && *p != ':') p++;
-            if (!*p) break; p++;
-
-            /* skip whitespace before value */
-            while (*p && (*p == ' ' || *p == '\t')) p++;
-            if (!*p) break;
-
-            /* find value end */
-            const char* value_start = p;
-            const char* value_end = p;
-
-            while (*p && *p != ';') {
-                if (*p != ' ' && *p != '\t')
-                    value_end = p + 1;
-                
-                p++;
-            }
-
-            /* remove !important from value */
-            const char* important_pos = NULL;
-
-            for (const char* v = value_start; v < value_end; v++) {
-                if (v + 9 <= value_end && strncasecmp(v, "!important", 9) == 0) {
-                    important_pos = v;
-                    break;
-                }
-            }
-
-            if (important_pos) {
-                /* trim trailing whitespace after !important removal */
-                value_end = important_pos;
-                
-                while (value_end > value_start && (value_end[-1] == ' ' || value_end[-1] == '\t'))
-                    value_end--;
-            }
-
-            /* extract the value */
-            if (value_end > value_start) {
-                size_t value_len = value_end - value_start;
-                char* result = (char*)malloc(value_len + 1);
-
-                if (result) {
-                    memcpy(result, value_start, value_len);
-                    result[value_len] = '\0';
-                    return result;
-                }
-            }
-        }
-
-        /* skip to the next property */
-        while (*p && *p != ';') p++;
-        if (*p == ';') p++;
+        start = ++pos;
     }
 
-    return NULL;
+    /* copy remaining normal characters */
+    append_string_len(converter, text + start, length - start);
 }
 
 static char* color_to_hex(const char* color_value) {
@@ -464,7 +311,7 @@ static char* color_to_hex(const char* color_value) {
     /* case-insensitive lookup for named colors */
     for (int i = 0; named_colors[i].name; i++) {
         if (strcasecmp(color_value, named_colors[i].name) == 0)
-            return strdup(named_colors[i].hex);
+            return html2tex_strdup(named_colors[i].hex);
     }
 
     /* unknown format, return NULL for safety */
@@ -718,82 +565,31 @@ static void end_table_row(LaTeXConverter* converter) {
     }
 }
 
-static void begin_table_cell(LaTeXConverter* converter, int is_header) {
-    if (!converter) {
-        fprintf(stderr, "Error: NULL converter in begin_table_cell() function.\n");
-        return;
-    }
-
-    converter->state.in_table_cell = 1;
-    converter->state.current_column++;
-
-    if (converter->state.current_column > 1)
-        append_string(converter, " & ");
-
-    if (is_header)
-        append_string(converter, "\\textbf{");
-}
-
-static void end_table_cell(LaTeXConverter* converter, int is_header) {
-    if (!converter) {
-        fprintf(stderr, "Error: NULL converter in end_table_cell() function.\n");
-        return;
-    }
-
-    if (is_header)
-        append_string(converter, "}");
-
-    converter->state.in_table_cell = 0;
-}
-
 int count_table_columns(HTMLNode* node) {
     /* validate input */
     if (!node) return 1;
     int max_columns = 0;
 
-    NodeQueue* front = NULL;
-    NodeQueue* rear = NULL;
-
-    /* initialize BFS queue with the node */
-    if (!queue_enqueue(&front, &rear, node))
-        return 1;
-
-    /* BFS traversal for table structure */
-    while (front) {
-        HTMLNode* current = queue_dequeue(&front, &rear);
-        if (!current) continue;
-
-        /* process all children of current node */
-        HTMLNode* child = current->children;
+    /* rows of the table and of its sections, nested ones included */
+    HTMLNode* child = html2tex_dom_next(node, node, 1);
 
-        while (child) {
-            /* skip non-tag nodes */
-            if (!child->tag) {
-                child = child->next;
-                continue;
-            }
+    while (child) {
+        int descend = 0;
 
-            /* fast tag identification using first char */
-            char first_char = child->tag[0];
-
-            /* skip caption elements immediately */
-            if (first_char == 'c' && strcmp(child->tag, "caption") == 0) {
-                child = child->next;
-                continue;
-            }
+        if (child->tag) {
+            const int tag_id = html2tex_node_tag(child);
 
             /* check for row element */
-            if (first_char == 't' && strcmp(child->tag, "tr") == 0) {
+            if (tag_id == HTML2TEX_TAG_TR) {
                 int row_columns = 0;
                 HTMLNode* cell = child->children;
 
                 /* count cells in this row with colspan support */
                 while (cell) {
                     if (cell->tag) {
-                        char cell_first_char = cell->tag[0];
+                        const int cell_tag = html2tex_node_tag(cell);
 
-                        /* check for td or th with single comparison */
-                        if ((cell_first_char == 't' && (strcmp(cell->tag, "td") == 0 || strcmp(cell->tag, "th") == 0))) {
+                        if (cell_tag == HTML2TEX_TAG_TD || cell_tag == HTML2TEX_TAG_TH) {
                             int colspan = 1;
 
                             /* check for colspan attribute */
@@ -830,34 +626,14 @@ int count_table_columns(HTMLNode* node) {
                 if (row_columns > max_columns)
                     max_columns = row_columns;
             }
-            /* handle table sections with BFS */
-            else if (first_char == 't' || first_char == 'h' || first_char == 'f') {
-                if (strcmp(child->tag, "thead") == 0 ||
-                    strcmp(child->tag, "tbody") == 0 ||
-                    strcmp(child->tag, "tfoot") == 0) {
-
-                    /* enqueue section for processing */
-                    if (!queue_enqueue(&front, &rear, child)) {
-                        queue_cleanup(&front, &rear);
-                        return max_columns > 0 ? max_columns : 1;
-                    }
-                }
-            }
-            /* handle direct table children that might contain rows */
-            else if (first_char == 't' && strcmp(child->tag, "table") == 0) {
-                /* Nested table, process it independently */
-                int nested_columns = count_table_columns(child);
-
-                if (nested_columns > max_columns)
-                    max_columns = nested_columns;
-            }
-
-            child = child->next;
+            /* table sections hold rows of their own */
+            else if (tag_id == HTML2TEX_TAG_THEAD || tag_id == HTML2TEX_TAG_TBODY ||
+                tag_id == HTML2TEX_TAG_TFOOT)
+                descend = 1;
         }
-    }
 
-    /* cleanup queue */
-    queue_cleanup(&front, &rear);
+        child = html2tex_dom_next(node, child, descend);
+    }
 
     /* return at least 1 column for valid tables */
     return max_columns > 0 ? max_columns : 1;
@@ -970,7 +746,7 @@ void process_table_image(LaTeXConverter* converter, HTMLNode* img_node) {
 
     if (converter->download_images && converter->image_output_dir) {
         converter->image_counter++;
-        image_path = download_image_src(src, converter->image_output_dir,
+        image_path = image_downloader_fetch(converter->downloader, converter->image_cache, src, converter->image_output_dir,
             converter->image_counter);
 
         /* check if path starts with output directory */
@@ -983,32 +759,29 @@ void process_table_image(LaTeXConverter* converter, HTMLNode* img_node) {
 
     /* use original source if download failed or not enabled */
     if (!image_path) {
-        image_path = strdup(src);
+        image_path = html2tex_strdup(src);
         if (!image_path) return;
     }
 
     /* parse CSS style once and reuse */
-    CSSProperties* img_css = NULL;
     int width_pt = 0, height_pt = 0;
 
     int has_background = 0;
-    char* bg_hex_color = NULL;
+    char bg_hex_color[8];
     const char* style_attr = get_attribute(img_node->attributes, "style");
 
     if (style_attr) {
-        img_css = parse_css_style(style_attr);
-        if (img_css) {
-            /* process dimensions from CSS first */
-            if (img_css->width) width_pt = css_length_to_pt(img_css->width);
-            if (img_css->height) height_pt = css_length_to_pt(img_css->height);
-
-            /* process background color */
-            if (img_css->background_color) {
-                bg_hex_color = css_color_to_hex(img_css->background_color);
-
-                if (bg_hex_color && strcmp(bg_hex_color, "FFFFFF") != 0)
-                    has_background = 1;
-            }
+        CSSProperties img_css;
+        parse_css_style_into(style_attr, &img_css);
+
+        /* process dimensions from CSS first */
+        if (img_css.present & HTML2TEX_CSS_WIDTH) width_pt = img_css.width;
+        if (img_css.present & HTML2TEX_CSS_HEIGHT) height_pt = img_css.height;
+
+        /* process background color, white needs no box */
+        if ((img_css.present & HTML2TEX_CSS_BACKGROUND_COLOR) && img_css.background_color != 0xFFFFFF) {
+            snprintf(bg_hex_color, sizeof(bg_hex_color), "%06X", img_css.background_color & 0xFFFFFFu);
+            has_background = 1;
         }
     }
 
@@ -1027,7 +800,7 @@ void process_table_image(LaTeXConverter* converter, HTMLNode* img_node) {
     size_t fixed_parts_len = 0;
 
     /* background colorbox opening */
-    if (has_background && bg_hex_color)
+    if (has_background)
         fixed_parts_len += 24;
 
     /* graphics command */
@@ -1074,7 +847,7 @@ void process_table_image(LaTeXConverter* converter, HTMLNode* img_node) {
     char* dest = converter->output + converter->output_size;
 
     /* background colorbox, if any */
-    if (has_background && bg_hex_color) {
+    if (has_background) {
         memcpy(dest, "\\colorbox[HTML]{", 16); dest += 16;
         memcpy(dest, bg_hex_color, 6); dest += 6;
         memcpy(dest, "}{", 2); dest += 2;
@@ -1116,8 +889,6 @@ void process_table_image(LaTeXConverter* converter, HTMLNode* img_node) {
 
 cleanup:
     if (image_path) free(image_path);
-    if (bg_hex_color) free(bg_hex_color);
-    if (img_css) free_css_properties(img_css);
 }
 
 void append_figure_caption(LaTeXConverter* converter, HTMLNode* table_node) {
@@ -1132,8 +903,7 @@ void append_figure_caption(LaTeXConverter* converter, HTMLNode* table_node) {
     HTMLNode* child = table_node->children;
 
     while (child) {
-        if (child->tag && child->tag[0] == 'c' &&
-            strcmp(child->tag, "caption") == 0) {
+        if (html2tex_node_tag(child) == HTML2TEX_TAG_CAPTION) {
             caption = child;
             break;
         }
@@ -1193,162 +963,146 @@ void append_figure_caption(LaTeXConverter* converter, HTMLNode* table_node) {
     append_string(converter, "}\n");
 }
 
-void convert_node(LaTeXConverter* converter, HTMLNode* node) {
-    if (!node) return;
+/* An element whose children are being converted, with what closing it needs. */
+typedef struct {
+    HTMLNode* node;
+    int tag_id;
 
-    /* skip nested tables and all their content */
-    if (should_skip_nested_table(node))
-        return;
+    /* the element opened a group of its own, closed after the children */
+    int wrapped;
+    int saved_css_braces;
+
+    /* sibling to continue with once the element is closed */
+    HTMLNode* next;
+
+    int has_css;
+    CSSProperties css;
+} ConvertFrame;
+
+/* Writes what comes before the children of a node. Returns 1 when the children
+   follow and close_element finishes the node, 0 when the node is done. */
+static int open_element(LaTeXConverter* converter, HTMLNode* node, ConvertFrame* frame) {
+    if (!node) return 0;
+
+    /* skip nested tables and all their content; the flag is precomputed and
+       an ancestor is never flagged here, since its whole subtree was skipped */
+    if (node->flags & HTML2TEX_NODE_NESTED_TABLE)
+        return 0;
 
     /* handle text nodes - including those with only whitespace */
     if (!node->tag && node->content) {
         escape_latex(converter, node->content);
-        return;
+        return 0;
     }
 
-    if (!node->tag) return;
+    if (!node->tag) return 0;
+    const int tag_id = html2tex_node_tag(node);
 
     /* skip excluded elements and all their child elements completely */
-    if (node->tag && should_exclude_tag(node->tag))
-        return;
+    if (html2tex_tag_flags(tag_id) & HTML2TEX_TAG_IS_EXCLUDED)
+        return 0;
+
+    frame->node = node;
+    frame->tag_id = tag_id;
+    frame->wrapped = 0;
 
     // CSS properties parsing and application
     CSSProperties* css_props = NULL;
+    const char* css_style = NULL;
 
     // skip CSS processing for caption nodes in tables to prevent state leakage
-    if (!(converter->state.in_table && node->tag && strcmp(node->tag, "caption") == 0)) {
-        const char* style_attr = get_attribute(node->attributes, "style");
-        if (style_attr) css_props = parse_css_style(style_attr);
+    if (!(converter->state.in_table && tag_id == HTML2TEX_TAG_CAPTION)) {
+        css_style = get_attribute(node->attributes, "style");
 
-        /* apply CSS properties before element content */
-        if (css_props) apply_css_properties(converter, css_props, node->tag);
+        /* apply CSS properties before element content, repeated styles come from the cache */
+        if (css_style) css_props = apply_css_style(converter, css_style, tag_id, &frame->css);
     }
 
+    frame->has_css = css_props != NULL;
+
     /* handle different HTML tags */
-    if (strcmp(node->tag, "p") == 0) {
+    switch (tag_id) {
+    case HTML2TEX_TAG_P:
         append_string(converter, "\n");
-        convert_children(converter, node);
-        append_string(converter, "\n\n");
-    }
-    else if (strcmp(node->tag, "h1") == 0) {
+        return 1;
+    case HTML2TEX_TAG_H1:
         append_string(converter, "\\section{");
-        convert_children(converter, node);
-        append_string(converter, "}\n\n");
-    }
-    else if (strcmp(node->tag, "h2") == 0) {
+        return 1;
+    case HTML2TEX_TAG_H2:
         append_string(converter, "\\subsection{");
-        convert_children(converter, node);
-        append_string(converter, "}\n\n");
-    }
-    else if (strcmp(node->tag, "h3") == 0) {
+        return 1;
+    case HTML2TEX_TAG_H3:
         append_string(converter, "\\subsubsection{");
-        convert_children(converter, node);
-        append_string(converter, "}\n\n");
-    }
-    else if (strcmp(node->tag, "b") == 0 || strcmp(node->tag, "strong") == 0) {
+        return 1;
+    case HTML2TEX_TAG_B: case HTML2TEX_TAG_STRONG:
         /* only apply bold if CSS hasn't already applied it */
-        if (!converter->state.has_bold) {
-            append_string(converter, "\\textbf{");
-            convert_children(converter, node);
-            append_string(converter, "}");
-        }
-        else {
-            /* CSS already applied bold, just convert children */
-            convert_children(converter, node);
-            /* don't reset the bold flag here - let the parent element handle it */
-            /* this prevents premature resetting of CSS state */
-        }
-    }
-    else if (strcmp(node->tag, "i") == 0 || strcmp(node->tag, "em") == 0) {
+        frame->wrapped = !converter->state.has_bold;
+        if (frame->wrapped) append_string(converter, "\\textbf{");
+        return 1;
+    case HTML2TEX_TAG_I: case HTML2TEX_TAG_EM:
         /* only apply italic if CSS hasn't already applied it */
-        if (!converter->state.has_italic) {
-            append_string(converter, "\\textit{");
-            convert_children(converter, node);
-            append_string(converter, "}");
-        }
-        else {
-            /* CSS already applied italic, just convert children */
-            convert_children(converter, node);
-
-            /* reset the italic flag */
-            converter->state.has_italic = 0;
-        }
-    }
-    else if (strcmp(node->tag, "u") == 0) {
+        frame->wrapped = !converter->state.has_italic;
+        if (frame->wrapped) append_string(converter, "\\textit{");
+        return 1;
+    case HTML2TEX_TAG_U:
         append_string(converter, "\\underline{");
-        convert_children(converter, node);
-        append_string(converter, "}");
-    }
-    else if (strcmp(node->tag, "code") == 0) {
+        return 1;
+    case HTML2TEX_TAG_CODE:
         append_string(converter, "\\texttt{");
-        convert_children(converter, node);
-        append_string(converter, "}");
-    }
-    else if (strcmp(node->tag, "font") == 0) {
+        return 1;
+    case HTML2TEX_TAG_FONT: {
         /* parse color attribute and style background-color */
         const char* color_attr = get_attribute(node->attributes, "color");
-        const char* style_attr = get_attribute(node->attributes, "style");
-        char* text_color = NULL;
 
-        /* extract text color from style if present */
-        if (style_attr)
-            text_color = extract_color_from_style(style_attr, "color");
+        /* text color from style if present */
+        const int text_color = css_props && (css_props->present & HTML2TEX_CSS_COLOR);
 
-        if (css_props && text_color) {
-            /* ignore the color attribute, just convert content */
-            convert_children(converter, node);
-        }
-        else if (css_props && !text_color) {
+        /* with a style color, ignore the color attribute, just convert content */
+        if (css_props && text_color)
+            return 1;
+
+        if (css_props && !text_color) {
             /* inline CSS exists, but do not contain color property */
             if (color_attr) apply_color(converter, color_attr, 0);
 
-            convert_children(converter, node);
-            append_string(converter, "}");
+            frame->wrapped = 1;
+            return 1;
         }
-
-        /* clean up allocated memory */
-        if (text_color) free(text_color);
+        break;
     }
-    else if (strcmp(node->tag, "span") == 0)
+    case HTML2TEX_TAG_SPAN:
         /* CSS properties handle styling, just convert content */
-        convert_children(converter, node);
-    else if (strcmp(node->tag, "a") == 0) {
+        return 1;
+    case HTML2TEX_TAG_A: {
         const char* href = get_attribute(node->attributes, "href");
 
         if (href) {
             append_string(converter, "\\href{");
             escape_latex(converter, href);
             append_string(converter, "}{");
-
-            convert_children(converter, node);
-            append_string(converter, "}");
+            frame->wrapped = 1;
         }
-        else
-            convert_children(converter, node);
+        return 1;
     }
-    else if (strcmp(node->tag, "ul") == 0) {
+    case HTML2TEX_TAG_UL:
         append_string(converter, "\\begin{itemize}\n");
-        convert_children(converter, node);
-        append_string(converter, "\\end{itemize}\n");
-    }
-    else if (strcmp(node->tag, "ol") == 0) {
+        return 1;
+    case HTML2TEX_TAG_OL:
         append_string(converter, "\\begin{enumerate}\n");
-        convert_children(converter, node);
-        append_string(converter, "\\end{enumerate}\n");
-    }
-    else if (strcmp(node->tag, "li") == 0) {
+        return 1;
+    case HTML2TEX_TAG_LI:
         append_string(converter, "\\item ");
-        convert_children(converter, node);
-        append_string(converter, "\n");
-    }
-    else if (strcmp(node->tag, "br") == 0)
+        return 1;
+    case HTML2TEX_TAG_BR:
         append_string(converter, "\\\\\n");
-    else if (strcmp(node->tag, "hr") == 0)
+        break;
+    case HTML2TEX_TAG_HR:
         append_string(converter, "\\hrulefill\n\n");
-    else if (strcmp(node->tag, "div") == 0)
-        convert_children(converter, node);
+        break;
+    case HTML2TEX_TAG_DIV:
+        return 1;
     /* image support */
-    else if (strcmp(node->tag, "img") == 0) {
+    case HTML2TEX_TAG_IMG:
         /* check if image is inside a table */
         if (is_inside_table(node)) {
             /* skip figure environment for images inside tables */
@@ -1363,10 +1117,10 @@ void convert_node(LaTeXConverter* converter, HTMLNode* node) {
 
                 if (converter->download_images && converter->image_output_dir) {
                     converter->image_counter++;
-                    image_path = download_image_src(src, converter->image_output_dir, converter->image_counter);
+                    image_path = image_downloader_fetch(converter->downloader, converter->image_cache, src, converter->image_output_dir, converter->image_counter);
                 }
 
-                if (!image_path) image_path = strdup(src);
+                if (!image_path) image_path = html2tex_strdup(src);
 
                 /* convert to simple includegraphics without figure */
                 append_string(converter, "\\includegraphics");
@@ -1379,11 +1133,11 @@ void convert_node(LaTeXConverter* converter, HTMLNode* node) {
                 if (height_attr) height_pt = css_length_to_pt(height_attr);
 
                 if (style_attr) {
-                    CSSProperties* img_css = parse_css_style(style_attr);
-                    if (img_css && img_css->width) width_pt = css_length_to_pt(img_css->width);
+                    CSSProperties img_css;
+                    parse_css_style_into(style_attr, &img_css);
 
-                    if (img_css && img_css->height) height_pt = css_length_to_pt(img_css->height);
-                    free_css_properties(img_css);
+                    if (img_css.present & HTML2TEX_CSS_WIDTH) width_pt = img_css.width;
+                    if (img_css.present & HTML2TEX_CSS_HEIGHT) height_pt = img_css.height;
                 }
 
                 if (width_pt > 0 || height_pt > 0) {
@@ -1418,12 +1172,10 @@ void convert_node(LaTeXConverter* converter, HTMLNode* node) {
                 free(image_path);
             }
 
-            if (css_props) {
+            if (css_props)
                 end_css_properties(converter, css_props, node->tag);
-                free_css_properties(css_props);
-            }
 
-            return;
+            return 0;
         }
         else {
             converter->image_counter++;
@@ -1441,16 +1193,16 @@ void convert_node(LaTeXConverter* converter, HTMLNode* node) {
 
                 /* download image if enabled and we have a directory */
                 if (converter->download_images && converter->image_output_dir)
-                    image_path = download_image_src(src, converter->image_output_dir, converter->image_counter);
+                    image_path = image_downloader_fetch(converter->downloader, converter->image_cache, src, converter->image_output_dir, converter->image_counter);
 
                 /* if download failed or not enabled, use original src */
                 if (!image_path) {
                     /* force download for base64 images */
                     if (is_base64_image(src) && converter->download_images && converter->image_output_dir)
-                        image_path = download_image_src(src, converter->image_output_dir, converter->image_counter);
+                        image_path = image_downloader_fetch(converter->downloader, converter->image_cache, src, converter->image_output_dir, converter->image_counter);
 
                     /* use original source path */
-                    if (!image_path) image_path = strdup(src);
+                    if (!image_path) image_path = html2tex_strdup(src);
                 }
 
                 /* start figure environment */
@@ -1465,8 +1217,8 @@ void convert_node(LaTeXConverter* converter, HTMLNode* node) {
 
                 /* check if CSS style overrides width/height */
                 if (css_props) {
-                    if (css_props->width) width_pt = css_length_to_pt(css_props->width);
-                    if (css_props->height) height_pt = css_length_to_pt(css_props->height);
+                    if (css_props->present & HTML2TEX_CSS_WIDTH) width_pt = css_props->width;
+                    if (css_props->present & HTML2TEX_CSS_HEIGHT) height_pt = css_props->height;
                 }
 
                 /* fall back to attribute values if CSS didn't provide dimensions */
@@ -1558,56 +1310,28 @@ void convert_node(LaTeXConverter* converter, HTMLNode* node) {
                 /* end figure environment */
                 append_string(converter, "\\end{figure}\n");
                 append_string(converter, "\\FloatBarrier\n\n");
+                free(image_path);
             }
         }
-    }
+        break;
     /* table support */
-    else if (strcmp(node->tag, "table") == 0) {
+    case HTML2TEX_TAG_TABLE:
         if (table_contains_only_images(node)) {
             convert_image_table(converter, node);
 
-            if (css_props) {
+            if (css_props)
                 end_css_properties(converter, css_props, node->tag);
-                free_css_properties(css_props);
-            }
-            return;
+            return 0;
         }
-        else {
-            /* reset CSS state before table */
-            reset_css_state(converter);
-            int columns = count_table_columns(node);
-            begin_table(converter, columns);
 
-            /* convert all children including caption */
-            HTMLNode* child = node->children;
-
-            while (child) {
-                convert_node(converter, child);
-                child = child->next;
-            }
-
-            const char* table_id = get_attribute(node->attributes, "id");
-
-            /* reset CSS state after table */
-            if (table_id && table_id[0] != '\0')
-                end_table(converter, table_id);
-            else {
-                char table_label[64];
-                char label_counter[32];
-
-                html2tex_itoa(converter->state.table_internal_counter, 
-                    label_counter, 10);
-
-                strcpy(table_label, "table_");
-                strcpy(table_label + 6, label_counter);
-                end_table(converter, table_label);
-            }
+        /* reset CSS state before table */
+        reset_css_state(converter);
+        begin_table(converter, count_table_columns(node));
 
-            reset_css_state(converter);
-        }
-    }
+        /* convert all children including caption */
+        return 1;
     // added explicit caption handling
-    else if (strcmp(node->tag, "caption") == 0) {
+    case HTML2TEX_TAG_CAPTION:
         /* handle table caption */
         if (converter->state.in_table) {
             /* free any existing caption */
@@ -1622,35 +1346,35 @@ void convert_node(LaTeXConverter* converter, HTMLNode* node) {
 
             if (raw_caption) {
                 /* parse CSS properties separately without affecting converter state */
-                CSSProperties* css_props = NULL;
-
+                CSSProperties caption_css;
                 const char* style_attr = get_attribute(node->attributes, "style");
-                if (style_attr) css_props = parse_css_style(style_attr);
 
                 /* apply CSS formatting directly to caption without converter */
-                if (css_props) {
+                if (style_attr) {
+                    parse_css_style_into(style_attr, &caption_css);
                     size_t buffer_size = strlen(raw_caption) * 2 + 256;
                     char* formatted_caption = malloc(buffer_size);
 
                     if (formatted_caption) {
                         formatted_caption[0] = '\0';
 
-                        /* apply color if present */
-                        if (css_props->color) {
-                            char* hex_color = css_color_to_hex(css_props->color);
-                            if (hex_color && strcmp(hex_color, "000000") != 0) {
-                                strcat(formatted_caption, "\\textcolor[HTML]{");
-                                strcat(formatted_caption, hex_color);
-                                strcat(formatted_caption, "}{");
-                                free(hex_color);
-                            }
+                        /* apply color if present, black needs none */
+                        const int has_color = (caption_css.present & HTML2TEX_CSS_COLOR) &&
+                            caption_css.color != 0x000000;
+
+                        if (has_color) {
+                            char hex_color[8];
+                            snprintf(hex_color, sizeof(hex_color), "%06X", caption_css.color & 0xFFFFFFu);
+
+                            strcat(formatted_caption, "\\textcolor[HTML]{");
+                            strcat(formatted_caption, hex_color);
+                            strcat(formatted_caption, "}{");
                         }
 
                         /* apply bold if present */
                         int has_bold = 0;
-                        if (css_props->font_weight &&
-                            (strcmp(css_props->font_weight, "bold") == 0 ||
-                                strcmp(css_props->font_weight, "bolder") == 0)) {
+                        if ((caption_css.present & HTML2TEX_CSS_FONT_WEIGHT) &&
+                            caption_css.font_weight == HTML2TEX_WEIGHT_BOLD) {
                             strcat(formatted_caption, "\\textbf{");
                             has_bold = 1;
                         }
@@ -1662,19 +1386,13 @@ void convert_node(LaTeXConverter* converter, HTMLNode* node) {
                         if (has_bold)
                             strcat(formatted_caption, "}");
 
-                        if (css_props->color) {
-                            char* hex_color = css_color_to_hex(css_props->color);
-
-                            if (hex_color && strcmp(hex_color, "000000") != 0) {
-                                strcat(formatted_caption, "}");
-                                free(hex_color);
-                            }
-                        }
+                        if (has_color)
+                            strcat(formatted_caption, "}");
 
                         converter->state.table_caption = formatted_caption;
                     }
 
-                    free_css_properties(css_props);
+                    free(raw_caption);
                 }
                 else
                     /* no CSS, just use raw caption */
@@ -1683,16 +1401,14 @@ void convert_node(LaTeXConverter* converter, HTMLNode* node) {
 
             /* skip children conversion for caption in table */
             /* we already extracted the text, so don't process children normally */
-            return;
-        }
-        else {
-            /* If not in table, convert as normal text */
-            convert_children(converter, node);
+            return 0;
         }
-    }
-    else if (strcmp(node->tag, "thead") == 0 || strcmp(node->tag, "tbody") == 0 || strcmp(node->tag, "tfoot") == 0)
-        convert_children(converter, node);
-    else if (strcmp(node->tag, "tr") == 0) {
+
+        /* if not in table, convert as normal text */
+        return 1;
+    case HTML2TEX_TAG_THEAD: case HTML2TEX_TAG_TBODY: case HTML2TEX_TAG_TFOOT:
+        return 1;
+    case HTML2TEX_TAG_TR:
         /* reset CSS state for each row */
         reset_css_state(converter);
         converter->state.current_column = 0;
@@ -1703,57 +1419,127 @@ void convert_node(LaTeXConverter* converter, HTMLNode* node) {
 
         converter->state.pending_margin_bottom = 0;
         begin_table_row(converter);
-
-        convert_children(converter, node);
-        end_table_row(converter);
-    }
-    else if (strcmp(node->tag, "td") == 0 || strcmp(node->tag, "th") == 0) {
-        int is_header = (strcmp(node->tag, "th") == 0);
-
-        /* handle colspan */
-        const char* colspan_attr = get_attribute(node->attributes, "colspan");
-        int colspan = 1;
-
-        if (colspan_attr) {
-            colspan = atoi(colspan_attr);
-            if (colspan < 1) colspan = 1;
-        }
-
+        return 1;
+    case HTML2TEX_TAG_TD: case HTML2TEX_TAG_TH:
         /* add column separator if needed */
         if (converter->state.current_column > 0)
             append_string(converter, " & ");
 
         /* save current CSS brace count before processing this cell */
-        int saved_css_braces = converter->state.css_braces;
+        frame->saved_css_braces = converter->state.css_braces;
 
         /* apply CSS properties first - this will handle cellcolor for table cells */
-        if (css_props) apply_css_properties(converter, css_props, node->tag);
+        if (css_props) apply_css_style(converter, css_style, tag_id, &frame->css);
 
         /* handle header formatting - only if CSS hasn't already applied bold */
-        if (is_header && !converter->state.has_bold)
+        if (tag_id == HTML2TEX_TAG_TH && !converter->state.has_bold)
             append_string(converter, "\\textbf{");
 
         /* convert cell content */
         converter->state.in_table_cell = 1;
-        convert_children(converter, node);
+        return 1;
+    default:
+        /* unknown tag, just convert children */
+        return 1;
+    }
+
+    /* elements without content end here */
+    if (css_props)
+        end_css_properties(converter, css_props, node->tag);
+
+    return 0;
+}
+
+/* Writes what follows the children of an element opened by open_element. */
+static void close_element(LaTeXConverter* converter, ConvertFrame* frame) {
+    HTMLNode* node = frame->node;
+    const int tag_id = frame->tag_id;
+    CSSProperties* css_props = frame->has_css ? &frame->css : NULL;
+
+    switch (tag_id) {
+    case HTML2TEX_TAG_P:
+        append_string(converter, "\n\n");
+        break;
+    case HTML2TEX_TAG_H1: case HTML2TEX_TAG_H2: case HTML2TEX_TAG_H3:
+        append_string(converter, "}\n\n");
+        break;
+    case HTML2TEX_TAG_B: case HTML2TEX_TAG_STRONG:
+        /* when CSS applied bold, the parent element resets the flag */
+        if (frame->wrapped) append_string(converter, "}");
+        break;
+    case HTML2TEX_TAG_I: case HTML2TEX_TAG_EM:
+        if (frame->wrapped)
+            append_string(converter, "}");
+        else
+            /* CSS already applied italic, reset the flag */
+            converter->state.has_italic = 0;
+        break;
+    case HTML2TEX_TAG_U: case HTML2TEX_TAG_CODE:
+        append_string(converter, "}");
+        break;
+    case HTML2TEX_TAG_FONT: case HTML2TEX_TAG_A:
+        if (frame->wrapped) append_string(converter, "}");
+        break;
+    case HTML2TEX_TAG_UL:
+        append_string(converter, "\\end{itemize}\n");
+        break;
+    case HTML2TEX_TAG_OL:
+        append_string(converter, "\\end{enumerate}\n");
+        break;
+    case HTML2TEX_TAG_LI:
+        append_string(converter, "\n");
+        break;
+    case HTML2TEX_TAG_TABLE: {
+        const char* table_id = get_attribute(node->attributes, "id");
+
+        /* reset CSS state after table */
+        if (table_id && table_id[0] != '\0')
+            end_table(converter, table_id);
+        else {
+            char table_label[64];
+            char label_counter[32];
+
+            html2tex_itoa(converter->state.table_internal_counter, 
+                label_counter, 10);
+
+            strcpy(table_label, "table_");
+            strcpy(table_label + 6, label_counter);
+            end_table(converter, table_label);
+        }
+
+        reset_css_state(converter);
+        break;
+    }
+    case HTML2TEX_TAG_TR:
+        end_table_row(converter);
+        break;
+    case HTML2TEX_TAG_TD: case HTML2TEX_TAG_TH: {
         converter->state.in_table_cell = 0;
 
         /* end header formatting */
-        if (is_header && !converter->state.has_bold)
+        if (tag_id == HTML2TEX_TAG_TH && !converter->state.has_bold)
             append_string(converter, "}");
 
         /* close any braces that were opened by CSS for this specific cell */
-        int braces_opened_in_this_cell = converter->state.css_braces - saved_css_braces;
+        int braces_opened_in_this_cell = converter->state.css_braces - frame->saved_css_braces;
         for (int i = 0; i < braces_opened_in_this_cell; i++) {
             append_string(converter, "}");
         }
-        converter->state.css_braces = saved_css_braces;
+        converter->state.css_braces = frame->saved_css_braces;
 
         /* end CSS properties after cell content but BEFORE column separators */
         if (css_props) {
             end_css_properties(converter, css_props, node->tag);
-            free_css_properties(css_props);
-            css_props = NULL; /* prevent double-free later */
+            css_props = NULL; /* prevent ending them twice */
+        }
+
+        /* handle colspan */
+        const char* colspan_attr = get_attribute(node->attributes, "colspan");
+        int colspan = 1;
+
+        if (colspan_attr) {
+            colspan = atoi(colspan_attr);
+            if (colspan < 1) colspan = 1;
         }
 
         /* update column count for colspan */
@@ -1768,16 +1554,76 @@ void convert_node(LaTeXConverter* converter, HTMLNode* node) {
             /* empty cell for colspan */
             append_string(converter, " ");
         }
+        break;
+    }
+    default:
+        break;
     }
-    else
-        /* unknown tag, just convert children */
-        convert_children(converter, node);
 
-    /* end CSS properties after element content - but skip for table cells since we handle them separately */
-    if (css_props) {
-        if (!(strcmp(node->tag, "td") == 0 || strcmp(node->tag, "th") == 0))
-            end_css_properties(converter, css_props, node->tag);
-        
-        free_css_properties(css_props);
+    /* end CSS properties after element content */
+    if (css_props)
+        end_css_properties(converter, css_props, node->tag);
+}
+
+void convert_children(LaTeXConverter* converter, HTMLNode* node) {
+    if (!converter || !node) return;
+
+    /* open elements live on the heap, so deep documents cannot exhaust the C stack */
+    ConvertFrame* frames = NULL;
+    size_t capacity = 0;
+    size_t depth = 0;
+
+    HTMLNode* next = node->children;
+
+    for (;;) {
+        if (next) {
+            HTMLNode* current = next;
+            next = current->next;
+
+            if (depth == capacity) {
+                size_t new_capacity = capacity ? capacity * 2 : 32;
+                ConvertFrame* new_frames = (ConvertFrame*)realloc(frames, new_capacity * sizeof(ConvertFrame));
+
+                if (!new_frames) {
+                    converter->error_code = 3;
+                    strncpy(converter->error_message,
+                        "Memory reallocation failed.",
+                        sizeof(converter->error_message) - 1);
+                    break;
+                }
+
+                frames = new_frames;
+                capacity = new_capacity;
+            }
+
+            ConvertFrame* frame = &frames[depth];
+            if (!open_element(converter, current, frame)) continue;
+
+            if (!current->children) {
+                close_element(converter, frame);
+                continue;
+            }
+
+            if (converter->max_depth && depth >= converter->max_depth) {
+                converter->error_code = 14;
+                strncpy(converter->error_message,
+                    "Elements are nested deeper than the maximum depth.",
+                    sizeof(converter->error_message) - 1);
+                break;
+            }
+
+            frame->next = next;
+            next = current->children;
+            depth++;
+        }
+        else if (depth > 0) {
+            ConvertFrame* frame = &frames[--depth];
+            close_element(converter, frame);
+            next = frame->next;
+        }
+        else
+            break;
     }
-}
\ No newline at end of file
+
+    free(frames);
+}
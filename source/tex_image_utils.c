@@ -17,13 +17,18 @@
 #define fileno _fileno
 #define access _access
 #define F_OK 0
+
+#include <process.h>
+#define getpid _getpid
 #else
 #include <unistd.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <pthread.h>
 #endif
 
 #include <stdio.h>
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
@@ -78,31 +83,6 @@ static char* extract_mime_type(const char* base64_data) {
     return mime_type;
 }
 
-/* Extract base64 data from data URI. */
-static char* extract_base64_data(const char* base64_data) {
-    if (!base64_data) return NULL;
-    const char* base64_prefix = "base64,";
-
-    const char* data_start = strstr(base64_data, base64_prefix);
-    if (!data_start) return NULL;
-    data_start += strlen(base64_prefix);
-
-    /* remove any whitespace from base64 data */
-    size_t len = strlen(data_start);
-    char* clean_data = malloc(len + 1);
-
-    if (!clean_data) return NULL;
-    char* dest = clean_data;
-
-    for (const char* src = data_start; *src; src++)
-        if (!isspace(*src))
-            *dest++ = *src;
-
-    *dest = '\0';
-
-    return clean_data;
-}
-
 /* Get file extension from MIME type. */
 static const char* get_extension_from_mime_type(const char* mime_type) {
     if (!mime_type) return ".bin";
@@ -117,83 +97,84 @@ static const char* get_extension_from_mime_type(const char* mime_type) {
     else return ".bin";
 }
 
-/* Robust base64 decoding function. */
-static unsigned char* base64_decode(const char* data, size_t input_len, size_t* output_len) {
-    if (!data || input_len == 0) return NULL;
+/* Data URIs are decoded this many bytes at a time, straight into the image file. */
+#define BASE64_CHUNK 16384
 
-    /* invalid base64 string */
-    if (input_len % 4 != 0) return NULL;
-    *output_len = (input_len * 3) / 4;
+/* Decodes the data URI into filename without copying it; whitespace is skipped and
+   padding may only end the data. A failed decode leaves no file behind. */
+static int save_base64_image(const char* base64_data, const char* filename) {
+    if (!base64_data || !filename) return 0;
+    const char* data = strstr(base64_data, "base64,");
 
-    if (data[input_len - 1] == '=') (*output_len)--;
-    if (data[input_len - 2] == '=') (*output_len)--;
+    if (!data) return 0;
+    data += strlen("base64,");
 
-    unsigned char* decoded = malloc(*output_len);
-    if (!decoded) return NULL;
+    const size_t length = strlen(data);
+    FILE* file = fopen(filename, "wb");
+    if (!file) return 0;
 
-    const unsigned char* input = (const unsigned char*)data;
-    unsigned char* output = decoded;
+    unsigned char chunk[BASE64_CHUNK];
+    size_t used = 0, written = 0, i = 0;
 
-    for (size_t i = 0; i < input_len; ) {
-        unsigned long int sextet_a = input[i] == '=' ? 0 & i++ : base64_table[input[i++]];
-        unsigned long int sextet_b = input[i] == '=' ? 0 & i++ : base64_table[input[i++]];
+    /* characters of a group broken by whitespace or padding */
+    unsigned char group[4];
+    int held = 0, padding = 0, success = 1;
 
-        unsigned long int sextet_c = input[i] == '=' ? 0 & i++ : base64_table[input[i++]];
-        unsigned long int sextet_d = input[i] == '=' ? 0 & i++ : base64_table[input[i++]];
+    while (success) {
+        /* whole groups go through the vector decoder */
+        if (held == 0 && padding == 0) {
+            const size_t room = (BASE64_CHUNK - used) / 3 * 4;
+            const size_t consumed = html2tex_decode_base64(data + i, length - i < room ? length - i : room, chunk + used);
 
-        if (sextet_a == 0x80 || sextet_b == 0x80 || sextet_c == 0x80 || sextet_d == 0x80) {
-            free(decoded);
-            return NULL;
+            i += consumed;
+            used += consumed / 4 * 3;
         }
 
-        unsigned long int triple = (sextet_a << 3 * 6) + (sextet_b << 2 * 6) + (sextet_c << 1 * 6) + (sextet_d << 0 * 6);
-
-        if (output - decoded < (ptrdiff_t)(*output_len - 2))
-            *output++ = (triple >> 2 * 8) & 0xFF;
+        if (used + 3 > BASE64_CHUNK) {
+            success = fwrite(chunk, 1, used, file) == used;
+            written += used;
+            used = 0;
+        }
 
-        if (output - decoded < (ptrdiff_t)(*output_len - 1))
-            *output++ = (triple >> 1 * 8) & 0xFF;
+        if (i >= length) break;
+        const unsigned char c = (unsigned char)data[i++];
 
-        if (output - decoded < (ptrdiff_t)(*output_len))
-            *output++ = (triple >> 0 * 8) & 0xFF;
-    }
+        if (isspace(c)) continue;
 
-    return decoded;
-}
+        if (c == '=') {
+            /* at most two padding characters, after two of the group */
+            if (held < 2) success = 0;
+            padding++;
+        }
+        else if (padding || base64_table[c] == 0x80) success = 0;
 
-/* Decode base64 data and save to file. */
-static int save_base64_image(const char* base64_data, const char* filename) {
-    if (!base64_data || !filename) return 0;
-    char* clean_data = extract_base64_data(base64_data);
+        group[held++] = c == '=' ? 0 : base64_table[c];
 
-    if (!clean_data) return 0;
-    size_t input_len = strlen(clean_data);
+        if (held == 4) {
+            const unsigned long triple = (unsigned long)group[0] << 18 | (unsigned long)group[1] << 12 |
+                (unsigned long)group[2] << 6 | group[3];
 
-    if (input_len == 0) {
-        free(clean_data);
-        return 0;
+            chunk[used++] = (unsigned char)(triple >> 16);
+            if (padding < 2) chunk[used++] = (unsigned char)(triple >> 8);
+            if (padding < 1) chunk[used++] = (unsigned char)triple;
+            held = 0;
+        }
     }
 
-    size_t output_len = 0;
-    unsigned char* decoded_data = base64_decode(clean_data, input_len, &output_len);
-    free(clean_data);
-
-    if (!decoded_data || output_len == 0)
-        return 0;
+    if (success && used > 0) {
+        success = fwrite(chunk, 1, used, file) == used;
+        written += used;
+    }
 
-    /* write to file */
-    FILE* file = fopen(filename, "wb");
+    if (fclose(file) != 0) success = 0;
 
-    if (!file) {
-        free(decoded_data);
+    /* truncated data or no image at all */
+    if (!success || held != 0 || written == 0) {
+        remove(filename);
         return 0;
     }
 
-    size_t written = fwrite(decoded_data, 1, output_len, file);
-    fclose(file);
-
-    free(decoded_data);
-    return (written == output_len) ? 1 : 0;
+    return 1;
 }
 
 /* libcurl write callback */
@@ -201,6 +182,21 @@ static size_t write_data(void* ptr, size_t size, size_t nmemb, FILE* stream) {
     return fwrite(ptr, size, nmemb, stream);
 }
 
+/* Sets up a transfer of url into fp. */
+static void set_transfer_options(CURL* curl, const char* url, FILE* fp) {
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_data);
+
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, fp);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+
+    curl_easy_setopt(curl, CURLOPT_USERAGENT, "html2tex/1.0");
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L);
+
+    /* timeouts must not use signals when other threads convert too */
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+}
+
 /* Download image from URL using libcurl. */
 static int download_image_url(const char* url, const char* filename) {
     if (!url || !filename) return 0;
@@ -220,14 +216,7 @@ static int download_image_url(const char* url, const char* filename) {
         return 0;
     }
 
-    curl_easy_setopt(curl, CURLOPT_URL, url);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_data);
-
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, fp);
-    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-
-    curl_easy_setopt(curl, CURLOPT_USERAGENT, "html2tex/1.0");
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L);
+    set_transfer_options(curl, url, fp);
     res = curl_easy_perform(curl);
 
     if (res == CURLE_OK) {
@@ -248,7 +237,7 @@ static int create_directory_if_not_exists(const char* dir_path) {
 
     if (stat(dir_path, &st) == -1) {
         /* create directory recursively */
-        char* path_copy = strdup(dir_path);
+        char* path_copy = html2tex_strdup(dir_path);
 
         if (!path_copy) return -1;
         char* p = path_copy;
@@ -258,13 +247,18 @@ static int create_directory_if_not_exists(const char* dir_path) {
             p += 2;
 #endif
 
+        /* the root of an absolute path is not created */
+        while (*p == '/' || *p == '\\')
+            p++;
+
         while (*p) {
             if (*p == '/' || *p == '\\') {
                 char old_char = *p;
                 *p = '\0';
 
+                /* another thread may create the same parent meanwhile */
                 if (stat(path_copy, &st) == -1) {
-                    if (mkdir(path_copy) != 0) {
+                    if (mkdir(path_copy) != 0 && errno != EEXIST) {
                         free(path_copy);
                         return -1;
                     }
@@ -277,7 +271,7 @@ static int create_directory_if_not_exists(const char* dir_path) {
         }
 
         /* create the final directory */
-        if (mkdir(dir_path) != 0) {
+        if (mkdir(dir_path) != 0 && errno != EEXIST) {
             free(path_copy);
             return -1;
         }
@@ -492,9 +486,8 @@ static char* generate_unique_filename(const char* output_dir, const char* src, i
     return unique_name;
 }
 
-char* download_image_src(const char* src, const char* output_dir, int image_counter) {
-    if (!src || !output_dir) return NULL;
-
+/* Returns the path a new image from src is saved at, creating output_dir if needed. */
+static char* image_destination(const char* src, const char* output_dir, int image_counter) {
     /* create output directory if it does not exist */
     if (create_directory_if_not_exists(output_dir) != 0)
         return NULL;
@@ -506,35 +499,1255 @@ char* download_image_src(const char* src, const char* output_dir, int image_coun
     /* build full path */
     char* full_path = malloc(strlen(output_dir) + strlen(safe_filename) + 2);
 
-    if (!full_path) {
-        free(safe_filename);
+    if (full_path)
+        snprintf(full_path, strlen(output_dir) + strlen(safe_filename) + 2, "%s/%s", output_dir, safe_filename);
+
+    free(safe_filename);
+    return full_path;
+}
+
+char* download_image_src(const char* src, const char* output_dir, int image_counter) {
+    return image_downloader_fetch(NULL, NULL, src, output_dir, image_counter);
+}
+
+typedef enum {
+    FETCH_QUEUED,
+    FETCH_RUNNING,
+    FETCH_READY,
+    FETCH_FAILED,
+    FETCH_CLAIMED
+} FetchStatus;
+
+/* One remote image, downloaded to a temporary file until the conversion claims it. */
+typedef struct {
+    char* url;
+
+    /* temporary file, then the image it became once claimed */
+    char* path;
+
+    FILE* file;
+    CURL* handle;
+    int status;
+} ImageFetch;
+
+/* An image handed to the background pipeline, saved at path once fetched. */
+typedef struct {
+    /* borrowed from the DOM until the barrier */
+    const char* src;
+
+    char* path;
+    char* output_dir;
+    ImageCache* cache;
+
+    /* transfer the image waits on, as index + 1 */
+    size_t fetch;
+} ImageJob;
+
+/* Connections live in the multi handle, so every host is connected to once
+   per downloader and transfers to it reuse, or with HTTP/2 share, them. */
+struct ImageDownloader {
+    CURLM* multi;
+    int concurrency;
+    int running;
+
+    ImageFetch* fetches;
+    size_t count;
+    size_t capacity;
+
+    /* first fetch that has not been started */
+    size_t next;
+
+    /* open addressing index of fetches by URL, holding index + 1 */
+    size_t* slots;
+    size_t slot_count;
+
+    /* names the temporary files */
+    unsigned long serial;
+
+    /* set once image_downloader_start moved the work to a background thread,
+       which then owns everything above; the fields below are shared */
+    int threaded;
+    int stopping;
+
+    ImageJob* jobs;
+    size_t job_count;
+    size_t job_capacity;
+
+    /* jobs the thread took, and those it finished */
+    size_t jobs_taken;
+    size_t jobs_done;
+#ifdef _WIN32
+    CRITICAL_SECTION lock;
+    CONDITION_VARIABLE wake;
+    CONDITION_VARIABLE done;
+    HANDLE thread;
+#else
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t done;
+    pthread_t thread;
+#endif
+};
+
+/* FNV-1a, to index fetches by URL. */
+static size_t url_hash(const char* url) {
+    unsigned long long hash = 0xcbf29ce484222325ULL;
+
+    while (*url) {
+        hash ^= (unsigned char)*url++;
+        hash *= 0x100000001b3ULL;
+    }
+
+    return (size_t)hash;
+}
+
+static ImageFetch* find_fetch(ImageDownloader* downloader, const char* url) {
+    if (downloader->slot_count == 0) return NULL;
+    size_t slot = url_hash(url) & (downloader->slot_count - 1);
+
+    while (downloader->slots[slot]) {
+        ImageFetch* fetch = &downloader->fetches[downloader->slots[slot] - 1];
+        if (strcmp(fetch->url, url) == 0) return fetch;
+        slot = (slot + 1) & (downloader->slot_count - 1);
+    }
+
+    return NULL;
+}
+
+/* Keeps the index at most half full. */
+static int grow_slots(ImageDownloader* downloader) {
+    if (downloader->count * 2 < downloader->slot_count) return 0;
+    size_t slot_count = downloader->slot_count ? downloader->slot_count * 2 : 64;
+
+    size_t* slots = (size_t*)calloc(slot_count, sizeof(size_t));
+    if (!slots) return -1;
+
+    for (size_t i = 0; i < downloader->count; i++) {
+        size_t slot = url_hash(downloader->fetches[i].url) & (slot_count - 1);
+
+        while (slots[slot])
+            slot = (slot + 1) & (slot_count - 1);
+
+        slots[slot] = i + 1;
+    }
+
+    free(downloader->slots);
+    downloader->slots = slots;
+    downloader->slot_count = slot_count;
+    return 0;
+}
+
+/* Queues url once, returns its fetch or NULL when out of memory. */
+static ImageFetch* queue_fetch(ImageDownloader* downloader, const char* url, const char* output_dir) {
+    ImageFetch* fetch = find_fetch(downloader, url);
+    if (fetch) return fetch;
+
+    if (grow_slots(downloader) != 0) return NULL;
+
+    if (downloader->count == downloader->capacity) {
+        size_t capacity = downloader->capacity ? downloader->capacity * 2 : 16;
+        ImageFetch* fetches = (ImageFetch*)realloc(downloader->fetches, capacity * sizeof(ImageFetch));
+
+        if (!fetches) return NULL;
+        downloader->fetches = fetches;
+        downloader->capacity = capacity;
+    }
+
+    /* temporary names never collide with other downloaders or processes */
+    size_t path_size = strlen(output_dir) + 64;
+    char* path = malloc(path_size);
+    char* copy = html2tex_strdup(url);
+
+    if (!path || !copy) {
+        free(path);
+        free(copy);
+        return NULL;
+    }
+
+    snprintf(path, path_size, "%s/.html2tex-%lx-%lx-%lx.part", output_dir, (unsigned long)getpid(),
+        (unsigned long)(uintptr_t)downloader, downloader->serial++);
+
+    fetch = &downloader->fetches[downloader->count];
+    fetch->url = copy;
+    fetch->path = path;
+    fetch->file = NULL;
+    fetch->handle = NULL;
+    fetch->status = FETCH_QUEUED;
+
+    size_t slot = url_hash(url) & (downloader->slot_count - 1);
+
+    while (downloader->slots[slot])
+        slot = (slot + 1) & (downloader->slot_count - 1);
+
+    downloader->slots[slot] = ++downloader->count;
+    return fetch;
+}
+
+static void fail_fetch(ImageFetch* fetch) {
+    if (fetch->file) fclose(fetch->file);
+    fetch->file = NULL;
+
+    remove(fetch->path);
+    fetch->status = FETCH_FAILED;
+}
+
+static void start_fetch(ImageDownloader* downloader, size_t index) {
+    ImageFetch* fetch = &downloader->fetches[index];
+    CURL* curl = curl_easy_init();
+
+    fetch->file = fopen(fetch->path, "wb");
+
+    if (!curl || !fetch->file) {
+        if (curl) curl_easy_cleanup(curl);
+        fail_fetch(fetch);
+        return;
+    }
+
+    set_transfer_options(curl, fetch->url, fetch->file);
+    curl_easy_setopt(curl, CURLOPT_PRIVATE, (void*)(uintptr_t)index);
+
+    if (curl_multi_add_handle(downloader->multi, curl) != CURLM_OK) {
+        curl_easy_cleanup(curl);
+        fail_fetch(fetch);
+        return;
+    }
+
+    fetch->handle = curl;
+    fetch->status = FETCH_RUNNING;
+    downloader->running++;
+}
+
+static void end_fetch(ImageDownloader* downloader, ImageFetch* fetch, int success) {
+    curl_multi_remove_handle(downloader->multi, fetch->handle);
+    curl_easy_cleanup(fetch->handle);
+
+    fetch->handle = NULL;
+    downloader->running--;
+
+    if (!success) {
+        fail_fetch(fetch);
+        return;
+    }
+
+    success = fclose(fetch->file) == 0;
+    fetch->file = NULL;
+
+    if (success) fetch->status = FETCH_READY;
+    else fail_fetch(fetch);
+}
+
+static void complete_fetch(ImageDownloader* downloader, CURL* curl, CURLcode result) {
+    char* index = NULL;
+    long response_code = 0;
+
+    curl_easy_getinfo(curl, CURLINFO_PRIVATE, &index);
+
+    if (result == CURLE_OK)
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
+
+    end_fetch(downloader, &downloader->fetches[(uintptr_t)index], response_code == 200);
+}
+
+static void start_fetches(ImageDownloader* downloader) {
+    while (downloader->running < downloader->concurrency && downloader->next < downloader->count)
+        start_fetch(downloader, downloader->next++);
+}
+
+/* Moves the transfers in flight forward; returns 0 when there is nothing to do but wait. */
+static int perform_fetches(ImageDownloader* downloader) {
+    int still_running = 0;
+
+    if (curl_multi_perform(downloader->multi, &still_running) != CURLM_OK) {
+        /* the engine is broken, every transfer in flight fails */
+        for (size_t i = 0; i < downloader->count; i++)
+            if (downloader->fetches[i].status == FETCH_RUNNING)
+                end_fetch(downloader, &downloader->fetches[i], 0);
+        return 1;
+    }
+
+    CURLMsg* message;
+    int queued, completed = 0;
+
+    while ((message = curl_multi_info_read(downloader->multi, &queued)) != NULL) {
+        if (message->msg == CURLMSG_DONE) {
+            complete_fetch(downloader, message->easy_handle, message->data.result);
+            completed = 1;
+        }
+    }
+
+    /* freed slots start the next transfers before anything waits */
+    return completed || still_running == 0;
+}
+
+/* Runs the queued transfers, concurrency at a time, until all of them are
+   done or, when until is given, until that one is. */
+static void run_fetches(ImageDownloader* downloader, const ImageFetch* until) {
+    for (;;) {
+        start_fetches(downloader);
+
+        if (until && until->status >= FETCH_READY) break;
+        if (downloader->running == 0) break;
+
+        if (!perform_fetches(downloader))
+            curl_multi_poll(downloader->multi, NULL, 0, 1000, NULL);
+    }
+}
+
+/* Copies an image file, for another element with the same src or out of the cache. */
+static int copy_file(const char* from, const char* to) {
+    FILE* in = fopen(from, "rb");
+    if (!in) return 0;
+
+    FILE* out = fopen(to, "wb");
+
+    if (!out) {
+        fclose(in);
+        return 0;
+    }
+
+    char buffer[65536];
+    size_t read;
+    int success = 1;
+
+    while (success && (read = fread(buffer, 1, sizeof(buffer), in)) > 0)
+        success = fwrite(buffer, 1, read, out) == read;
+
+    success = success && !ferror(in);
+    fclose(in);
+
+    if (fclose(out) != 0) success = 0;
+    if (!success) remove(to);
+    return success;
+}
+
+/* Moves a downloaded image to full_path, or copies it when claimed before. */
+static int claim_fetch(ImageFetch* fetch, const char* full_path) {
+    if (fetch->status == FETCH_CLAIMED)
+        return fetch->path && copy_file(fetch->path, full_path);
+
+    if (fetch->status != FETCH_READY) return 0;
+
+    /* rename does not replace an existing file everywhere */
+    if (rename(fetch->path, full_path) != 0) {
+        remove(full_path);
+        if (rename(fetch->path, full_path) != 0) return 0;
+    }
+
+    free(fetch->path);
+    fetch->path = html2tex_strdup(full_path);
+    fetch->status = FETCH_CLAIMED;
+    return 1;
+}
+
+/* 128-bit MurmurHash3 (x64 variant) of src, the key of its cached image. */
+static void image_key(const char* src, unsigned long long key[2]) {
+    const unsigned long long c1 = 0x87c37b91114253d5ULL, c2 = 0x4cf5ad432745937fULL;
+    const unsigned char* data = (const unsigned char*)src;
+    const size_t length = strlen(src);
+    unsigned long long h1 = 0, h2 = 0, k1, k2;
+    size_t i;
+
+#define ROTL64(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+#define LOAD64(p) ((unsigned long long)(p)[0] | (unsigned long long)(p)[1] << 8 | \
+    (unsigned long long)(p)[2] << 16 | (unsigned long long)(p)[3] << 24 | \
+    (unsigned long long)(p)[4] << 32 | (unsigned long long)(p)[5] << 40 | \
+    (unsigned long long)(p)[6] << 48 | (unsigned long long)(p)[7] << 56)
+
+    for (i = 0; i + 16 <= length; i += 16) {
+        k1 = LOAD64(data + i);
+        k2 = LOAD64(data + i + 8);
+
+        k1 *= c1; k1 = ROTL64(k1, 31); k1 *= c2; h1 ^= k1;
+        h1 = ROTL64(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+
+        k2 *= c2; k2 = ROTL64(k2, 33); k2 *= c1; h2 ^= k2;
+        h2 = ROTL64(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+    }
+
+    /* the tail of up to 15 bytes */
+    k1 = k2 = 0;
+
+    for (size_t j = length - i; j > 8; j--)
+        k2 |= (unsigned long long)data[i + j - 1] << ((j - 9) * 8);
+
+    for (size_t j = length - i < 8 ? length - i : 8; j > 0; j--)
+        k1 |= (unsigned long long)data[i + j - 1] << ((j - 1) * 8);
+
+    if (length - i > 8) { k2 *= c2; k2 = ROTL64(k2, 33); k2 *= c1; h2 ^= k2; }
+    if (length - i > 0) { k1 *= c1; k1 = ROTL64(k1, 31); k1 *= c2; h1 ^= k1; }
+
+    h1 ^= length; h2 ^= length;
+    h1 += h2; h2 += h1;
+
+    for (int round = 0; round < 2; round++) {
+        unsigned long long* h = round ? &h2 : &h1;
+        *h ^= *h >> 33; *h *= 0xff51afd7ed558ccdULL;
+        *h ^= *h >> 33; *h *= 0xc4ceb9fe1a85ec53ULL;
+        *h ^= *h >> 33;
+    }
+
+    h1 += h2; h2 += h1;
+    key[0] = h1;
+    key[1] = h2;
+#undef ROTL64
+#undef LOAD64
+}
+
+/* An image in the cache; used orders entries for eviction. */
+typedef struct {
+    unsigned long long key[2];
+    unsigned long long size;
+    unsigned long long used;
+} CacheEntry;
+
+/* The index file starts with this, then the clock, then the entries. */
+static const char cache_magic[8] = { 'H', '2', 'T', 'X', 'I', 'M', 'G', '1' };
+
+/* Images live in the directory under the hex of their key, listed by its
+   index file. One ImageCache exists per directory in the process, shared by
+   every converter that opens it, so they evict and index together. */
+struct ImageCache {
+    char* directory;
+    unsigned long long max_bytes;
+    unsigned long long total_bytes;
+
+    CacheEntry* entries;
+    size_t count;
+    size_t capacity;
+
+    /* open addressing index of entries by key, holding index + 1 */
+    size_t* slots;
+    size_t slot_count;
+
+    /* recency stamp handed to the last used entry */
+    unsigned long long clock;
+    int dirty;
+
+    size_t refs;
+    ImageCache* next;
+#ifdef _WIN32
+    CRITICAL_SECTION lock;
+#else
+    pthread_mutex_t lock;
+#endif
+};
+
+/* caches opened by the process */
+static ImageCache* open_caches = NULL;
+#ifdef _WIN32
+static SRWLOCK open_caches_lock = SRWLOCK_INIT;
+#define CACHES_LOCK() AcquireSRWLockExclusive(&open_caches_lock)
+#define CACHES_UNLOCK() ReleaseSRWLockExclusive(&open_caches_lock)
+#define CACHE_LOCK(cache) EnterCriticalSection(&(cache)->lock)
+#define CACHE_UNLOCK(cache) LeaveCriticalSection(&(cache)->lock)
+#else
+static pthread_mutex_t open_caches_lock = PTHREAD_MUTEX_INITIALIZER;
+#define CACHES_LOCK() pthread_mutex_lock(&open_caches_lock)
+#define CACHES_UNLOCK() pthread_mutex_unlock(&open_caches_lock)
+#define CACHE_LOCK(cache) pthread_mutex_lock(&(cache)->lock)
+#define CACHE_UNLOCK(cache) pthread_mutex_unlock(&(cache)->lock)
+#endif
+
+/* Writes the path of the cached image with key, or of the index for NULL. */
+static void cache_path(const ImageCache* cache, const unsigned long long* key, char* path, size_t size) {
+    if (key)
+        snprintf(path, size, "%s/%016llx%016llx", cache->directory, key[0], key[1]);
+    else
+        snprintf(path, size, "%s/index", cache->directory);
+}
+
+static size_t cache_find(const ImageCache* cache, const unsigned long long key[2]) {
+    if (cache->slot_count == 0) return 0;
+    size_t slot = (size_t)key[0] & (cache->slot_count - 1);
+
+    while (cache->slots[slot]) {
+        const CacheEntry* entry = &cache->entries[cache->slots[slot] - 1];
+        if (entry->key[0] == key[0] && entry->key[1] == key[1]) return cache->slots[slot];
+        slot = (slot + 1) & (cache->slot_count - 1);
+    }
+
+    return 0;
+}
+
+/* Rebuilds the index of entries by key, at most half full. */
+static int cache_reindex(ImageCache* cache) {
+    size_t slot_count = cache->slot_count ? cache->slot_count : 64;
+
+    while (slot_count < cache->count * 2 + 2)
+        slot_count *= 2;
+
+    if (slot_count != cache->slot_count) {
+        size_t* slots = (size_t*)realloc(cache->slots, slot_count * sizeof(size_t));
+        if (!slots) return -1;
+
+        cache->slots = slots;
+        cache->slot_count = slot_count;
+    }
+
+    memset(cache->slots, 0, cache->slot_count * sizeof(size_t));
+
+    for (size_t i = 0; i < cache->count; i++) {
+        size_t slot = (size_t)cache->entries[i].key[0] & (cache->slot_count - 1);
+
+        while (cache->slots[slot])
+            slot = (slot + 1) & (cache->slot_count - 1);
+
+        cache->slots[slot] = i + 1;
+    }
+
+    return 0;
+}
+
+/* Drops the least recently used images until the cache fits its bound. */
+static void cache_evict(ImageCache* cache) {
+    int evicted = 0;
+
+    while (cache->max_bytes && cache->total_bytes > cache->max_bytes && cache->count > 0) {
+        size_t oldest = 0;
+
+        for (size_t i = 1; i < cache->count; i++)
+            if (cache->entries[i].used < cache->entries[oldest].used) oldest = i;
+
+        char path[1024];
+        cache_path(cache, cache->entries[oldest].key, path, sizeof(path));
+        remove(path);
+
+        cache->total_bytes -= cache->entries[oldest].size;
+        cache->entries[oldest] = cache->entries[--cache->count];
+        evicted = 1;
+    }
+
+    if (evicted) {
+        cache->dirty = 1;
+        cache_reindex(cache);
+    }
+}
+
+/* Reads the index file; a missing or damaged one leaves the cache empty. */
+static void cache_load(ImageCache* cache) {
+    char path[1024];
+    cache_path(cache, NULL, path, sizeof(path));
+
+    FILE* file = fopen(path, "rb");
+    if (!file) return;
+
+    char magic[8];
+    unsigned long long clock;
+
+    if (fread(magic, 1, sizeof(magic), file) == sizeof(magic) && memcmp(magic, cache_magic, sizeof(magic)) == 0 &&
+        fread(&clock, sizeof(clock), 1, file) == 1) {
+        CacheEntry entry;
+        cache->clock = clock;
+
+        while (fread(&entry, sizeof(entry), 1, file) == 1) {
+            if (cache->count == cache->capacity) {
+                size_t capacity = cache->capacity ? cache->capacity * 2 : 64;
+                CacheEntry* entries = (CacheEntry*)realloc(cache->entries, capacity * sizeof(CacheEntry));
+
+                if (!entries) break;
+                cache->entries = entries;
+                cache->capacity = capacity;
+            }
+
+            cache->entries[cache->count++] = entry;
+            cache->total_bytes += entry.size;
+        }
+    }
+
+    fclose(file);
+
+    if (cache_reindex(cache) != 0) {
+        cache->count = 0;
+        cache->total_bytes = 0;
+    }
+}
+
+/* Writes the index file when it changed, replacing the old one at once. */
+static void cache_save(ImageCache* cache) {
+    if (!cache->dirty) return;
+
+    char path[1024], temp[1040];
+    cache_path(cache, NULL, path, sizeof(path));
+    snprintf(temp, sizeof(temp), "%s.%lx", path, (unsigned long)getpid());
+
+    FILE* file = fopen(temp, "wb");
+    if (!file) return;
+
+    int success = fwrite(cache_magic, 1, sizeof(cache_magic), file) == sizeof(cache_magic) &&
+        fwrite(&cache->clock, sizeof(cache->clock), 1, file) == 1 &&
+        fwrite(cache->entries, sizeof(CacheEntry), cache->count, file) == cache->count;
+
+    if (fclose(file) != 0) success = 0;
+
+    if (success && rename(temp, path) != 0) {
+        remove(path);
+        success = rename(temp, path) == 0;
+    }
+
+    if (success) cache->dirty = 0;
+    else remove(temp);
+}
+
+ImageCache* image_cache_open(const char* directory, unsigned long long max_bytes) {
+    if (!directory || !*directory) return NULL;
+    if (create_directory_if_not_exists(directory) != 0) return NULL;
+
+    CACHES_LOCK();
+    ImageCache* cache = open_caches;
+
+    while (cache && strcmp(cache->directory, directory) != 0)
+        cache = cache->next;
+
+    if (cache) {
+        cache->refs++;
+
+        /* the last bound set wins for everyone sharing the directory */
+        CACHE_LOCK(cache);
+        cache->max_bytes = max_bytes;
+        cache_evict(cache);
+        CACHE_UNLOCK(cache);
+
+        CACHES_UNLOCK();
+        return cache;
+    }
+
+    cache = (ImageCache*)calloc(1, sizeof(ImageCache));
+
+    if (cache && !(cache->directory = html2tex_strdup(directory))) {
+        free(cache);
+        cache = NULL;
+    }
+
+    if (cache) {
+#ifdef _WIN32
+        InitializeCriticalSection(&cache->lock);
+#else
+        pthread_mutex_init(&cache->lock, NULL);
+#endif
+        cache->max_bytes = max_bytes;
+        cache->refs = 1;
+
+        cache_load(cache);
+        cache_evict(cache);
+
+        cache->next = open_caches;
+        open_caches = cache;
+    }
+
+    CACHES_UNLOCK();
+    return cache;
+}
+
+ImageCache* image_cache_retain(ImageCache* cache) {
+    if (!cache) return NULL;
+
+    CACHES_LOCK();
+    cache->refs++;
+    CACHES_UNLOCK();
+    return cache;
+}
+
+void image_cache_release(ImageCache* cache) {
+    if (!cache) return;
+
+    CACHES_LOCK();
+
+    if (--cache->refs > 0) {
+        CACHES_UNLOCK();
+        return;
+    }
+
+    ImageCache** link = &open_caches;
+
+    while (*link != cache)
+        link = &(*link)->next;
+
+    *link = cache->next;
+    CACHES_UNLOCK();
+
+    cache_save(cache);
+#ifdef _WIN32
+    DeleteCriticalSection(&cache->lock);
+#else
+    pthread_mutex_destroy(&cache->lock);
+#endif
+    free(cache->entries);
+    free(cache->slots);
+    free(cache->directory);
+    free(cache);
+}
+
+int image_cache_fetch(ImageCache* cache, const char* src, const char* path) {
+    if (!cache || !src || !path) return 0;
+
+    unsigned long long key[2];
+    image_key(src, key);
+
+    CACHE_LOCK(cache);
+    const size_t found = cache_find(cache, key);
+
+    if (found) {
+        cache->entries[found - 1].used = ++cache->clock;
+        cache->dirty = 1;
+    }
+
+    CACHE_UNLOCK(cache);
+    if (!found) return 0;
+
+    char cached[1024];
+    cache_path(cache, key, cached, sizeof(cached));
+
+    /* another converter may have evicted it meanwhile */
+    return copy_file(cached, path);
+}
+
+int image_cache_contains(ImageCache* cache, const char* src) {
+    if (!cache || !src) return 0;
+
+    unsigned long long key[2];
+    image_key(src, key);
+
+    CACHE_LOCK(cache);
+    const int found = cache_find(cache, key) != 0;
+    CACHE_UNLOCK(cache);
+    return found;
+}
+
+void image_cache_store(ImageCache* cache, const char* src, const char* path) {
+    if (!cache || !src || !path) return;
+
+    struct stat st;
+    if (stat(path, &st) != 0) return;
+
+    unsigned long long key[2];
+    image_key(src, key);
+
+    char cached[1024], temp[1100];
+    cache_path(cache, key, cached, sizeof(cached));
+
+    /* copied under a private name, so readers never see half an image */
+    snprintf(temp, sizeof(temp), "%s.%lx-%lx", cached, (unsigned long)getpid(), (unsigned long)(uintptr_t)&st);
+    if (!copy_file(path, temp)) return;
+
+    CACHE_LOCK(cache);
+
+    if (cache_find(cache, key) ||
+        (cache->count == cache->capacity && cache->capacity > ((size_t)-1) / (2 * sizeof(CacheEntry)))) {
+        CACHE_UNLOCK(cache);
+        remove(temp);
+        return;
+    }
+
+    if (cache->count == cache->capacity) {
+        size_t capacity = cache->capacity ? cache->capacity * 2 : 64;
+        CacheEntry* entries = (CacheEntry*)realloc(cache->entries, capacity * sizeof(CacheEntry));
+
+        if (!entries) {
+            CACHE_UNLOCK(cache);
+            remove(temp);
+            return;
+        }
+
+        cache->entries = entries;
+        cache->capacity = capacity;
+    }
+
+    if (rename(temp, cached) != 0) {
+        remove(cached);
+
+        if (rename(temp, cached) != 0) {
+            CACHE_UNLOCK(cache);
+            remove(temp);
+            return;
+        }
+    }
+
+    CacheEntry* entry = &cache->entries[cache->count++];
+    entry->key[0] = key[0];
+    entry->key[1] = key[1];
+    entry->size = (unsigned long long)st.st_size;
+    entry->used = ++cache->clock;
+
+    cache->total_bytes += entry->size;
+    cache->dirty = 1;
+
+    if (cache_reindex(cache) != 0) {
+        /* without an index the entry cannot be found, so it goes */
+        cache->total_bytes -= entry->size;
+        cache->count--;
+        remove(cached);
+    }
+
+    cache_evict(cache);
+    CACHE_UNLOCK(cache);
+}
+
+void image_cache_flush(ImageCache* cache) {
+    if (!cache) return;
+
+    CACHE_LOCK(cache);
+    cache_save(cache);
+    CACHE_UNLOCK(cache);
+}
+
+#ifdef _WIN32
+#define PIPELINE_LOCK(d) EnterCriticalSection(&(d)->lock)
+#define PIPELINE_UNLOCK(d) LeaveCriticalSection(&(d)->lock)
+#define PIPELINE_WAIT(d, cond) SleepConditionVariableCS(&(d)->cond, &(d)->lock, INFINITE)
+#define PIPELINE_SIGNAL(d, cond) WakeAllConditionVariable(&(d)->cond)
+#else
+#define PIPELINE_LOCK(d) pthread_mutex_lock(&(d)->lock)
+#define PIPELINE_UNLOCK(d) pthread_mutex_unlock(&(d)->lock)
+#define PIPELINE_WAIT(d, cond) pthread_cond_wait(&(d)->cond, &(d)->lock)
+#define PIPELINE_SIGNAL(d, cond) pthread_cond_broadcast(&(d)->cond)
+#endif
+
+/* Produces the image of a job that needs no transfer; returns 0 when it waits on one. */
+static int begin_job(ImageDownloader* downloader, ImageJob* job) {
+    if (image_cache_fetch(job->cache, job->src, job->path))
+        return 1;
+
+    if (is_base64_image(job->src)) {
+        if (save_base64_image(job->src, job->path))
+            image_cache_store(job->cache, job->src, job->path);
+        return 1;
+    }
+
+    ImageFetch* fetch = queue_fetch(downloader, job->src, job->output_dir);
+
+    if (!fetch) {
+        remove(job->path);
+        return 1;
+    }
+
+    job->fetch = (size_t)(fetch - downloader->fetches) + 1;
+    return 0;
+}
+
+/* Claims the finished transfers of waiting jobs, in the order they were submitted,
+   and returns how many jobs are done; failed images leave no file behind. */
+static size_t settle_jobs(ImageDownloader* downloader, ImageJob* waiting, size_t* count) {
+    size_t kept = 0, settled = 0;
+
+    for (size_t i = 0; i < *count; i++) {
+        ImageJob* job = &waiting[i];
+        ImageFetch* fetch = &downloader->fetches[job->fetch - 1];
+
+        if (fetch->status < FETCH_READY) {
+            waiting[kept++] = *job;
+            continue;
+        }
+
+        if (claim_fetch(fetch, job->path))
+            image_cache_store(job->cache, job->src, job->path);
+        else remove(job->path);
+
+        settled++;
+    }
+
+    *count = kept;
+    return settled;
+}
+
+/* The background thread: takes submitted jobs, runs their transfers and
+   decoding while the conversion goes on, and reports each one done. */
+static void run_pipeline(ImageDownloader* downloader) {
+    ImageJob* waiting = NULL;
+    size_t waiting_count = 0, waiting_capacity = 0;
+
+    PIPELINE_LOCK(downloader);
+
+    for (;;) {
+        while (!downloader->stopping && downloader->jobs_taken == downloader->job_count &&
+            downloader->running == 0 && downloader->next == downloader->count)
+            PIPELINE_WAIT(downloader, wake);
+
+        if (downloader->stopping && downloader->jobs_taken == downloader->job_count && waiting_count == 0)
+            break;
+
+        /* jobs are copied out, submissions may move the array meanwhile */
+        const size_t first = waiting_count;
+        size_t finished = 0;
+
+        while (downloader->jobs_taken < downloader->job_count) {
+            if (waiting_count == waiting_capacity) {
+                size_t capacity = waiting_capacity ? waiting_capacity * 2 : 16;
+                ImageJob* grown = (ImageJob*)realloc(waiting, capacity * sizeof(ImageJob));
+
+                /* the rest waits for the next round */
+                if (!grown) break;
+                waiting = grown;
+                waiting_capacity = capacity;
+            }
+
+            waiting[waiting_count++] = downloader->jobs[downloader->jobs_taken++];
+        }
+
+        PIPELINE_UNLOCK(downloader);
+
+        size_t kept = first;
+
+        for (size_t i = first; i < waiting_count; i++) {
+            if (begin_job(downloader, &waiting[i])) finished++;
+            else waiting[kept++] = waiting[i];
+        }
+
+        waiting_count = kept;
+        start_fetches(downloader);
+
+        const int progressed = downloader->running == 0 || perform_fetches(downloader);
+        start_fetches(downloader);
+        finished += settle_jobs(downloader, waiting, &waiting_count);
+
+        /* submissions wake the poll through curl_multi_wakeup */
+        if (!progressed && finished == 0)
+            curl_multi_poll(downloader->multi, NULL, 0, 1000, NULL);
+
+        PIPELINE_LOCK(downloader);
+        downloader->jobs_done += finished;
+
+        if (downloader->jobs_done == downloader->job_count)
+            PIPELINE_SIGNAL(downloader, done);
+    }
+
+    PIPELINE_UNLOCK(downloader);
+    free(waiting);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI pipeline_thread(LPVOID downloader) {
+    run_pipeline((ImageDownloader*)downloader);
+    return 0;
+}
+#else
+static void* pipeline_thread(void* downloader) {
+    run_pipeline((ImageDownloader*)downloader);
+    return NULL;
+}
+#endif
+
+/* Names the image of src at once, reserving the file so later images pick
+   other names, and leaves producing it to the background thread. */
+static char* submit_job(ImageDownloader* downloader, ImageCache* cache, const char* src,
+    const char* output_dir, int image_counter) {
+    char* full_path = image_destination(src, output_dir, image_counter);
+    if (!full_path) return NULL;
+
+    /* another converter may have taken the name since, then the hashed one is used */
+    FILE* reserved = fopen(full_path, "wx");
+
+    if (!reserved) {
+        free(full_path);
+        full_path = image_destination(src, output_dir, image_counter);
+
+        if (!full_path) return NULL;
+        reserved = fopen(full_path, "wb");
+    }
+
+    ImageJob job;
+    job.src = src;
+    job.path = html2tex_strdup(full_path);
+    job.output_dir = html2tex_strdup(output_dir);
+    job.cache = cache;
+    job.fetch = 0;
+
+    int success = reserved && fclose(reserved) == 0 && job.path && job.output_dir;
+
+    PIPELINE_LOCK(downloader);
+
+    if (success && downloader->job_count == downloader->job_capacity) {
+        size_t capacity = downloader->job_capacity ? downloader->job_capacity * 2 : 16;
+        ImageJob* jobs = (ImageJob*)realloc(downloader->jobs, capacity * sizeof(ImageJob));
+
+        if (jobs) {
+            downloader->jobs = jobs;
+            downloader->job_capacity = capacity;
+        }
+        else success = 0;
+    }
+
+    if (success) {
+        downloader->jobs[downloader->job_count++] = job;
+        PIPELINE_SIGNAL(downloader, wake);
+    }
+
+    PIPELINE_UNLOCK(downloader);
+
+    if (!success) {
+        if (reserved) remove(full_path);
+        free(job.path);
+        free(job.output_dir);
+        free(full_path);
         return NULL;
     }
 
-    snprintf(full_path, strlen(output_dir) + strlen(safe_filename) + 2, "%s/%s", output_dir, safe_filename);
+    /* the thread may be waiting on the network */
+    curl_multi_wakeup(downloader->multi);
+    return full_path;
+}
+
+int image_downloader_start(ImageDownloader* downloader) {
+    if (!downloader) return -1;
+    if (downloader->threaded) return 0;
+
+#ifdef _WIN32
+    InitializeCriticalSection(&downloader->lock);
+    InitializeConditionVariable(&downloader->wake);
+    InitializeConditionVariable(&downloader->done);
+
+    downloader->thread = CreateThread(NULL, 0, pipeline_thread, downloader, 0, NULL);
+
+    if (!downloader->thread) {
+        DeleteCriticalSection(&downloader->lock);
+        return -1;
+    }
+#else
+    pthread_mutex_init(&downloader->lock, NULL);
+    pthread_cond_init(&downloader->wake, NULL);
+    pthread_cond_init(&downloader->done, NULL);
+
+    if (pthread_create(&downloader->thread, NULL, pipeline_thread, downloader) != 0) {
+        pthread_cond_destroy(&downloader->done);
+        pthread_cond_destroy(&downloader->wake);
+        pthread_mutex_destroy(&downloader->lock);
+        return -1;
+    }
+#endif
+
+    downloader->threaded = 1;
+    return 0;
+}
+
+void image_downloader_wait(ImageDownloader* downloader) {
+    if (!downloader || !downloader->threaded) return;
+    PIPELINE_LOCK(downloader);
+
+    while (downloader->jobs_done < downloader->job_count)
+        PIPELINE_WAIT(downloader, done);
+
+    for (size_t i = 0; i < downloader->job_count; i++) {
+        free(downloader->jobs[i].path);
+        free(downloader->jobs[i].output_dir);
+    }
+
+    downloader->job_count = 0;
+    downloader->jobs_taken = 0;
+    downloader->jobs_done = 0;
+    PIPELINE_UNLOCK(downloader);
+}
+
+ImageDownloader* image_downloader_create(int concurrency) {
+    ImageDownloader* downloader = (ImageDownloader*)calloc(1, sizeof(ImageDownloader));
+    if (!downloader) return NULL;
+
+    downloader->multi = curl_multi_init();
+
+    if (!downloader->multi) {
+        free(downloader);
+        return NULL;
+    }
+
+    downloader->concurrency = concurrency > 0 ? concurrency : 1;
+
+    /* idle connections are kept for the next images and documents */
+    curl_multi_setopt(downloader->multi, CURLMOPT_MAXCONNECTS, (long)downloader->concurrency);
+    curl_multi_setopt(downloader->multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+    return downloader;
+}
+
+void image_downloader_prefetch(ImageDownloader* downloader, ImageCache* cache, HTMLNode* root, const char* output_dir) {
+    /* a started downloader fetches images as they are met */
+    if (!downloader || downloader->threaded || !root || !output_dir) return;
+    if (create_directory_if_not_exists(output_dir) != 0) return;
+
+    /* siblings still to visit, one per level at most */
+    HTMLNode** pending = NULL;
+    size_t depth = 0;
+    size_t capacity = 0;
+
+    HTMLNode* node = root->children;
+
+    while (node || depth > 0) {
+        if (!node) {
+            node = pending[--depth];
+            continue;
+        }
+
+        const int tag_id = html2tex_node_tag(node);
+
+        if (tag_id == HTML2TEX_TAG_IMG) {
+            const char* src = get_attribute(node->attributes, "src");
+            /* cached images are copied when converted */
+            if (src && !is_base64_image(src) && !image_cache_contains(cache, src))
+                queue_fetch(downloader, src, output_dir);
+        }
+
+        /* excluded subtrees are never converted */
+        if (!node->children || (html2tex_tag_flags(tag_id) & HTML2TEX_TAG_IS_EXCLUDED)) {
+            node = node->next;
+            continue;
+        }
+
+        if (node->next) {
+            if (depth == capacity) {
+                size_t grown = capacity ? capacity * 2 : 32;
+                HTMLNode** stack = (HTMLNode**)realloc(pending, grown * sizeof(HTMLNode*));
+
+                /* images left out are downloaded when converted */
+                if (!stack) break;
+                pending = stack;
+                capacity = grown;
+            }
+
+            pending[depth++] = node->next;
+        }
+
+        node = node->children;
+    }
+
+    free(pending);
+    run_fetches(downloader, NULL);
+}
+
+char* image_downloader_fetch(ImageDownloader* downloader, ImageCache* cache, const char* src,
+    const char* output_dir, int image_counter) {
+    if (!src || !output_dir) return NULL;
+    ImageFetch* fetch = NULL;
+
+    if (downloader && downloader->threaded)
+        return submit_job(downloader, cache, src, output_dir, image_counter);
+
+    if (cache) {
+        char* full_path = image_destination(src, output_dir, image_counter);
+        if (!full_path) return NULL;
+
+        if (image_cache_fetch(cache, src, full_path))
+            return full_path;
+
+        free(full_path);
+    }
+
+    if (downloader && !is_base64_image(src)) {
+        if (create_directory_if_not_exists(output_dir) != 0)
+            return NULL;
+
+        fetch = queue_fetch(downloader, src, output_dir);
+        if (fetch) run_fetches(downloader, fetch);
+
+        /* the same URL would fail again */
+        if (fetch && fetch->status == FETCH_FAILED) return NULL;
+    }
+
+    char* full_path = image_destination(src, output_dir, image_counter);
+    if (!full_path) return NULL;
+
     int success = 0;
 
     /* handle base64 encoded image */
-    if (is_base64_image(src)) 
+    if (is_base64_image(src))
         success = save_base64_image(src, full_path);
     /* handle normal URL */
+    else if (fetch)
+        success = claim_fetch(fetch, full_path);
     else success = download_image_url(src, full_path);
 
-    free(safe_filename);
-
-    if (success)
+    if (success) {
+        image_cache_store(cache, src, full_path);
         return full_path;
+    }
     else {
         free(full_path);
         return NULL;
     }
 }
 
+void image_downloader_reset(ImageDownloader* downloader) {
+    if (!downloader) return;
+
+    /* finish transfers still in flight before their files go; past the
+       barrier the background thread sleeps until the next submission */
+    if (downloader->threaded) {
+        image_downloader_wait(downloader);
+        PIPELINE_LOCK(downloader);
+    }
+    else run_fetches(downloader, NULL);
+
+    for (size_t i = 0; i < downloader->count; i++) {
+        ImageFetch* fetch = &downloader->fetches[i];
+
+        /* unclaimed downloads are temporary files */
+        if (fetch->status == FETCH_READY) remove(fetch->path);
+
+        free(fetch->url);
+        free(fetch->path);
+    }
+
+    downloader->count = 0;
+    downloader->next = 0;
+
+    if (downloader->slots)
+        memset(downloader->slots, 0, downloader->slot_count * sizeof(size_t));
+
+    if (downloader->threaded) PIPELINE_UNLOCK(downloader);
+}
+
+void image_downloader_destroy(ImageDownloader* downloader) {
+    if (!downloader) return;
+    image_downloader_reset(downloader);
+
+    if (downloader->threaded) {
+        PIPELINE_LOCK(downloader);
+        downloader->stopping = 1;
+        PIPELINE_SIGNAL(downloader, wake);
+        PIPELINE_UNLOCK(downloader);
+#ifdef _WIN32
+        WaitForSingleObject(downloader->thread, INFINITE);
+        CloseHandle(downloader->thread);
+        DeleteCriticalSection(&downloader->lock);
+#else
+        pthread_join(downloader->thread, NULL);
+        pthread_cond_destroy(&downloader->done);
+        pthread_cond_destroy(&downloader->wake);
+        pthread_mutex_destroy(&downloader->lock);
+#endif
+        free(downloader->jobs);
+    }
+
+    curl_multi_cleanup(downloader->multi);
+    free(downloader->fetches);
+    free(downloader->slots);
+    free(downloader);
+}
+
+/* curl_global_init is not thread-safe, so it runs once per process. */
+static int curl_init_result = 0;
+
+static void curl_init_routine(void) {
+    curl_init_result = curl_global_init(CURL_GLOBAL_DEFAULT) == CURLE_OK ? 0 : -1;
+    if (curl_init_result == 0) atexit(curl_global_cleanup);
+}
+
+#ifdef _WIN32
+static INIT_ONCE curl_once = INIT_ONCE_STATIC_INIT;
+
+static BOOL CALLBACK curl_init_callback(PINIT_ONCE once, PVOID parameter, PVOID* context) {
+    (void)once; (void)parameter; (void)context;
+    curl_init_routine();
+    return TRUE;
+}
+#else
+static pthread_once_t curl_once = PTHREAD_ONCE_INIT;
+#endif
+
 int image_utils_init(void) {
-    curl_global_init(CURL_GLOBAL_DEFAULT);
-    return 0;
+#ifdef _WIN32
+    InitOnceExecuteOnce(&curl_once, curl_init_callback, NULL, NULL);
+#else
+    pthread_once(&curl_once, curl_init_routine);
+#endif
+    return curl_init_result;
 }
 
 void image_utils_cleanup(void) {
-    curl_global_cleanup();
+    /* concurrent conversions may still download, curl is released at exit */
 }
\ No newline at end of file